@@ -0,0 +1,159 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    capture_queue.cpp
+  \brief   C++ Implementation: CaptureQueue
+  \author  Author Name, 2009
+*/
+//========================================================================
+
+#include "capture_queue.h"
+#include "timer.h"
+
+CaptureQueue::CaptureQueue(int _capacity)
+{
+  capacity=(_capacity < 1) ? 1 : _capacity;
+  dropped=0;
+  interrupted=false;
+}
+
+CaptureQueue::~CaptureQueue()
+{
+  flush();
+  for (unsigned int i=0;i<spare.size();i++) {
+    spare[i].clear();
+  }
+  filling.clear();
+}
+
+void CaptureQueue::recycle(RawImage & img)
+{
+  if (img.getData()!=0) spare.push_back(img);
+  img=RawImage();
+}
+
+void CaptureQueue::dropOldest()
+{
+  recycle(queued.front().image);
+  queued.pop_front();
+}
+
+void CaptureQueue::setCapacity(int _capacity)
+{
+  mutex.lock();
+  capacity=(_capacity < 1) ? 1 : _capacity;
+  while ((int)queued.size() > capacity) {
+    dropOldest();
+    dropped++;
+  }
+  mutex.unlock();
+}
+
+int CaptureQueue::getCapacity()
+{
+  mutex.lock();
+  int res=capacity;
+  mutex.unlock();
+  return res;
+}
+
+RawImage & CaptureQueue::beginPush()
+{
+  if (filling.getData()==0) {
+    mutex.lock();
+    if (spare.empty()==false) {
+      filling=spare.back();
+      spare.pop_back();
+    }
+    mutex.unlock();
+  }
+  return filling;
+}
+
+void CaptureQueue::endPush(long long number, double fps)
+{
+  Entry e;
+  e.image=filling;
+  e.number=number;
+  e.fps=fps;
+  e.enqueue_time=GetTimeSec();
+  filling=RawImage();
+  mutex.lock();
+  if ((int)queued.size() >= capacity) {
+    //processing fell behind; the newest frame is worth more:
+    dropOldest();
+    dropped++;
+  }
+  queued.push_back(e);
+  not_empty.wakeOne();
+  mutex.unlock();
+}
+
+bool CaptureQueue::pop(RawImage & target, long long & number, double & fps, double & latency, unsigned long timeout_ms)
+{
+  mutex.lock();
+  if (queued.empty() && interrupted==false) {
+    not_empty.wait(&mutex,timeout_ms);
+  }
+  interrupted=false;
+  if (queued.empty()) {
+    mutex.unlock();
+    return false;
+  }
+  Entry & e=queued.front();
+  latency=GetTimeSec()-e.enqueue_time;
+  number=e.number;
+  fps=e.fps;
+  //hand the consumer's old buffer back for reuse:
+  RawImage old=target;
+  target=e.image;
+  queued.pop_front();
+  recycle(old);
+  mutex.unlock();
+  return true;
+}
+
+void CaptureQueue::interrupt()
+{
+  mutex.lock();
+  interrupted=true;
+  not_empty.wakeAll();
+  mutex.unlock();
+}
+
+void CaptureQueue::flush()
+{
+  mutex.lock();
+  while (queued.empty()==false) {
+    dropOldest();
+  }
+  mutex.unlock();
+}
+
+int CaptureQueue::getQueuedCount()
+{
+  mutex.lock();
+  int res=(int)queued.size();
+  mutex.unlock();
+  return res;
+}
+
+long long CaptureQueue::getDroppedCount()
+{
+  mutex.lock();
+  long long res=dropped;
+  mutex.unlock();
+  return res;
+}
@@ -0,0 +1,96 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    capture_queue.h
+  \brief   C++ Interface: CaptureQueue
+  \author  Author Name, 2009
+*/
+//========================================================================
+
+#ifndef CAPTURE_QUEUE_H
+#define CAPTURE_QUEUE_H
+#include <QMutex>
+#include <QWaitCondition>
+#include <deque>
+#include <vector>
+#include "rawimage.h"
+using namespace std;
+
+/*!
+  \class CaptureQueue
+  \brief A bounded queue of converted camera frames between a capture
+         thread and a processing thread
+
+  The producer converts each frame into the image returned by
+  beginPush() and then enqueues it with endPush(). If the queue is
+  full, the oldest frame is dropped, so the capture thread never waits
+  for processing. The consumer takes frames with pop(), which swaps the
+  image into its own RawImage. Images are only exchanged, never copied,
+  and their buffers are recycled.
+
+  There must be only one producer and one consumer.
+*/
+class CaptureQueue
+{
+protected:
+  struct Entry {
+    RawImage image;
+    long long number;
+    double fps;
+    double enqueue_time;
+  };
+  QMutex mutex;
+  QWaitCondition not_empty;
+  deque<Entry> queued; //oldest first
+  vector<RawImage> spare;
+  RawImage filling;    //only used by the producer
+  int capacity;
+  long long dropped;
+  bool interrupted;
+
+  void recycle(RawImage & img);
+  void dropOldest();
+private:
+  CaptureQueue(const CaptureQueue &);
+  CaptureQueue & operator=(const CaptureQueue &);
+public:
+  CaptureQueue(int _capacity=2);
+  ~CaptureQueue();
+
+  /// maximum number of queued frames (at least 1)
+  void setCapacity(int _capacity);
+  int getCapacity();
+
+  /// returns the image the producer should convert the next frame into
+  RawImage & beginPush();
+  /// enqueues the image of beginPush(), dropping the oldest frame if full
+  void endPush(long long number, double fps);
+
+  /// waits up to \p timeout_ms for a frame and swaps its image into \p target.
+  /// \p latency is set to the seconds the frame spent in the queue.
+  /// returns false on timeout or interrupt().
+  bool pop(RawImage & target, long long & number, double & fps, double & latency, unsigned long timeout_ms);
+
+  /// wakes up a consumer waiting in pop()
+  void interrupt();
+
+  /// drops all queued frames without counting them
+  void flush();
+
+  int getQueuedCount();
+  long long getDroppedCount();
+};
+
+#endif
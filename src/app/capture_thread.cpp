@@ -22,6 +22,7 @@
 #include "capture_thread.h"
 
 CaptureThread::CaptureThread(int cam_id)
+ : stats_key("capture_stats")
 {
   camId=cam_id;
   affinity=0;
@@ -33,6 +34,13 @@ CaptureThread::CaptureThread(int cam_id)
   control->addChild( (VarType*) (c_reset  = new VarTrigger("reset bus","Reset")));
   control->addChild( (VarType*) (c_auto_refresh= new VarBool("auto refresh params",true)));
   control->addChild( (VarType*) (c_refresh= new VarTrigger("re-read params","Refresh")));
+  //upper bound of the per-frame scratch memory of each ring buffer slot:
+  control->addChild( (VarType*) (c_arena_limit= new VarInt("frame memory limit (MB)",64,0)));
+  //run the vision stack in its own thread, fed by a queue that drops the oldest frames:
+  control->addChild( (VarType*) (c_decoupled= new VarBool("decoupled processing",false)));
+  control->addChild( (VarType*) (c_queue_depth= new VarInt("processing queue depth",2,1,16)));
+  //run the stages of the vision stack on successive frames at the same time:
+  control->addChild( (VarType*) (c_pipelined= new VarBool("pipelined stages",false)));
   control->addChild( (VarType*) (captureModule= new VarStringEnum("Capture Module","DC 1394")));
   captureModule->addFlags(VARTYPE_FLAG_NOLOAD_ENUM_CHILDREN);
   captureModule->addItem("DC 1394");
@@ -57,7 +65,11 @@ CaptureThread::CaptureThread(int cam_id)
   captureGenerator = new CaptureGenerator(generator);
   selectCaptureMethod();
   _kill =false;
+  clear_frames=false;
   rb=0;
+  processing=new ProcessingThread(this);
+  process_counter=new FrameCounter();
+  processing_enabled=false;
 }
 
 void CaptureThread::setAffinityManager(AffinityManager * _affinity) {
@@ -66,6 +78,11 @@ void CaptureThread::setAffinityManager(AffinityManager * _affinity) {
 
 void CaptureThread::setStack(VisionStack * _stack) {
   stack_mutex.lock();
+  //the stage threads must be done with the old stack:
+  pipeline.stop();
+  //the previous stack's frame data is of no use to the new one.
+  //it is freed by the capture thread itself, see run():
+  if (_stack!=stack) clear_frames=true;
   stack=_stack;
   stack_mutex.unlock();
 }
@@ -79,7 +96,10 @@ CaptureThread::~CaptureThread()
   delete captureDC1394;
   delete captureFiles;
   delete captureGenerator;
+  pipeline.stop();
   delete counter;
+  delete processing;
+  delete process_counter;
 }
 
 void CaptureThread::setFrameBuffer(FrameBuffer * _rb) {
@@ -148,6 +168,7 @@ bool CaptureThread::stop() {
     c_reset->removeFlags( VARTYPE_FLAG_READONLY );
   }
   capture_mutex.unlock();
+  if (res==true) emit captureStopped();
   return res;
 }
 
@@ -155,6 +176,7 @@ bool CaptureThread::reset() {
   capture_mutex.lock();
   bool res = capture->resetBus();
   capture_mutex.unlock();
+  if (res==true) emit captureStopped();
   return res;
 }
 
@@ -165,66 +187,230 @@ void CaptureThread::refresh() {
 }
 
 
-void CaptureThread::run() {
-    CaptureStats * stats;
-    bool changed;
-
-    if (affinity!=0) {
-      affinity->demandCore(camId);
+void CaptureThread::clearFramesIfRequested() {
+  stack_mutex.lock();
+  if (clear_frames) {
+    //waits for readers to let go of their frames:
+    rb->invalidate();
+    for (int i=0;i<rb->size;i++) {
+      rb->getPointer(i)->clear();
     }
+    clear_frames=false;
+  }
+  stack_mutex.unlock();
+}
 
-    while(true) {
-      if (rb!=0) {
-        int idx=rb->curWrite();
-        FrameData * d=rb->getPointer(idx);
-        if ((stats=(CaptureStats *)d->map.get("capture_stats")) == 0) {
-          stats=(CaptureStats *)d->map.insert("capture_stats",new CaptureStats());
-        }
+CaptureStats * CaptureThread::beginFrame(FrameData * d) {
+  CaptureStats * stats;
+  if ((stats=d->map.get(stats_key)) == 0) {
+    stats=d->map.insertOwned(stats_key,new CaptureStats());
+  }
+  d->arena.setLimit((size_t)c_arena_limit->getInt() << 20);
+  d->arena.beginFrame();
+  return stats;
+}
+
+int CaptureThread::claimSlot() {
+  clearFramesIfRequested();
+  stack_mutex.lock();
+  if (c_pipelined->getBool() && stack!=0) {
+    if (pipeline.getStack()!=stack) pipeline.start(stack,rb);
+    //stack_mutex stays locked until the frame is submitted, so that
+    //setStack() cannot stop the pipeline in between. Only call this
+    //once the frame is at hand, as waiting for the camera or the queue
+    //here would block setStack() as well:
+    return pipeline.claim();
+  }
+  //the serial path writes to the ring buffer's own bin:
+  pipeline.stop();
+  stack_mutex.unlock();
+  return rb->curWrite();
+}
+
+void CaptureThread::processSlot(int idx) {
+  if (pipeline.isRunning()) {
+    pipeline.submit(idx);
+    stack_mutex.unlock();
+    return;
+  }
+  FrameData * d=rb->getPointer(idx);
+  stack_mutex.lock();
+  if (stack!=0) {
+    double start=GetTimeSec();
+    stack->process(d);
+    stack->postProcess(d);
+    stack->recordFrameLatency(GetTimeSec()-start);
+  }
+  stack_mutex.unlock();
+  CaptureStats * stats=d->map.get(stats_key);
+  stats->arena_bytes=d->arena.getAllocatedBytes();
+  stats->arena_high_water=d->arena.getHighWaterBytes();
+  rb->publish();
+}
+
+void CaptureThread::captureAndProcess() {
+  CaptureStats * stats;
+  bool changed;
+
+  capture_mutex.lock();
+  if ((capture != 0) && (capture->isCapturing())) {
+    RawImage pic_raw=capture->getFrame();
+    //the slot is only claimed now that the frame has arrived:
+    int idx=claimSlot();
+    FrameData * d=rb->getPointer(idx);
+    stats=beginFrame(d);
+    d->time=pic_raw.getTime();
+    capture->copyAndConvertFrame( pic_raw,d->video);
+    capture_mutex.unlock();
+
+    counter->count();
+    stats->total=d->number=counter->getTotal();
+    d->cam_id=camId;
+    stats->fps_capture=counter->getFPS(changed);
+    stats->queue_latency=0.0;
+    stats->queue_drops=queue.getDroppedCount();
+
+    processSlot(idx);
+
+
+    if (changed) {
+      if (c_auto_refresh->getBool()==true) {
         capture_mutex.lock();
-        if ((capture != 0) && (capture->isCapturing())) {
-          RawImage pic_raw=capture->getFrame();
-          d->time=pic_raw.getTime();
-          capture->copyAndConvertFrame( pic_raw,d->video);
-          capture_mutex.unlock();
+        if ((capture != 0) && (capture->isCapturing())) capture->readAllParameterValues();
+        capture_mutex.unlock();
+      }
+      stack_mutex.lock();
+      stack->updateTimingStatistics();
+      stack_mutex.unlock();
+    }
+    capture_mutex.lock();
+    if ((capture != 0) && (capture->isCapturing())) {
+      capture->releaseFrame();
+    }
+    capture_mutex.unlock();
+
+  } else {
+    counter->getFPS(changed);
+    //we are not capturing...chill this thread out...
+    capture_mutex.unlock();
+    clearFramesIfRequested();
+    usleep(5000);
+  }
+}
 
-          counter->count();
-          stats->total=d->number=counter->getTotal();
-          d->cam_id=camId;
-          stats->fps_capture=counter->getFPS(changed);
+void CaptureThread::captureToQueue() {
+  bool changed=false;
 
-          stack_mutex.lock();
-          if (stack!=0) {
-            stack->process(d);
-            stack->postProcess(d);
-          }
-          stack_mutex.unlock();
-          rb->nextWrite(true);
-
-
-          if (changed) {
-            if (c_auto_refresh->getBool()==true) {
-              capture_mutex.lock();
-              if ((capture != 0) && (capture->isCapturing())) capture->readAllParameterValues();
-              capture_mutex.unlock();
-            }
-            stack_mutex.lock();
-            stack->updateTimingStatistics();
-            stack_mutex.unlock();
-          }
-          capture_mutex.lock();
-          if ((capture != 0) && (capture->isCapturing())) {
-            capture->releaseFrame();
-          }
-          capture_mutex.unlock();
+  queue.setCapacity(c_queue_depth->getInt());
+  capture_mutex.lock();
+  if ((capture != 0) && (capture->isCapturing())) {
+    RawImage pic_raw=capture->getFrame();
+    RawImage & target=queue.beginPush();
+    capture->copyAndConvertFrame( pic_raw,target);
+    target.setTime(pic_raw.getTime());
+    //the camera gets its buffer back before any processing happens:
+    capture->releaseFrame();
+    capture_mutex.unlock();
+
+    counter->count();
+    double fps=counter->getFPS(changed);
+    queue.endPush(counter->getTotal(),fps);
+
+    if (changed && c_auto_refresh->getBool()==true) {
+      capture_mutex.lock();
+      if ((capture != 0) && (capture->isCapturing())) capture->readAllParameterValues();
+      capture_mutex.unlock();
+    }
+  } else {
+    //we are not capturing...chill this thread out...
+    capture_mutex.unlock();
+    usleep(5000);
+  }
+}
+
+void CaptureThread::processQueue() {
+  CaptureStats * stats;
+  bool changed;
+  long long number;
+  double fps;
+  double latency;
+
+  while (processing_enabled) {
+    //the image of the previous slot goes back to the queue:
+    if (queue.pop(popped,number,fps,latency,100)==false) {
+      clearFramesIfRequested();
+      continue;
+    }
+    //the slot is only claimed now that the frame has arrived:
+    int idx=claimSlot();
+    FrameData * d=rb->getPointer(idx);
+    //the frame's image is swapped in, the slot's old one is handed back by the next pop:
+    RawImage old=d->video;
+    d->video=popped;
+    popped=old;
+    stats=beginFrame(d);
+    d->time=d->video.getTime();
+    stats->total=d->number=number;
+    d->cam_id=camId;
+    stats->fps_capture=fps;
+    stats->queue_latency=latency;
+    stats->queue_drops=queue.getDroppedCount();
+
+    processSlot(idx);
 
+    process_counter->count();
+    process_counter->getFPS(changed);
+    if (changed) {
+      stack_mutex.lock();
+      if (stack!=0) stack->updateTimingStatistics();
+      stack_mutex.unlock();
+    }
+  }
+}
+
+void CaptureThread::startProcessing() {
+  queue.flush();
+  processing_enabled=true;
+  processing->start();
+}
+
+void CaptureThread::stopProcessing() {
+  processing_enabled=false;
+  queue.interrupt();
+  processing->wait();
+  queue.flush();
+}
+
+ProcessingThread::ProcessingThread(CaptureThread * _owner) {
+  owner=_owner;
+}
+
+void ProcessingThread::run() {
+  owner->processQueue();
+}
+
+void CaptureThread::run() {
+    //threads started from here on, e.g. for decoupled or pipelined
+    //processing, inherit the camera's cores:
+    if (affinity!=0) {
+      affinity->placeThread(AffinityManager::RoleCamera,camId);
+    }
+
+    while(true) {
+      if (rb!=0) {
+        if (c_decoupled->getBool()) {
+          if (processing_enabled==false) startProcessing();
+          captureToQueue();
         } else {
-          stats->total=d->number=counter->getTotal();
-          stats->fps_capture=counter->getFPS(changed);
-          //we are not capturing...chill this thread out...
-          capture_mutex.unlock();
-          usleep(5000);
+          //the ring buffer only has one writer, so processing stops first:
+          if (processing_enabled) stopProcessing();
+          captureAndProcess();
         }
         if (_kill) {
+          if (processing_enabled) stopProcessing();
+          stack_mutex.lock();
+          pipeline.stop();
+          stack_mutex.unlock();
           capture_mutex.lock();
           if(capture != 0) {
             capture->stopCapture();
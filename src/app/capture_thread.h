@@ -30,6 +30,8 @@
 #include "framecounter.h"
 #include "visionstack.h"
 #include "capturestats.h"
+#include "capture_queue.h"
+#include "vision_pipeline.h"
 #include "affinity_manager.h"
 
 /*!
@@ -37,8 +39,24 @@
   \brief   A thread for capturing and processing video data
   \author  Stefan Zickler, (C) 2008
 */
+class CaptureThread;
+
+/*!
+  \class   ProcessingThread
+  \brief   Runs the vision stack of a CaptureThread in decoupled mode
+*/
+class ProcessingThread : public QThread
+{
+protected:
+  CaptureThread * owner;
+public:
+  ProcessingThread(CaptureThread * _owner);
+  virtual void run();
+};
+
 class CaptureThread : public QThread
 {
+friend class ProcessingThread;
 Q_OBJECT
 protected:
   QMutex stack_mutex; //this mutex protects multi-threaded operations on the stack
@@ -63,9 +81,37 @@ protected:
   VarTrigger * c_reset;
   VarTrigger * c_refresh;
   VarBool * c_auto_refresh;
+  VarInt * c_arena_limit;
+  VarBool * c_decoupled;
+  VarInt * c_queue_depth;
+  VarBool * c_pipelined;
+  bool clear_frames; //set when the stack was replaced
+  FrameDataKey<CaptureStats> stats_key;
+  CaptureQueue queue;
+  ProcessingThread * processing;
+  FrameCounter * process_counter;
+  volatile bool processing_enabled;
+  RawImage popped; //the last image taken from the queue, see processQueue()
+  VisionPipeline pipeline;
   VarStringEnum * captureModule;
   Timer timer;
 
+  void clearFramesIfRequested();
+  CaptureStats * beginFrame(FrameData * d);
+  /// claims the ring buffer bin for a frame that has already been
+  /// captured. Leaves stack_mutex locked for processSlot() if pipelined.
+  int claimSlot();
+  void processSlot(int idx);
+  void captureAndProcess();
+  void captureToQueue();
+  void processQueue();
+  void startProcessing();
+  void stopProcessing();
+
+signals:
+  /// emitted after stop() or reset() succeeded, as no frames follow
+  void captureStopped();
+
 public slots:
   bool init();
   bool stop();
@@ -31,9 +31,17 @@ class CaptureStats {
   public:
   double fps_capture;
   long long total;
+  long long arena_bytes;      //scratch memory of this frame (see FrameArena)
+  long long arena_high_water; //the most this frame slot ever held
+  double queue_latency;       //seconds from capture to processing (decoupled mode only)
+  long long queue_drops;      //frames dropped because processing fell behind
   CaptureStats() {
     fps_capture=0.0;
     total=0;
+    arena_bytes=0;
+    arena_high_water=0;
+    queue_latency=0.0;
+    queue_drops=0;
   }
 };
 
@@ -20,6 +20,115 @@
 //========================================================================
 
 #include "framedata.h"
+#include <stdio.h>
+#include <string.h>
+#include <qmutex.h>
+
+//the registry is shared by all threads; keys are usually resolved at
+//plugin construction, so the lock is not on the per-frame path.
+static QMutex registry_mutex;
+static map<string,int> & registryIndices() {
+  static map<string,int> indices;
+  return indices;
+}
+static vector<string> & registryLabels() {
+  static vector<string> labels;
+  return labels;
+}
+static vector<const char *> & registryTypes() {
+  static vector<const char *> types;
+  return types;
+}
+
+int FrameDataRegistry::registerKey(const string & label, const char * type)
+{
+  QMutexLocker lock(&registry_mutex);
+  map<string,int> & indices=registryIndices();
+  vector<const char *> & types=registryTypes();
+  map<string,int>::iterator iter=indices.find(label);
+  if (iter==indices.end()) {
+    int index=(int)types.size();
+    indices.insert(make_pair(label,index));
+    registryLabels().push_back(label);
+    types.push_back(type);
+    return index;
+  }
+  int index=iter->second;
+  if (type!=0) {
+    if (types[index]==0) {
+      types[index]=type;
+    } else if (types[index]!=type && strcmp(types[index],type)!=0) {
+      fprintf(stderr,"FrameDataRegistry: '%s' is registered as %s, rejecting access as %s\n",
+              label.c_str(),types[index],type);
+      return -1;
+    }
+  }
+  return index;
+}
+
+int FrameDataRegistry::findKey(const string & label)
+{
+  QMutexLocker lock(&registry_mutex);
+  map<string,int> & indices=registryIndices();
+  map<string,int>::const_iterator iter=indices.find(label);
+  if (iter==indices.end()) return -1;
+  return iter->second;
+}
+
+int FrameDataRegistry::getNumKeys()
+{
+  QMutexLocker lock(&registry_mutex);
+  return (int)registryTypes().size();
+}
+
+string FrameDataRegistry::getLabel(int index)
+{
+  QMutexLocker lock(&registry_mutex);
+  vector<string> & labels=registryLabels();
+  if (index < 0 || index >= (int)labels.size()) return "";
+  return labels[index];
+}
+
+void * FrameDataMap::insertSlot(int index, void * item, Deleter deleter)
+{
+  insert_mutex.lock();
+  void * res=storeSlot(index,item,deleter);
+  insert_mutex.unlock();
+  return res;
+}
+
+void * FrameDataMap::storeSlot(int index, void * item, Deleter deleter)
+{
+  if (index < 0) return 0;
+  if (index >= (int)items.size()) {
+    items.resize(index+1,0);
+    deleters.resize(index+1,0);
+  }
+  if (items[index]!=0) return items[index];
+  items[index]=item;
+  deleters[index]=deleter;
+  return item;
+}
+
+void FrameDataMap::reserve(int num_keys)
+{
+  insert_mutex.lock();
+  if (num_keys > (int)items.size()) {
+    items.resize(num_keys,0);
+    deleters.resize(num_keys,0);
+  }
+  insert_mutex.unlock();
+}
+
+void FrameDataMap::clear()
+{
+  for (unsigned int i=0;i<items.size();i++) {
+    if (deleters[i]!=0) deleters[i](items[i]);
+  }
+  //keep the slots allocated, they will be reused:
+  items.assign(items.size(),(void *)0);
+  deleters.assign(deleters.size(),(Deleter)0);
+}
 
 FrameData::FrameData()
 {
@@ -30,6 +139,15 @@ FrameData::FrameData()
 
 
 FrameData::~FrameData()
-{}
+{
+  //items may point into the arena:
+  map.clear();
+}
+
+void FrameData::clear()
+{
+  map.clear();
+  arena.release();
+}
 
 
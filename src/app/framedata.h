@@ -22,33 +22,147 @@
 
 #ifndef FRAMEDATA_H
 #define FRAMEDATA_H
-#include "ringbuffer.h"
+#include <QMutex>
+#include "spmc_ringbuffer.h"
 #include "rawimage.h"
+#include "frame_arena.h"
 #include <map>
+#include <vector>
+#include <string>
+#include <typeinfo>
 using namespace std;
 
+/*!
+  \class   FrameDataRegistry
+  \brief   Assigns every FrameDataMap label a fixed slot index
+
+  All FrameDataMaps share one registry, so a slot index resolved once
+  is valid for every frame. Each label also remembers the type it was
+  first registered with, and typed registrations of the same label with
+  a different type are rejected.
+*/
+class FrameDataRegistry
+{
+public:
+  /// returns the slot of \p label, registering it if needed.
+  /// \p type is the typeid name of the stored type, or 0 for untyped
+  /// access. Returns -1 if \p type conflicts with an earlier registration.
+  static int registerKey(const string & label, const char * type);
+
+  /// returns the slot of \p label, or -1 if it was never registered
+  static int findKey(const string & label);
+
+  static int getNumKeys();
+  static string getLabel(int index);
+};
+
+/*!
+  \class   FrameDataKey
+  \brief   A typed handle to one FrameDataMap slot
+
+  Plugins should resolve their keys once, e.g. as members initialized in
+  their constructor, and then use them for every frame:
+
+  \code
+  FrameDataKey<CMVision::RunList> runlist_key("cmv_runlist");
+  ...
+  CMVision::RunList * runlist=data->map.get(runlist_key);
+  \endcode
+*/
+template <class T> class FrameDataKey
+{
+protected:
+  int index;
+public:
+  explicit FrameDataKey(const string & label) {
+    index=FrameDataRegistry::registerKey(label,typeid(T).name());
+  }
+  int getIndex() const {
+    return index;
+  }
+  bool isValid() const {
+    return index >= 0;
+  }
+};
+
 /*!
   \class   FrameDataMap
   \brief   A general storage map, for plugins to store and read their data
   \author  Stefan Zickler, (C) 2008
 
-  This class acts as a storage map of string and data-pointer pairs.
+  This class acts as a storage map of labeled data-pointers.
   This allows any plugin to make its results publicly available to the
   entire image stack pipeline for the current frame.
+
+  Items are stored in a vector indexed by the FrameDataRegistry slot of
+  their label. Lookups through a FrameDataKey are a bounds check and an
+  array access. The string based functions are kept for convenience,
+  but go through the registry on every call.
+
+  Items added with insertOwned() belong to the map and are deleted by
+  clear() or when the map is destroyed.
 */
-class FrameDataMap : protected map<string,void *>
+class FrameDataMap
 {
+protected:
+  typedef void (*Deleter)(void *);
+  vector<void *> items;
+  vector<Deleter> deleters;
+  QMutex insert_mutex;
+  template <class T> static void deleteItem(void * item) {
+    delete (T *)item;
+  }
+  void * getSlot(int index) const {
+    if (index < 0 || index >= (int)items.size()) return 0;
+    return items[index];
+  }
+  void * insertSlot(int index, void * item, Deleter deleter);
+  void * storeSlot(int index, void * item, Deleter deleter);
+private:
+  FrameDataMap(const FrameDataMap &);
+  FrameDataMap & operator=(const FrameDataMap &);
 public:
+  FrameDataMap() {}
+  ~FrameDataMap() {
+    clear();
+  }
+  template <class T> T * get(const FrameDataKey<T> & key) const {
+    return (T *)getSlot(key.getIndex());
+  }
+  /// the map takes ownership of \p item.
+  /// if the slot is already used, \p item is deleted and the existing one is returned.
+  template <class T> T * insertOwned(const FrameDataKey<T> & key, T * item) {
+    T * res=(T *)insertSlot(key.getIndex(),item,&deleteItem<T>);
+    if (res!=item) delete item;
+    return res;
+  }
+  /// returns the item of \p key, default-constructing it if the slot is empty.
+  /// Unlike get() followed by insertOwned(), this is safe when plugins that run
+  /// at the same time (see PluginScheduler) share an item.
+  template <class T> T * getOrInsertOwned(const FrameDataKey<T> & key) {
+    insert_mutex.lock();
+    T * res=(T *)getSlot(key.getIndex());
+    if (res==0) res=(T *)storeSlot(key.getIndex(),new T(),&deleteItem<T>);
+    insert_mutex.unlock();
+    return res;
+  }
+  /// allocates the slots of the first \p num_keys keys, so that inserting
+  /// into one slot never moves the others while they are read
+  void reserve(int num_keys);
+
   void * get(const string & label) const {
-    map<string,void *>::const_iterator iter = map<string,void *>::find(label);
-    if (iter==map<string,void *>::end()) return 0;
-    return iter->second;
+    return getSlot(FrameDataRegistry::findKey(label));
   }
+  /// stores \p item without taking ownership, unless \p label is already used.
+  /// returns the item stored under \p label.
   void * insert(const string & label, void * item) {
-    pair< map<string,void *>::iterator, bool > pair = map<string,void *>::insert ( make_pair(label,item) );
-    if (pair.first==map<string,void *>::end()) return 0;
-    return pair.first->second;
+    return insertSlot(FrameDataRegistry::registerKey(label,0),item,0);
+  }
+  template <class T> T * insertOwned(const string & label, T * item) {
+    return insertOwned(FrameDataKey<T>(label),item);
   }
+  /// deletes all owned items and forgets all others
+  void clear();
 };
 
 /*!
@@ -59,6 +173,7 @@ public:
   This class acts as the main storage class for any data related to the current frame.
   This includes the frame itself, stored in the \p video RawImage
   Any additional data can be stored in the FrameDataMap \p map
+  Large per-frame scratch buffers should come from the FrameArena \p arena
 */
 class FrameData
 {
@@ -69,17 +184,24 @@ public:
   RawImage video;//the video image from the camera (input)
 
   FrameDataMap map; //all other data
+  FrameArena arena; //scratch memory backing the items in map
 
   FrameData();
 
   ~FrameData();
+
+  /// frees all plugin data, e.g. when the vision stack is replaced
+  void clear();
 };
 
 /*!
   \class   FrameBuffer
-  \brief   A RingBuffer consisting of items of type FrameData
+  \brief   An SPMCRingBuffer consisting of items of type FrameData
   \author  Stefan Zickler, (C) 2008
+
+  The capture thread is the only writer. Display widgets and other
+  readers pin the latest processed frame with acquireLatest().
 */
-typedef RingBuffer<FrameData> FrameBuffer;
+typedef SPMCRingBuffer<FrameData> FrameBuffer;
 
 #endif
@@ -31,10 +31,9 @@ void GLWidget::mouseAction ( QMouseEvent * event, pixelloc loc ) {
   } /* else if ( ( event->buttons() & Qt::LeftButton ) !=0 ) {
     //Left mouse button...color-pick from image.
     if ( rb!=0 ) {
-      rb->lockRead();
-      int idx=rb->curRead();
+      int idx=rb->acquireLatest();
       FrameData * frame = rb->getPointer ( idx );
-      VisualizationFrame * vis_frame=(VisualizationFrame *)(frame->map.get("vis_frame"));
+      VisualizationFrame * vis_frame=frame->map.get(vis_frame_key);
       if (vis_frame!=0 && vis_frame->valid==true) {
 
         rgbImage & img = vis_frame->data;
@@ -46,7 +45,7 @@ void GLWidget::mouseAction ( QMouseEvent * event, pixelloc loc ) {
           }
         }
       }
-      rb->unlockRead();
+      rb->release ( idx );
     }
   }*/
   redraw();
@@ -85,7 +84,8 @@ void GLWidget::paintGL() {
   mainDraw();
 }
 
-GLWidget::GLWidget ( QWidget *parent , bool allow_qpainter_overlay) : QGLWidget ( allow_qpainter_overlay ? QGLFormat(QGL::SampleBuffers) : QGLFormat(), parent ) {
+GLWidget::GLWidget ( QWidget *parent , bool allow_qpainter_overlay) : QGLWidget ( allow_qpainter_overlay ? QGLFormat(QGL::SampleBuffers) : QGLFormat(), parent ),
+  vis_frame_key("vis_frame"), capture_stats_key("capture_stats") {
   ALLOW_QPAINTER=allow_qpainter_overlay;
   rb_bb=0;
   rb=0;
@@ -247,11 +247,10 @@ void GLWidget::myGLdraw() {
     glPushMatrix();
     
       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-      if ( rb!=0 ) {
-        rb->lockRead();
-        int idx=rb->curRead();
+      int idx;
+      if ( rb!=0 && ( idx=rb->acquireLatest() ) >= 0 ) {
         FrameData * frame = rb->getPointer ( idx );
-        VisualizationFrame * vis_frame=(VisualizationFrame *)(frame->map.get("vis_frame"));
+        VisualizationFrame * vis_frame=frame->map.get(vis_frame_key);
         if (vis_frame!=0 && vis_frame->valid==true && vis_frame->data.getData() != 0 && vis_frame->data.getWidth() >= 1 && vis_frame->data.getHeight() >=1 ) {
           rgbImage & img = vis_frame->data;
           if ( img.getWidth() > 1 && img.getHeight() > 1 ) {
@@ -270,7 +269,7 @@ void GLWidget::myGLdraw() {
           }
     
         }
-        rb->unlockRead();
+        rb->release ( idx );
       }
       
       glMatrixMode ( GL_MODELVIEW );
@@ -378,16 +377,16 @@ void GLWidget::myQPainterOverlay(QPainter & painter, QTransform & trans) {
 void GLWidget::saveImage() {
   rgbImage temp;
   if ( rb!=0 ) {
-    rb->lockRead();
-    int idx=rb->curRead();
+    int idx=rb->acquireLatest();
+    if ( idx < 0 ) return;
     FrameData * frame = rb->getPointer ( idx );
 
-    VisualizationFrame * vis_frame=(VisualizationFrame *)(frame->map.get("vis_frame"));
+    VisualizationFrame * vis_frame=frame->map.get(vis_frame_key);
     if (vis_frame !=0 && vis_frame->valid) {
       temp.copy ( vis_frame->data );
-      rb->unlockRead();
+      rb->release ( idx );
     } else {
-      rb->unlockRead();
+      rb->release ( idx );
       return;
     }
   }
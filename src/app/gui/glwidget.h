@@ -77,10 +77,12 @@ protected:
   void mouseMoveEvent ( QMouseEvent * event );
   void paintEvent(QPaintEvent * e);
 
-  RingBuffer<FrameData> * rb_bb;
+  FrameBuffer * rb_bb;
+  FrameDataKey<VisualizationFrame> vis_frame_key;
+  FrameDataKey<CaptureStats> capture_stats_key;
 
 public:
-  virtual void setRingBufferBB(RingBuffer<FrameData> * rb)
+  virtual void setRingBufferBB(FrameBuffer * rb)
   {
     rb_bb=rb;
   }
@@ -136,17 +138,16 @@ public:
     c_loop.count();
 
     if (frame_changed && rb!=0) {
-      rb->lockRead();
-      int cur=rb->curRead();
-      last_frame=rb->getPointer(cur)->number;
-
-      FrameData * frame = rb->getPointer(cur);
-      CaptureStats * cstats = (CaptureStats *)frame->map.get("capture_stats");
-      if (cstats != 0) {
-        stats.capture_stats=(*cstats);
+      int cur=rb->acquireLatest();
+      if (cur >= 0) {
+        FrameData * frame = rb->getPointer(cur);
+        last_frame=frame->number;
+        CaptureStats * cstats = frame->map.get(capture_stats_key);
+        if (cstats != 0) {
+          stats.capture_stats=(*cstats);
+        }
+        rb->release(cur);
       }
-
-      rb->unlockRead();
       redraw();
     }
 
@@ -48,6 +48,7 @@ MainWindow::MainWindow(bool start_capture, bool enforce_affinity)
 
   //load RoboCup SSL stack by default:
   multi_stack=new MultiStackRoboCupSSL(opts, 2);
+  if (affinity!=0) affinity->planPlacement(multi_stack->threads.size());
 
   VarExternal * stackvar;
   root->addChild(stackvar= new VarExternal((multi_stack->getSettingsFileName() + ".xml").c_str(),multi_stack->getName()));
@@ -119,7 +120,8 @@ MainWindow::MainWindow(bool start_capture, bool enforce_affinity)
     splitter2->addWidget(stack_widget);
   }
   
-  if (affinity!=0) affinity->demandCore(multi_stack->threads.size());
+  //the GUI thread stays off the camera cores:
+  if (affinity!=0) affinity->placeThread(AffinityManager::RoleOther);
 
   // Set position and size of main window:
   QSettings window_settings("RoboCup", "ssl-vision");
@@ -172,18 +174,10 @@ void MainWindow::timerEvent( QTimerEvent * e) {
   unsigned int n = display_widgets.size();
   RealTimeDisplayWidget * w;
   bool frame_changed;
-  FrameBuffer * fb;
 
   for (unsigned int i=0;i<n;i++) {
     w = display_widgets[i];
-    frame_changed=false;
-    fb=w->getRingBuffer();
-    if (fb!=0) {
-      fb->lockRead();
-      int cur=fb->curRead();
-      if (fb->nextRead(false) != cur) frame_changed=true;
-      fb->unlockRead();
-    }
+    frame_changed=w->checkFrameChanged();
     w->displayLoopEvent(frame_changed,opts);
   }
 }
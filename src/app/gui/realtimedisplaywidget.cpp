@@ -25,6 +25,14 @@ RealTimeDisplayWidget::RealTimeDisplayWidget(FrameBuffer * _rb) {
   setRingBuffer(_rb);
 }
 
+bool RealTimeDisplayWidget::checkFrameChanged() {
+  if (rb==0) return false;
+  int seq=rb->getLatestSequence();
+  if (seq==last_sequence) return false;
+  last_sequence=seq;
+  return true;
+}
+
 RealTimeDisplayWidget::~RealTimeDisplayWidget() {
 }
 
@@ -34,6 +42,7 @@ FrameBuffer * RealTimeDisplayWidget::getRingBuffer() {
 
 void RealTimeDisplayWidget::setRingBuffer(FrameBuffer * _rb) {
   rb = _rb;
+  last_sequence = 0;
 }
 
 void RealTimeDisplayWidget::displayLoopEvent(bool frame_changed, RenderOptions * opts) {
@@ -22,7 +22,6 @@
 #ifndef RTDISPLAYWIDGET_H_
 #define RTDISPLAYWIDGET_H_
 #include "framedata.h"
-#include "ringbuffer.h"
 #include "videostats.h"
 #include "renderoptions.h"
 
@@ -35,6 +34,7 @@ class RealTimeDisplayWidget {
   protected:
     VideoStats stats;
     FrameBuffer * rb;
+    int last_sequence; //sequence number of the last frame reported by checkFrameChanged()
 
   public:
     RealTimeDisplayWidget(FrameBuffer * _rb = 0);
@@ -43,6 +43,10 @@ class RealTimeDisplayWidget {
     FrameBuffer * getRingBuffer();
     void setRingBuffer(FrameBuffer * _rb);
 
+    //returns true if a frame was completed since the last call.
+    //this only polls a sequence number and never blocks the capture thread.
+    bool checkFrameChanged();
+
     //this function will be called about 1000 times/s on your visualization plugin
     //in most cases you might want to only trigger a render if frame_changed==true
     //which should occur with the same frequency as your camera input
@@ -187,5 +187,7 @@ void VideoWidget::processVideoStats(VideoStats stats)
   //let's display it
   statLabel->setText(
     "Capture: "+ QString::number(stats.capture_stats.fps_capture,'f',2)  + " fps | Display: " + QString::number(stats.fps_draw,'f',2) + " fps | "
-    + QString::number(stats.fps_loop,'f',2) + " its/s");
+    + QString::number(stats.fps_loop,'f',2) + " its/s | Frame memory: "
+    + QString::number(stats.capture_stats.arena_bytes >> 10) + " KB (peak " + QString::number(stats.capture_stats.arena_high_water >> 10) + " KB) | Queue: "
+    + QString::number(stats.capture_stats.queue_latency*1000.0,'f',2) + " ms, " + QString::number(stats.capture_stats.queue_drops) + " dropped");
 }
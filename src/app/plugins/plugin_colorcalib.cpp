@@ -56,9 +56,8 @@ void PluginColorCalibration::mouseEvent( QMouseEvent * event, pixelloc loc) {
   if (tabw->currentWidget() == lutw) {
     if (event->buttons()==Qt::LeftButton) {
       FrameBuffer * rb=getFrameBuffer();
-      if (rb!=0) {
-        rb->lockRead();
-        int idx=rb->curRead();
+      int idx;
+      if (rb!=0 && (idx=rb->acquireLatest()) >= 0) {
         FrameData * frame = rb->getPointer(idx);
         if (loc.x < frame->video.getWidth() && loc.y < frame->video.getHeight() && loc.x >=0 && loc.y >=0) {
           if (frame->video.getWidth() > 1 && frame->video.getHeight() > 1) {
@@ -99,7 +98,7 @@ void PluginColorCalibration::mouseEvent( QMouseEvent * event, pixelloc loc) {
             }
           }
         }
-        rb->unlockRead();
+        rb->release(idx);
       }
       event->accept();
     }
@@ -112,12 +111,11 @@ void PluginColorCalibration::mouseEvent( QMouseEvent * event, pixelloc loc) {
 void PluginColorCalibration::keyPressEvent ( QKeyEvent * event ) {
   if (event->key()==Qt::Key_I) {
     FrameBuffer * rb=getFrameBuffer();
-    if (rb!=0) {
-      rb->lockRead();
-      int idx=rb->curRead();
+    int idx;
+    if (rb!=0 && (idx=rb->acquireLatest()) >= 0) {
       FrameData * frame = rb->getPointer(idx);
       lutw->sampleImage(frame->video);
-      rb->unlockRead();
+      rb->release(idx);
     }
     event->accept();
   } else if (event->key()==Qt::Key_C) {
@@ -21,7 +21,7 @@
 #include "plugin_colorthreshold.h"
 
 PluginColorThreshold::PluginColorThreshold(FrameBuffer * _buffer, YUVLUT * _lut)
- : VisionPlugin(_buffer)
+ : VisionPlugin(_buffer), _threshold_key("cmv_threshold")
 {
   lut=_lut;
 }
@@ -33,13 +33,19 @@ PluginColorThreshold::~PluginColorThreshold()
 
 
 
+bool PluginColorThreshold::getFrameDataAccess(FrameDataAccess & access) {
+  access.read("video");
+  access.write("cmv_threshold");
+  return true;
+}
+
 ProcessResult PluginColorThreshold::process(FrameData * data, RenderOptions * options) {
   (void)options;
   
   Image<raw8> * img_thresholded;
   
-  if ((img_thresholded=(Image<raw8> *)data->map.get("cmv_threshold")) == 0) {
-    img_thresholded=(Image<raw8> *)data->map.insert("cmv_threshold",new Image<raw8>());
+  if ((img_thresholded=data->map.get(_threshold_key)) == 0) {
+    img_thresholded=data->map.insertOwned(_threshold_key,new Image<raw8>());
   }
 
   if (data->video.getColorFormat()==COLOR_YUV422_UYVY) {
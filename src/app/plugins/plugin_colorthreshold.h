@@ -32,12 +32,14 @@ class PluginColorThreshold : public VisionPlugin
 {
 protected:
   YUVLUT * lut;
+  FrameDataKey<Image<raw8> > _threshold_key;
 public:
     PluginColorThreshold(FrameBuffer * _buffer, YUVLUT * _lut);
 
     ~PluginColorThreshold();
 
     virtual ProcessResult process(FrameData * data, RenderOptions * options);
+    virtual bool getFrameDataAccess(FrameDataAccess & access);
 
     virtual VarList * getSettings();
 
@@ -22,20 +22,19 @@
 #include "plugin_detect_balls.h"
 
 PluginDetectBalls::PluginDetectBalls ( FrameBuffer * _buffer, LUT3D * lut, const CameraParameters& camera_params, const RoboCupField& field,PluginDetectBallsSettings * settings )
-    : VisionPlugin ( _buffer ), camera_parameters ( camera_params ), field ( field ) {
+    : VisionPlugin ( _buffer ), camera_parameters ( camera_params ), field ( field ),
+      _detection_frame_key ( "ssl_detection_frame" ), _colorlist_key ( "cmv_colorlist" ), _threshold_key ( "cmv_threshold" ),
+      _frame_key ( "ball_detection_parameters" ) {
   _lut=lut;
 
   _settings=settings;
   _have_local_settings=false;
+  near_robot_declared=true;
   if ( _settings==0 ) {
     _settings = new PluginDetectBallsSettings();
     _have_local_settings=true;
   }
 
-  vnotify.addRecursive(_settings->getSettings());
-  vnotify.addRecursive(field.getSettings());
-
-
   //read-out important LUT data:
   histogram = new CMVision::Histogram ( _lut->getChannelCount() );
   color_id_orange = _lut->getChannelID ( "Orange" );
@@ -47,9 +46,9 @@ PluginDetectBalls::PluginDetectBalls ( FrameBuffer * _buffer, LUT3D * lut, const
   color_id_field = _lut->getChannelID ( "Field Green" );
   if ( color_id_field == -1 ) printf ( "WARNING color label 'Field Green' not defined in LUT!!!\n" );
 
-
-
-
+  vnotify.addRecursive(_settings->getSettings());
+  vnotify.addRecursive(field.getSettings());
+  watchParameters(&vnotify);
 }
 
 
@@ -70,6 +69,85 @@ string PluginDetectBalls::getName() {
   return "DetectBalls";
 }
 
+bool PluginDetectBalls::usesParameterSnapshots() const {
+  return true;
+}
+
+void PluginDetectBalls::publishParameters() {
+  PluginDetectBallsParameters * p = new PluginDetectBallsParameters();
+  p->color_label = _settings->_color_label->getString();
+  p->color_id_ball = _lut->getChannelID ( p->color_label );
+  p->max_balls = _settings->_max_balls->getInt();
+  p->filter.setWidth ( _settings->_ball_min_width->getInt(),_settings->_ball_max_width->getInt() );
+  p->filter.setHeight ( _settings->_ball_min_height->getInt(),_settings->_ball_max_height->getInt() );
+  p->filter.setArea ( _settings->_ball_min_area->getInt(),_settings->_ball_max_area->getInt() );
+  p->field_filter.update ( field );
+
+  p->filter_ball_in_field = _settings->_ball_on_field_filter->getBool();
+  p->filter_ball_on_field_filter_threshold = _settings->_ball_on_field_filter_threshold->getDouble();
+  p->filter_ball_in_goal  = _settings->_ball_in_goal_filter->getBool();
+  p->filter_ball_histogram = _settings->_ball_histogram_enabled->getBool();
+  if ( p->filter_ball_histogram && p->color_id_ball != -1 ) {
+    if ( p->color_id_ball != color_id_orange ) {
+      printf ( "Warning: ball histogram check is only configured for orange balls!\n" );
+      printf ( "Please disable the histogram check in the Ball Detection Plugin settings\n" );
+    }
+    if ( color_id_pink==-1 || color_id_orange==-1 || color_id_yellow==-1 || color_id_field==-1 ) {
+      printf ( "WARNING: some LUT color labels where undefined for the ball detection plugin\n" );
+      printf ( "         Disabling histogram check!\n" );
+      p->filter_ball_histogram=false;
+    }
+  }
+
+  p->min_greenness = _settings->_ball_histogram_min_greenness->getDouble();
+  p->max_markeryness = _settings->_ball_histogram_max_markeryness->getDouble();
+
+  //setup values used for the gaussian confidence measurement:
+  p->filter_gauss = _settings->_ball_gauss_enabled->getBool();
+  p->exp_area_min =  _settings->_ball_gauss_min->getInt();
+  p->exp_area_max = _settings->_ball_gauss_max->getInt();
+  p->exp_area_var = sq ( _settings->_ball_gauss_stddev->getDouble() );
+  p->z_height= _settings->_ball_z_height->getDouble();
+
+  p->near_robot_filter = _settings->_ball_too_near_robot_enabled->getBool();
+  p->near_robot_dist_sq = sq(_settings->_ball_too_near_robot_dist->getDouble());
+  params.publish ( p );
+}
+
+void PluginDetectBalls::beginFrame ( FrameData * data ) {
+  //the frame keeps its own copy, as later frames pick up newer snapshots
+  //while this one is still being processed:
+  const PluginDetectBallsParameters * p = params.pickUp();
+  PluginDetectBallsFrame * frame = data->map.getOrInsertOwned ( _frame_key );
+  frame->valid = ( p!=0 );
+  if ( p!=0 ) frame->params = *p;
+}
+
+const PluginDetectBallsParameters * PluginDetectBalls::frameParameters ( const FrameData * data ) const {
+  const PluginDetectBallsFrame * frame = data->map.get ( _frame_key );
+  if ( frame==0 || frame->valid==false ) return 0;
+  return &frame->params;
+}
+
+bool PluginDetectBalls::needsFrameDataItem ( const FrameData * data, const string & label ) const {
+  const PluginDetectBallsParameters * p = frameParameters ( data );
+  //the thresholded image is only read by the histogram check:
+  if ( label=="cmv_threshold" ) return ( p==0 || p->filter_ball_histogram );
+  return false;
+}
+
+void PluginDetectBalls::addRegionBounds ( const FrameData * data, int color, CMVision::RegionBounds & bounds ) const {
+  const PluginDetectBallsParameters * p = frameParameters ( data );
+  if ( p==0 ) {
+    bounds.addUnrestricted();
+    return;
+  }
+  //only the ball color, only what passes the ball filter, and at most
+  //as many regions as there may be balls:
+  if ( color!=p->color_id_ball ) return;
+  bounds.add ( p->filter, max ( p->max_balls,0 ) );
+}
+
 bool PluginDetectBalls::checkHistogram ( const Image<raw8> * image, const CMVision::Region * reg, double min_greenness, double max_markeryness ) {
   static const int PixelRadius = 4;
 
@@ -106,70 +184,52 @@ public:
   }
 };
 
+bool PluginDetectBalls::getFrameDataAccess ( FrameDataAccess & access ) {
+  access.read ( "cmv_colorlist" );
+  access.read ( "cmv_threshold" );
+  access.write ( "ssl_detection_frame/balls" );
+  //without the near robot filter, this can run alongside the robot detection:
+  near_robot_declared=_settings->_ball_too_near_robot_enabled->getBool();
+  if ( near_robot_declared ) access.read ( "ssl_detection_frame/robots" );
+  return true;
+}
+
 ProcessResult PluginDetectBalls::process ( FrameData * data, RenderOptions * options ) {
   ( void ) options;
   if ( data==0 ) return ProcessingFailed;
 
+  //all settings of this frame, as its queries were answered with:
+  const PluginDetectBallsParameters * p = frameParameters ( data );
+  if ( p==0 ) return ProcessingFailed;
+
   SSL_DetectionFrame * detection_frame = 0;
 
-  detection_frame= ( SSL_DetectionFrame * ) data->map.get ( "ssl_detection_frame" );
-  if ( detection_frame == 0 ) detection_frame= ( SSL_DetectionFrame * ) data->map.insert ( "ssl_detection_frame",new SSL_DetectionFrame() );
+  detection_frame=data->map.getOrInsertOwned ( _detection_frame_key );
 
-  int color_id_ball = _lut->getChannelID ( _settings->_color_label->getString() );
+  int color_id_ball = p->color_id_ball;
   if ( color_id_ball == -1 ) {
-    printf ( "Unknown Ball Detection Color Label: '%s'\nAborting Plugin!\n",_settings->_color_label->getString().c_str() );
+    printf ( "Unknown Ball Detection Color Label: '%s'\nAborting Plugin!\n",p->color_label.c_str() );
     return ProcessingFailed;
   }
 
   //delete any previous detection results:
   detection_frame->clear_balls();
 
-  //TODO: add a vartype notifier for better performance.
-
-  //initialize filter:
-  if (vnotify.hasChanged()) {
-    max_balls = _settings->_max_balls->getInt();
-    filter.setWidth ( _settings->_ball_min_width->getInt(),_settings->_ball_max_width->getInt() );
-    filter.setHeight ( _settings->_ball_min_height->getInt(),_settings->_ball_max_height->getInt() );
-    filter.setArea ( _settings->_ball_min_area->getInt(),_settings->_ball_max_area->getInt() );
-    field_filter.update ( field );
-
-    //copy all vartypes to local variables for faster repeated lookup:
-    filter_ball_in_field = _settings->_ball_on_field_filter->getBool();
-    filter_ball_on_field_filter_threshold = _settings->_ball_on_field_filter_threshold->getDouble();
-    filter_ball_in_goal  = _settings->_ball_in_goal_filter->getBool();
-    filter_ball_histogram = _settings->_ball_histogram_enabled->getBool();
-    if ( filter_ball_histogram ) {
-      if ( color_id_ball != color_id_orange ) {
-        printf ( "Warning: ball histogram check is only configured for orange balls!\n" );
-        printf ( "Please disable the histogram check in the Ball Detection Plugin settings\n" );
-      }
-      if ( color_id_pink==-1 || color_id_orange==-1 || color_id_yellow==-1 || color_id_field==-1 ) {
-        printf ( "WARNING: some LUT color labels where undefined for the ball detection plugin\n" );
-        printf ( "         Disabling histogram check!\n" );
-        filter_ball_histogram=false;
-      }
-    }
-
-    min_greenness = _settings->_ball_histogram_min_greenness->getDouble();
-    max_markeryness = _settings->_ball_histogram_max_markeryness->getDouble();
-
-    //setup values used for the gaussian confidence measurement:
-    filter_gauss = _settings->_ball_gauss_enabled->getBool();
-    exp_area_min =  _settings->_ball_gauss_min->getInt();
-    exp_area_max = _settings->_ball_gauss_max->getInt();
-    exp_area_var = sq ( _settings->_ball_gauss_stddev->getDouble() );
-    z_height= _settings->_ball_z_height->getDouble();
-
-    near_robot_filter = _settings->_ball_too_near_robot_enabled->getBool();
-    near_robot_dist_sq = sq(_settings->_ball_too_near_robot_dist->getDouble());
-  }
+  CMVision::RegionFilter filter = p->filter;
+  FieldFilter field_filter = p->field_filter;
+  int max_balls = p->max_balls;
+  bool filter_ball_in_field = p->filter_ball_in_field;
+  double filter_ball_on_field_filter_threshold = p->filter_ball_on_field_filter_threshold;
+  bool filter_ball_in_goal = p->filter_ball_in_goal;
+  bool filter_ball_histogram = p->filter_ball_histogram;
+  bool filter_gauss = p->filter_gauss;
+  double z_height = p->z_height;
 
   const CMVision::Region * reg = 0;
 
   //acquire orange region list from data-map:
   CMVision::ColorRegionList * colorlist;
-  colorlist= ( CMVision::ColorRegionList * ) data->map.get ( "cmv_colorlist" );
+  colorlist=data->map.get ( _colorlist_key );
   if ( colorlist==0 ) {
     printf ( "error in ball detection plugin: no region-lists were found!\n" );
     return ProcessingFailed;
@@ -177,7 +237,7 @@ ProcessResult PluginDetectBalls::process ( FrameData * data, RenderOptions * opt
   reg = colorlist->getRegionList ( color_id_ball ).getInitialElement();
 
   //acquire color-labeled image from data-map:
-  const Image<raw8> * image = ( Image<raw8> * ) ( data->map.get ( "cmv_threshold" ) );
+  const Image<raw8> * image = data->map.get ( _threshold_key );
   if ( image==0 ) {
     printf ( "error in ball detection plugin: no color-thresholded image was found!\n" );
     return ProcessingFailed;
@@ -185,9 +245,11 @@ ProcessResult PluginDetectBalls::process ( FrameData * data, RenderOptions * opt
 
   int robots_blue_n=0;
   int robots_yellow_n=0;
-  bool use_near_robot_filter=near_robot_filter;
+  //only read the robots if the scheduler was told so:
+  bool use_near_robot_filter=p->near_robot_filter && near_robot_declared;
+  near_robot_declared=true;
   if ( use_near_robot_filter ) {
-    SSL_DetectionFrame * detection_frame = ( SSL_DetectionFrame * ) data->map.get ( "ssl_detection_frame" );
+    SSL_DetectionFrame * detection_frame = data->map.get ( _detection_frame_key );
     if ( detection_frame==0 ) {
       use_near_robot_filter=false;
     } else {
@@ -205,8 +267,8 @@ ProcessResult PluginDetectBalls::process ( FrameData * data, RenderOptions * opt
       float conf = 1.0;
 
       if ( filter_gauss==true ) {
-        int a = reg->area - bound ( reg->area,exp_area_min,exp_area_max );
-        conf = gaussian ( a / exp_area_var );
+        int a = reg->area - bound ( reg->area,p->exp_area_min,p->exp_area_max );
+        conf = gaussian ( a / p->exp_area_var );
       }
 
       //TODO: add a plugin for confidence masking... possibly multi-layered.
@@ -248,7 +310,7 @@ ProcessResult PluginDetectBalls::process ( FrameData * data, RenderOptions * opt
             for (int r = 0; r < robots_n; r++) {
               const SSL_DetectionRobot & robot = robots->Get(r);
               if (robot.confidence() > 0.0) {
-                if ((sq((double)(robot.x())-(double)(field_pos.x)) + sq((double)(robot.y())-(double)(field_pos.y))) < near_robot_dist_sq) {
+                if ((sq((double)(robot.x())-(double)(field_pos.x)) + sq((double)(robot.y())-(double)(field_pos.y))) < p->near_robot_dist_sq) {
                   conf = 0.0;
                   break;
                 }
@@ -260,7 +322,7 @@ ProcessResult PluginDetectBalls::process ( FrameData * data, RenderOptions * opt
       }
 
       // histogram check if enabled
-      if ( filter_ball_histogram && conf > 0.0 && checkHistogram ( image, reg, min_greenness, max_markeryness ) ==false ) {
+      if ( filter_ball_histogram && conf > 0.0 && checkHistogram ( image, reg, p->min_greenness, p->max_markeryness ) ==false ) {
         conf = 0.0;
       }
 
@@ -30,6 +30,7 @@
 #include "vis_util.h"
 #include "VarNotifier.h"
 #include "lut3d.h"
+#include "parameter_snapshot.h"
 /**
 	@author Author Name
 */
@@ -113,13 +114,14 @@ public:
 
 };
 
-class PluginDetectBalls : public VisionPlugin
-{
-protected:
-  //-----------------------------
-  //local copies of the vartypes tree for better performance
-  //these are updated automatically if a change is reported by vartypes
-  VarNotifier vnotify;
+/// the settings of PluginDetectBalls, as seen by one frame
+class PluginDetectBallsParameters {
+public:
+  int color_id_ball;
+  string color_label;
+  int max_balls;
+  CMVision::RegionFilter filter;
+  FieldFilter field_filter;
   bool filter_ball_in_field;
   double filter_ball_on_field_filter_threshold;
   bool filter_ball_in_goal;
@@ -133,13 +135,29 @@ protected:
   double z_height;
   bool near_robot_filter;
   double near_robot_dist_sq;
-  int max_balls;
+};
+
+/// the settings a frame is processed with, copied into it by beginFrame()
+class PluginDetectBallsFrame {
+public:
+  bool valid; //false until the first snapshot was published
+  PluginDetectBallsParameters params;
+  PluginDetectBallsFrame() {
+    valid=false;
+  }
+};
+
+class PluginDetectBalls : public VisionPlugin
+{
+protected:
   //-----------------------------
-  
-  
-  
-  
-  
+  //a copy of the vartypes tree for every frame, see publishParameters().
+  //only beginFrame() picks it up, and copies it into the frame:
+  VarNotifier vnotify;
+  ParameterSnapshot<PluginDetectBallsParameters> params;
+  bool near_robot_declared; //whether the last getFrameDataAccess() allowed reading the robots
+  //-----------------------------
+
   LUT3D * _lut;
   PluginDetectBallsSettings * _settings; 
   bool _have_local_settings;
@@ -150,13 +168,17 @@ protected:
 
   CMVision::Histogram * histogram;
 
-  CMVision::RegionFilter filter;
-
   const CameraParameters& camera_parameters;
   const RoboCupField& field;
 
-  FieldFilter field_filter;
+  FrameDataKey<SSL_DetectionFrame> _detection_frame_key;
+  FrameDataKey<CMVision::ColorRegionList> _colorlist_key;
+  FrameDataKey<Image<raw8> > _threshold_key;
+  FrameDataKey<PluginDetectBallsFrame> _frame_key;
 
+  virtual void publishParameters();
+  /// the settings of the frame \p data, or 0 if there are none yet
+  const PluginDetectBallsParameters * frameParameters(const FrameData * data) const;
   bool checkHistogram(const Image<raw8> * image, const CMVision::Region * reg, double min_greenness=0.5, double max_markeryness=2.0);
 
 public:
@@ -164,7 +186,12 @@ public:
 
     ~PluginDetectBalls();
 
+    virtual void beginFrame(FrameData * data);
     virtual ProcessResult process(FrameData * data, RenderOptions * options);
+    virtual bool needsFrameDataItem(const FrameData * data, const string & label) const;
+    virtual void addRegionBounds(const FrameData * data, int color, CMVision::RegionBounds & bounds) const;
+    virtual bool getFrameDataAccess(FrameDataAccess & access);
+    virtual bool usesParameterSnapshots() const;
     virtual VarList * getSettings();
     virtual string getName();
 };
@@ -21,7 +21,9 @@
 #include "plugin_detect_robots.h"
 
 PluginDetectRobots::PluginDetectRobots(FrameBuffer * _buffer, LUT3D * lut, const CameraParameters& camera_params, const RoboCupField& field, CMPattern::TeamSelector * _global_team_selector_blue, CMPattern::TeamSelector * _global_team_selector_yellow)
- : VisionPlugin(_buffer), camera_parameters(camera_params), field(field)
+ : VisionPlugin(_buffer), camera_parameters(camera_params), field(field),
+   _detection_frame_key("ssl_detection_frame"), _colorlist_key("cmv_colorlist"), _threshold_key("cmv_threshold"),
+   _reads_key("robot_detection_reads")
 {
   _lut=lut;
 
@@ -46,6 +48,9 @@ PluginDetectRobots::PluginDetectRobots(FrameBuffer * _buffer, LUT3D * lut, const
 
   team_detector_blue=new CMPattern::TeamDetector(_lut,camera_params,field);
   team_detector_yellow=new CMPattern::TeamDetector(_lut,camera_params,field);
+  _generation_requested=0;
+  _generation_initialized=-1;
+  _published_robots[0]=_published_robots[1]=0;
 
   _settings=new VarList("Robot Detection");
   _notifier.addRecursive(_settings);
@@ -66,6 +71,58 @@ string PluginDetectRobots::getName() {
   return "DetectRobots";
 }
 
+void PluginDetectRobots::beginFrame(FrameData * data) {
+  PluginDetectRobotsReads * reads=data->map.getOrInsertOwned(_reads_key);
+  if (_notifier.hasChanged()) _generation_requested++;
+  _published_mutex.lock();
+  if (_published_reads.generation==_generation_requested) {
+    *reads=_published_reads;
+    _published_mutex.unlock();
+    return;
+  }
+  _published_mutex.unlock();
+  //the detectors get re-initialized with new filters when this frame is processed:
+  reads->generation=_generation_requested;
+  reads->threshold_image=true;
+  reads->bounds.resize(_lut->getChannelCount());
+  for (unsigned int c=0;c<reads->bounds.size();c++) {
+    reads->bounds[c].clear();
+    reads->bounds[c].addUnrestricted();
+  }
+}
+
+void PluginDetectRobots::publishReads(int generation, const int * max_robots) {
+  PluginDetectRobotsReads reads;
+  reads.generation=generation;
+  //the thresholded image is only read by the team detectors' histogram checks:
+  reads.threshold_image=(team_detector_blue->isHistogramEnabled() || team_detector_yellow->isHistogramEnabled());
+  reads.bounds.resize(_lut->getChannelCount());
+  for (int c=0;c<(int)reads.bounds.size();c++) {
+    team_detector_blue->addRegionBounds(c,color_id_blue,max_robots[0],reads.bounds[c]);
+    team_detector_yellow->addRegionBounds(c,color_id_yellow,max_robots[1],reads.bounds[c]);
+  }
+  _published_robots[0]=max_robots[0];
+  _published_robots[1]=max_robots[1];
+  _published_mutex.lock();
+  _published_reads=reads;
+  _published_mutex.unlock();
+}
+
+bool PluginDetectRobots::needsFrameDataItem(const FrameData * data, const string & label) const {
+  const PluginDetectRobotsReads * reads=data->map.get(_reads_key);
+  if (label=="cmv_threshold") return (reads==0 || reads->threshold_image);
+  return false;
+}
+
+void PluginDetectRobots::addRegionBounds(const FrameData * data, int color, CMVision::RegionBounds & bounds) const {
+  const PluginDetectRobotsReads * reads=data->map.get(_reads_key);
+  if (reads==0 || color < 0 || color >= (int)reads->bounds.size()) {
+    bounds.addUnrestricted();
+    return;
+  }
+  bounds.add(reads->bounds[color]);
+}
+
 void PluginDetectRobots::buildRegionTree(CMVision::ColorRegionList * colorlist) {
   reg_tree.clear();
   int num_colors=colorlist->getNumColorRegions();
@@ -82,6 +139,15 @@ void PluginDetectRobots::buildRegionTree(CMVision::ColorRegionList * colorlist)
   reg_tree.build();
 }
 
+bool PluginDetectRobots::getFrameDataAccess(FrameDataAccess & access)
+{
+  access.read("cmv_colorlist");
+  access.read("cmv_threshold");
+  //the ball detector fills the balls of the same frame:
+  access.write("ssl_detection_frame/robots");
+  return true;
+}
+
 ProcessResult PluginDetectRobots::process(FrameData * data, RenderOptions * options)
 {
   (void)options;
@@ -89,19 +155,24 @@ ProcessResult PluginDetectRobots::process(FrameData * data, RenderOptions * opti
 
   SSL_DetectionFrame * detection_frame = 0;
 
-  detection_frame=(SSL_DetectionFrame *)data->map.get("ssl_detection_frame");
-  if (detection_frame == 0) detection_frame=(SSL_DetectionFrame *)data->map.insert("ssl_detection_frame",new SSL_DetectionFrame());
+  detection_frame=data->map.getOrInsertOwned(_detection_frame_key);
+
+  const PluginDetectRobotsReads * reads=data->map.get(_reads_key);
+  if (reads==0) {
+    printf("error in robot detection plugin: beginFrame() was not called for this frame!\n");
+    return ProcessingFailed;
+  }
 
   //acquire orange region list from data-map:
   CMVision::ColorRegionList * colorlist;
-  colorlist=(CMVision::ColorRegionList *)data->map.get("cmv_colorlist");
+  colorlist=data->map.get(_colorlist_key);
   if (colorlist==0) {
     printf("error in robot detection plugin: no region-lists were found!\n");
     return ProcessingFailed;
   }
 
   //acquire color-labeled image from data-map:
-  const Image<raw8> * image = (Image<raw8> *)(data->map.get("cmv_threshold"));
+  const Image<raw8> * image = data->map.get(_threshold_key);
   if (image==0) {
     printf("error in robot detection plugin: no color-thresholded image was found!\n");
     return ProcessingFailed;
@@ -112,11 +183,13 @@ ProcessResult PluginDetectRobots::process(FrameData * data, RenderOptions * opti
   
   int color_id;
   int num_robots;
+  int max_robots[2];
   CMPattern::TeamDetector * detector;
   //TODO: lookup color label from LUT
 
   buildRegionTree(colorlist);
-  bool need_reinit=_notifier.hasChanged();
+  //the first frame of a new generation, whose reads were unrestricted:
+  bool need_reinit=(reads->generation!=_generation_initialized);
 
   for (int team_i = 0; team_i < 2; team_i++) {
     //team_i: 0==blue, 1==yellow
@@ -135,6 +208,7 @@ ProcessResult PluginDetectRobots::process(FrameData * data, RenderOptions * opti
       robotlist=detection_frame->mutable_robots_yellow();
       detector=team_detector_yellow;
     }
+    max_robots[team_i]=num_robots;
     if (team!=0) {
       if (need_reinit) {
         detector->init(team);
@@ -148,6 +222,13 @@ ProcessResult PluginDetectRobots::process(FrameData * data, RenderOptions * opti
 //    printf("DETECTED %d robots on team %d\n",robotlist->size(),team_i);
 //    fflush(stdout);
   }
+  if (need_reinit) {
+    _generation_initialized=reads->generation;
+    publishReads(_generation_initialized,max_robots);
+  } else if (max_robots[0]!=_published_robots[0] || max_robots[1]!=_published_robots[1]) {
+    //the published region counts are out of date; start a new generation:
+    _notifier.changeSlotOtherChange();
+  }
   return ProcessingOk;
 
 }
@@ -32,6 +32,18 @@
 #include "vis_util.h"
 #include "lut3d.h"
 #include "VarNotifier.h"
+/// what PluginDetectRobots reads in one frame, as settled by beginFrame()
+class PluginDetectRobotsReads {
+public:
+  int generation; //of the team detector settings the frame is processed with
+  bool threshold_image; //whether the histogram checks read "cmv_threshold"
+  vector<CMVision::RegionBounds> bounds; //per LUT channel
+  PluginDetectRobotsReads() {
+    generation=-1;
+    threshold_image=true;
+  }
+};
+
 /**
 	@author Author Name
 */
@@ -63,6 +75,22 @@ protected:
   const CameraParameters& camera_parameters;
   const RoboCupField& field;
 
+  FrameDataKey<SSL_DetectionFrame> _detection_frame_key;
+  FrameDataKey<CMVision::ColorRegionList> _colorlist_key;
+  FrameDataKey<Image<raw8> > _threshold_key;
+  FrameDataKey<PluginDetectRobotsReads> _reads_key;
+
+  //the team detectors are only touched by process(). Every settings change
+  //starts a new generation in beginFrame(), and the first frame of it
+  //re-initializes the detectors. What they read is then published for
+  //beginFrame() to copy into the frames of that generation:
+  int _generation_requested; //by beginFrame() only
+  int _generation_initialized; //by process() only
+  QMutex _published_mutex;
+  PluginDetectRobotsReads _published_reads;
+  int _published_robots[2]; //the max robot counts of blue and yellow they are for
+  void publishReads(int generation, const int * max_robots);
+
   void buildRegionTree(CMVision::ColorRegionList * colorlist);
 
 protected slots:
@@ -73,6 +101,10 @@ public:
     ~PluginDetectRobots();
 
     virtual ProcessResult process(FrameData * data, RenderOptions * options);
+    virtual void beginFrame(FrameData * data);
+    virtual bool needsFrameDataItem(const FrameData * data, const string & label) const;
+    virtual void addRegionBounds(const FrameData * data, int color, CMVision::RegionBounds & bounds) const;
+    virtual bool getFrameDataAccess(FrameDataAccess & access);
     virtual VarList * getSettings();
     virtual string getName();
 };
@@ -21,15 +21,50 @@
 #include "plugin_find_blobs.h"
 
 PluginFindBlobs::PluginFindBlobs(FrameBuffer * _buffer, YUVLUT * _lut, int _max_regions)
- : VisionPlugin(_buffer)
+ : VisionPlugin(_buffer), _runlist_key("cmv_runlist"), _reglist_key("cmv_reglist"), _colorlist_key("cmv_colorlist")
 {
   lut=_lut;
   max_regions=_max_regions;
+  regions_wanted=0;
 
   _settings=new VarList("Blob Finding");
   _settings->addChild(_v_min_blob_area=new VarInt("min_blob_area", 5));
   _settings->addChild(_v_enable=new VarBool("enable", true));
+  //drop regions that no downstream plugin accepts:
+  _settings->addChild(_v_early_rejection=new VarBool("early rejection", true));
+  //with early rejection, also drop the regions past the largest ones the
+  //downstream plugins read at most, e.g. the max ball count:
+  _settings->addChild(_v_limit_count=new VarBool("limit region count", false));
+  _settings->addChild(_v_dropped=new VarList("dropped regions"));
+  for (int i=0;i<lut->getChannelCount();i++) {
+    VarInt * count=new VarInt(lut->getChannel(i).label, 0);
+    count->addFlags(VARTYPE_FLAG_READONLY);
+    _v_dropped->addChild(count);
+    _v_dropped_counts.push_back(count);
+  }
+  _consumers=0;
+  _notifier.addItem(_v_min_blob_area);
+  _notifier.addItem(_v_enable);
+  _notifier.addItem(_v_early_rejection);
+  _notifier.addItem(_v_limit_count);
+  watchParameters(&_notifier);
+}
 
+void PluginFindBlobs::publishParameters() {
+  PluginFindBlobsParameters * p=new PluginFindBlobsParameters();
+  p->min_blob_area=_v_min_blob_area->getInt();
+  p->enable=_v_enable->getBool();
+  p->early_rejection=_v_early_rejection->getBool();
+  p->limit_count=_v_limit_count->getBool();
+  params.publish(p);
+}
+
+bool PluginFindBlobs::usesParameterSnapshots() const {
+  return true;
+}
+
+void PluginFindBlobs::setConsumers(const vector<VisionPlugin *> * consumers) {
+  _consumers=consumers;
 }
 
 
@@ -39,27 +74,42 @@ PluginFindBlobs::~PluginFindBlobs()
 
 
 
+bool PluginFindBlobs::getFrameDataAccess(FrameDataAccess & access) {
+  access.read("cmv_runlist");
+  access.write("cmv_reglist");
+  access.write("cmv_colorlist");
+  access.write("arena");
+  return true;
+}
+
 ProcessResult PluginFindBlobs::process(FrameData * data, RenderOptions * options) {
   (void)options;
+  const PluginFindBlobsParameters * p=params.pickUp();
+  if (p==0) return ProcessingFailed;
 
 
   CMVision::RegionList * reglist;
-  if ((reglist=(CMVision::RegionList *)data->map.get("cmv_reglist")) == 0) {
-    reglist=(CMVision::RegionList *)data->map.insert("cmv_reglist",new CMVision::RegionList(max_regions));
+  if ((reglist=data->map.get(_reglist_key)) == 0) {
+    reglist=data->map.insertOwned(_reglist_key,new CMVision::RegionList(0));
   }
+  //the regions live in the frame's arena, growing past max_regions if a frame needs more:
+  int regions=max(max_regions,regions_wanted);
+  size_t region_bytes=0;
+  void * storage=data->arena.allocate("cmv_reglist",CMVision::RegionList::getStorageSize(regions),&region_bytes);
+  reglist->setStorage(storage,region_bytes/CMVision::RegionList::getStorageSize(1));
 
   CMVision::ColorRegionList * colorlist;
-  if ((colorlist=(CMVision::ColorRegionList *)data->map.get("cmv_colorlist")) == 0) {
-    colorlist=(CMVision::ColorRegionList *)data->map.insert("cmv_colorlist",new CMVision::ColorRegionList(lut->getChannelCount()));
+  if ((colorlist=data->map.get(_colorlist_key)) == 0) {
+    colorlist=data->map.insertOwned(_colorlist_key,new CMVision::ColorRegionList(lut->getChannelCount()));
   }
 
   CMVision::RunList * runlist;
-  if ((runlist=(CMVision::RunList *)data->map.get("cmv_runlist")) == 0) {
+  if ((runlist=data->map.get(_runlist_key)) == 0) {
     printf("Blob finder: no runlength-encoded input list was found!\n");
     return ProcessingFailed;
   }
 
-  if (_v_enable->getBool()==true) {
+  if (p->enable==true) {
     //Connect the components of the runlength map:
     CMVision::RegionProcessing::connectComponents(runlist);
   
@@ -68,13 +118,33 @@ ProcessResult PluginFindBlobs::process(FrameData * data, RenderOptions * options
   
     if (reglist->getUsedRegions() == reglist->getMaxRegions()) {
       printf("Warning: extract regions exceeded maximum number of %d regions\n",reglist->getMaxRegions());
+      regions_wanted=2*reglist->getMaxRegions();
+    } else {
+      regions_wanted=2*reglist->getUsedRegions();
     }
   
+    //Collect the region bounds of all downstream plugins:
+    int num_colors=colorlist->getNumColorRegions();
+    for (int c=0; c<num_colors; c++) {
+      CMVision::RegionBounds & bounds=colorlist->getBounds(c);
+      bounds.clear();
+      if (_consumers!=0 && p->early_rejection) {
+        for (unsigned int i=0;i<_consumers->size();i++) {
+          VisionPlugin * consumer=(*_consumers)[i];
+          if (consumer!=this) consumer->addRegionBounds(data,c,bounds);
+        }
+      }
+    }
+
     //Separate Regions by colors:
-    int max_area = CMVision::RegionProcessing::separateRegions(colorlist, reglist, _v_min_blob_area->getInt());
+    int max_area = CMVision::RegionProcessing::separateRegions(colorlist, reglist, p->min_blob_area);
   
     //Sort Regions:
-    CMVision::RegionProcessing::sortRegions(colorlist,max_area);
+    CMVision::RegionProcessing::sortRegions(colorlist,max_area,p->early_rejection && p->limit_count);
+
+    for (int c=0; c<num_colors && c<(int)_v_dropped_counts.size(); c++) {
+      _v_dropped_counts[c]->setInt(colorlist->getDroppedCount(c));
+    }
   } else {
     //detect nothing.
     reglist->setUsedRegions(0);
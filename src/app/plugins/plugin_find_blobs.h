@@ -24,24 +24,61 @@
 #include <visionplugin.h>
 #include "lut3d.h"
 #include "cmvision_region.h"
+#include "parameter_snapshot.h"
+
+/// the settings of PluginFindBlobs, as seen by one frame
+class PluginFindBlobsParameters {
+public:
+  int min_blob_area;
+  bool enable;
+  bool early_rejection;
+  bool limit_count;
+};
+
 /**
 	@author Stefan Zickler
+
+	If the downstream plugins are known (see setConsumers), regions that
+	none of them would accept (see VisionPlugin::addRegionBounds) are
+	dropped before they enter the color lists. With "limit region count",
+	a color only keeps as many of its largest regions as its consumers
+	read at most. The number of dropped regions per color is shown in the
+	"dropped regions" settings.
 */
 class PluginFindBlobs : public VisionPlugin
 {
 protected:
   YUVLUT * lut;
   int max_regions;
+  int regions_wanted; //region capacity to request next frame, from the last frame's demand
+  FrameDataKey<CMVision::RunList> _runlist_key;
+  FrameDataKey<CMVision::RegionList> _reglist_key;
+  FrameDataKey<CMVision::ColorRegionList> _colorlist_key;
 
   VarList * _settings;
   VarInt * _v_min_blob_area;
   VarBool * _v_enable;
+  VarBool * _v_early_rejection;
+  VarBool * _v_limit_count;
+  VarList * _v_dropped;
+  vector<VarInt *> _v_dropped_counts;
+  const vector<VisionPlugin *> * _consumers;
+
+  VarNotifier _notifier; //only the settings above the dropped counts
+  ParameterSnapshot<PluginFindBlobsParameters> params;
+  virtual void publishParameters();
 public:
     PluginFindBlobs(FrameBuffer * _buffer, YUVLUT * _lut, int _max_regions);
 
     ~PluginFindBlobs();
 
+    /// the plugins that read this plugin's region lists; used to find
+    /// the per-color region bounds. By default, no regions are dropped.
+    void setConsumers(const vector<VisionPlugin *> * consumers);
+
     virtual ProcessResult process(FrameData * data, RenderOptions * options);
+    virtual bool getFrameDataAccess(FrameDataAccess & access);
+    virtual bool usesParameterSnapshots() const;
 
     virtual VarList * getSettings();
 
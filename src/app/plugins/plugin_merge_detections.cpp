@@ -0,0 +1,238 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    plugin_merge_detections.cpp
+  \brief   C++ Implementation: plugin_merge_detections
+  \author  Author Name, 2009
+*/
+//========================================================================
+#include "plugin_merge_detections.h"
+#include "timer.h"
+
+//cameras without a frame for this many of their frame periods are not waited for:
+#define MERGE_TIMEOUT_PERIODS 3.0
+//the frame period assumed until a camera has delivered two frames:
+#define MERGE_DEFAULT_PERIOD (1.0/30.0)
+
+/// the bit of \p camera in the camera masks of the merged entries. like
+/// camera_mask, they have no room for cameras from 32 on.
+static unsigned int cameraBit(unsigned int camera) {
+  return (camera < 32) ? (1u << camera) : 0;
+}
+
+PluginMergeDetections::PluginMergeDetections(FrameBuffer * fb, RoboCupSSLServer * server)
+ : VisionPlugin(fb), _detection_frame_key("ssl_detection_frame")
+{
+  _server=server;
+  setSharedAmongStacks(true);
+  _settings=new VarList("Merged Detection Output");
+  _settings->addChild(merge_enable=new VarBool("Enable",false));
+  _settings->addChild(merge_port=new VarInt("Multicast Port",10006,1,65535));
+  _settings->addChild(_max_skew=new VarDouble("Max Capture Skew (ms)",20.0));
+  _settings->addChild(_robot_distance=new VarDouble("Robot Merge Distance (mm)",150.0));
+  _settings->addChild(_ball_distance=new VarDouble("Ball Merge Distance (mm)",100.0));
+  cycle_size=0;
+  cycle_start=0.0;
+  merged_frames=0;
+}
+
+PluginMergeDetections::~PluginMergeDetections()
+{
+  for (unsigned int i=0;i<pending.size();i++) {
+    delete pending[i];
+  }
+  delete _settings;
+}
+
+VarList * PluginMergeDetections::getSettings() {
+  return _settings;
+}
+
+string PluginMergeDetections::getName() {
+  return "Merge Detections";
+}
+
+bool PluginMergeDetections::getFrameDataAccess(FrameDataAccess & access) {
+  access.read("ssl_detection_frame");
+  return true;
+}
+
+ProcessResult PluginMergeDetections::process(FrameData * data, RenderOptions * options) {
+  (void)options;
+  if (data==0) return ProcessingFailed;
+  if (merge_enable->getBool()==false) return ProcessingOk;
+  SSL_DetectionFrame * detection_frame=data->map.get(_detection_frame_key);
+  if (detection_frame!=0 && data->cam_id >= 0) addFrame(data->cam_id,*detection_frame);
+  return ProcessingOk;
+}
+
+void PluginMergeDetections::addFrame(int camera, const SSL_DetectionFrame & frame) {
+  if (camera >= (int)pending.size()) {
+    while ((int)pending.size() <= camera) pending.push_back(new SSL_DetectionFrame());
+    in_cycle.resize(camera+1,false);
+    last_seen.resize(camera+1,-1e9);
+    period.resize(camera+1,-1.0);
+  }
+  double t=frame.t_capture();
+  //a gap, e.g. after a restart of the capture, is not a frame period:
+  double dt=t-last_seen[camera];
+  if (dt > 0.0 && dt < 1.0) {
+    period[camera]=(period[camera] < 0.0) ? dt : 0.9*period[camera]+0.1*dt;
+  }
+  if (cycle_size > 0 && (in_cycle[camera] || t-cycle_start > _max_skew->getDouble()*1e-3)) {
+    publishCycle();
+  }
+  pending[camera]->CopyFrom(frame);
+  if (cycle_size==0) cycle_start=t;
+  in_cycle[camera]=true;
+  cycle_size++;
+  last_seen[camera]=t;
+
+  for (unsigned int i=0;i<pending.size();i++) {
+    double timeout=MERGE_TIMEOUT_PERIODS*((period[i] < 0.0) ? MERGE_DEFAULT_PERIOD : period[i]);
+    if (in_cycle[i]==false && last_seen[i] > t-timeout) return;
+  }
+  publishCycle();
+}
+
+void PluginMergeDetections::flush() {
+  lock();
+  if (cycle_size > 0) publishCycle();
+  //a stopped camera must not hold back the cycles of the others:
+  for (unsigned int i=0;i<last_seen.size();i++) {
+    last_seen[i]=-1e9;
+    period[i]=-1.0;
+  }
+  unlock();
+}
+
+void PluginMergeDetections::publishCycle() {
+  merged.Clear();
+  weights_blue.clear();
+  weights_yellow.clear();
+  weights_balls.clear();
+  cameras_blue.clear();
+  cameras_yellow.clear();
+  cameras_balls.clear();
+  double t_capture=0.0;
+  unsigned int cameras=0;
+  for (unsigned int i=0;i<pending.size();i++) {
+    if (in_cycle[i]==false) continue;
+    const SSL_DetectionFrame & f=*pending[i];
+    cameras|=cameraBit(i);
+    t_capture=max(t_capture,f.t_capture());
+    mergeRobots(f.robots_blue(),i,merged.mutable_robots_blue(),weights_blue,cameras_blue,_robot_distance->getDouble());
+    mergeRobots(f.robots_yellow(),i,merged.mutable_robots_yellow(),weights_yellow,cameras_yellow,_robot_distance->getDouble());
+    mergeBalls(f.balls(),i,merged.mutable_balls(),weights_balls,cameras_balls,_ball_distance->getDouble());
+    in_cycle[i]=false;
+  }
+  cycle_size=0;
+  merged.set_frame_number(merged_frames++);
+  merged.set_t_capture(t_capture);
+  merged.set_camera_id(0);
+  merged.set_camera_mask(cameras);
+  merged.set_t_sent(GetTimeSec());
+  _server->send(merged);
+}
+
+void PluginMergeDetections::mergeRobots(const google::protobuf::RepeatedPtrField<SSL_DetectionRobot> & robots, unsigned int camera,
+                                        google::protobuf::RepeatedPtrField<SSL_DetectionRobot> * out, vector<double> & weights,
+                                        vector<unsigned int> & cameras, double distance) {
+  double d2=distance*distance;
+  unsigned int bit=cameraBit(camera);
+  for (int i=0;i<robots.size();i++) {
+    const SSL_DetectionRobot & r=robots.Get(i);
+    int match=-1;
+    for (int j=0;j<out->size();j++) {
+      const SSL_DetectionRobot & m=out->Get(j);
+      //a robot is never seen twice by the same camera:
+      if ((cameras[j] & bit)!=0) continue;
+      if (m.has_robot_id()!=r.has_robot_id()) continue;
+      if (r.has_robot_id() && m.robot_id()!=r.robot_id()) continue;
+      double dx=m.x()-r.x();
+      double dy=m.y()-r.y();
+      if (dx*dx+dy*dy <= d2) {
+        match=j;
+        break;
+      }
+    }
+    if (match < 0) {
+      out->Add()->CopyFrom(r);
+      weights.push_back(r.confidence());
+      cameras.push_back(bit);
+      continue;
+    }
+    cameras[match]|=bit;
+    SSL_DetectionRobot * m=out->Mutable(match);
+    double w=weights[match];
+    double c=r.confidence();
+    if (w+c > 0.0) {
+      m->set_x((m->x()*w + r.x()*c)/(w+c));
+      m->set_y((m->y()*w + r.y()*c)/(w+c));
+    }
+    weights[match]=w+c;
+    if (c > m->confidence()) {
+      //keep the merged position, take the rest from the better view,
+      //its pixel position included:
+      float x=m->x();
+      float y=m->y();
+      m->CopyFrom(r);
+      m->set_x(x);
+      m->set_y(y);
+    }
+  }
+}
+
+void PluginMergeDetections::mergeBalls(const google::protobuf::RepeatedPtrField<SSL_DetectionBall> & balls, unsigned int camera,
+                                       google::protobuf::RepeatedPtrField<SSL_DetectionBall> * out, vector<double> & weights,
+                                       vector<unsigned int> & cameras, double distance) {
+  double d2=distance*distance;
+  unsigned int bit=cameraBit(camera);
+  for (int i=0;i<balls.size();i++) {
+    const SSL_DetectionBall & b=balls.Get(i);
+    int match=-1;
+    for (int j=0;j<out->size();j++) {
+      if ((cameras[j] & bit)!=0) continue;
+      double dx=out->Get(j).x()-b.x();
+      double dy=out->Get(j).y()-b.y();
+      if (dx*dx+dy*dy <= d2) {
+        match=j;
+        break;
+      }
+    }
+    if (match < 0) {
+      out->Add()->CopyFrom(b);
+      weights.push_back(b.confidence());
+      cameras.push_back(bit);
+      continue;
+    }
+    cameras[match]|=bit;
+    SSL_DetectionBall * m=out->Mutable(match);
+    double w=weights[match];
+    double c=b.confidence();
+    if (w+c > 0.0) {
+      m->set_x((m->x()*w + b.x()*c)/(w+c));
+      m->set_y((m->y()*w + b.y()*c)/(w+c));
+    }
+    weights[match]=w+c;
+    if (c > m->confidence()) {
+      float x=m->x();
+      float y=m->y();
+      m->CopyFrom(b);
+      m->set_x(x);
+      m->set_y(y);
+    }
+  }
+}
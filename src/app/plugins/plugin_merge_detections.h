@@ -0,0 +1,110 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    plugin_merge_detections.h
+  \brief   C++ Interface: plugin_merge_detections
+  \author  Author Name, 2009
+*/
+//========================================================================
+#ifndef PLUGIN_MERGE_DETECTIONS_H
+#define PLUGIN_MERGE_DETECTIONS_H
+
+#include <visionplugin.h>
+#include "robocup_ssl_server.h"
+#include "messages_robocup_ssl_detection.pb.h"
+#include "VarTypes.h"
+
+/**
+	@author Author Name
+
+  Merges the detection frames of all cameras into one frame per cycle and
+  publishes it on a port of its own. The plugin is shared among the
+  stacks and runs after their network output, so it sees every camera's
+  frame once it has been stamped.
+
+  A cycle collects one frame per camera, starting with the first frame
+  that arrives. It is published as soon as every camera that delivered a
+  frame within its last three frame periods is in it. It is published early when a
+  frame arrives that is captured more than "Max Capture Skew" after the
+  first one, or that comes from a camera already in the cycle. The merged
+  frame then only holds the cameras that made it. flush() publishes the
+  cycle right away; it is called when a capture stops, as no frame would
+  complete the cycle then.
+
+  Robots of the same team within "Robot Merge Distance" of each other
+  are taken as the same robot if their ids agree, or if neither has an
+  id. Balls within "Ball Merge Distance" of each other are taken as the
+  same ball. Only detections of different cameras are merged, two of the
+  same camera are always two robots or balls. Merged positions are
+  averaged, weighted by confidence. The other values, pixel_x and pixel_y
+  included, all come from the most confident detection, so the pixel
+  position is in the image of that detection's camera.
+
+  The merged frame carries the newest t_capture of its cameras and a
+  frame number of its own. Its camera_id is 0, and its camera_mask
+  tells the cameras it merges, bit i standing for camera i.
+*/
+class PluginMergeDetections : public VisionPlugin
+{
+protected:
+  RoboCupSSLServer * _server;
+  FrameDataKey<SSL_DetectionFrame> _detection_frame_key;
+  VarList * _settings;
+  VarDouble * _max_skew;
+  VarDouble * _robot_distance;
+  VarDouble * _ball_distance;
+
+  vector<SSL_DetectionFrame *> pending; //per camera, the frame of the current cycle
+  vector<bool> in_cycle;
+  vector<double> last_seen; //per camera, t_capture of its latest frame
+  vector<double> period;    //per camera, its average frame period, -1 if unknown
+  int cycle_size;
+  double cycle_start;       //t_capture of the first frame of the cycle
+  unsigned int merged_frames;
+  SSL_DetectionFrame merged;
+  //confidence sums of the entries of merged:
+  vector<double> weights_blue;
+  vector<double> weights_yellow;
+  vector<double> weights_balls;
+  //the cameras in each entry of merged, as in camera_mask:
+  vector<unsigned int> cameras_blue;
+  vector<unsigned int> cameras_yellow;
+  vector<unsigned int> cameras_balls;
+
+  void addFrame(int camera, const SSL_DetectionFrame & frame);
+  void publishCycle();
+  static void mergeRobots(const google::protobuf::RepeatedPtrField<SSL_DetectionRobot> & robots, unsigned int camera,
+                          google::protobuf::RepeatedPtrField<SSL_DetectionRobot> * out, vector<double> & weights,
+                          vector<unsigned int> & cameras, double distance);
+  static void mergeBalls(const google::protobuf::RepeatedPtrField<SSL_DetectionBall> & balls, unsigned int camera,
+                         google::protobuf::RepeatedPtrField<SSL_DetectionBall> * out, vector<double> & weights,
+                         vector<unsigned int> & cameras, double distance);
+public:
+  VarBool * merge_enable;
+  VarInt * merge_port;      //the port of the merged frames
+
+    PluginMergeDetections(FrameBuffer * fb, RoboCupSSLServer * server);
+    virtual ~PluginMergeDetections();
+
+    virtual VarList * getSettings();
+    virtual string getName();
+    virtual ProcessResult process(FrameData * data, RenderOptions * options);
+    virtual bool getFrameDataAccess(FrameDataAccess & access);
+    /// publishes the pending cycle and stops waiting for any camera
+    /// until it delivers again
+    void flush();
+};
+
+#endif
@@ -71,6 +71,12 @@ void PluginPublishGeometry::slotPublishTriggered() {
   unlock();
 }
 
+bool PluginPublishGeometry::getFrameDataAccess(FrameDataAccess & access) {
+  //only sends the calibration, no frame data:
+  (void)access;
+  return true;
+}
+
 ProcessResult PluginPublishGeometry::process(FrameData * data, RenderOptions * options) {
   (void)data;
   (void)options;
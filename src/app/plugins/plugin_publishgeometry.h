@@ -55,6 +55,7 @@ public:
 
     virtual string getName();
     virtual ProcessResult process(FrameData * data, RenderOptions * options);
+    virtual bool getFrameDataAccess(FrameDataAccess & access);
 };
 
 #endif
@@ -21,9 +21,10 @@
 #include "plugin_runlength_encode.h"
 
 PluginRunlengthEncode::PluginRunlengthEncode(FrameBuffer * _buffer, int max_runs)
- : VisionPlugin(_buffer)
+ : VisionPlugin(_buffer), _runlist_key("cmv_runlist"), _threshold_key("cmv_threshold")
 {
   _max_runs=max_runs;
+  _runs_wanted=0;
 }
 
 
@@ -33,16 +34,34 @@ PluginRunlengthEncode::~PluginRunlengthEncode()
 
 
 
+bool PluginRunlengthEncode::getFrameDataAccess(FrameDataAccess & access) {
+  access.read("cmv_threshold");
+  access.write("cmv_runlist");
+  access.write("arena");
+  return true;
+}
+
 ProcessResult PluginRunlengthEncode::process(FrameData * data, RenderOptions * options) {
   (void)options;
 
   CMVision::RunList * runlist;
-  if ((runlist=(CMVision::RunList *)data->map.get("cmv_runlist")) == 0) {
-    runlist=(CMVision::RunList *)data->map.insert("cmv_runlist",new CMVision::RunList(_max_runs));
+  if ((runlist=data->map.get(_runlist_key)) == 0) {
+    runlist=data->map.insertOwned(_runlist_key,new CMVision::RunList(0));
+  }
+  //the runs live in the frame's arena, growing past _max_runs if a frame needs more:
+  size_t run_bytes=0;
+  CMVision::Run * runs=(CMVision::Run *)data->arena.allocate("cmv_runlist",max(_max_runs,_runs_wanted)*sizeof(CMVision::Run),&run_bytes);
+  runlist->setStorage(runs,run_bytes/sizeof(CMVision::Run));
+  if (runs==0 || runlist->getMaxRuns() <= 0) {
+    //the encoders write a run before checking for room, so none can be written.
+    //the list is left empty, and the next frame asks for the default size again:
+    printf("Runlength encoder: could not allocate %d runs\n",max(_max_runs,_runs_wanted));
+    _runs_wanted=0;
+    return ProcessingFailed;
   }
 
   Image<raw8> * img_thresholded = 0;
-  if ((img_thresholded=(Image<raw8> *)data->map.get("cmv_threshold")) == 0) {
+  if ((img_thresholded=data->map.get(_threshold_key)) == 0) {
     printf("Runlength encoder: no thresholded input image found!\n");
     return ProcessingFailed;
   }
@@ -51,6 +70,9 @@ ProcessResult PluginRunlengthEncode::process(FrameData * data, RenderOptions * o
   CMVision::RegionProcessing::encodeRuns(img_thresholded, runlist);
   if (runlist->getUsedRuns() == runlist->getMaxRuns()) {
     printf("Warning: runlength encoder exceeded current max run size of %d\n",runlist->getMaxRuns());
+    _runs_wanted=2*runlist->getMaxRuns();
+  } else {
+    _runs_wanted=2*runlist->getUsedRuns();
   }
 
   return ProcessingOk;
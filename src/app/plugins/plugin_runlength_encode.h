@@ -32,12 +32,16 @@ class PluginRunlengthEncode : public VisionPlugin
 {
 protected:
   int _max_runs;
+  int _runs_wanted; //run capacity to request next frame, from the last frame's demand
+  FrameDataKey<CMVision::RunList> _runlist_key;
+  FrameDataKey<Image<raw8> > _threshold_key;
 public:
     PluginRunlengthEncode(FrameBuffer * _buffer, int max_runs);
 
     ~PluginRunlengthEncode();
 
     virtual ProcessResult process(FrameData * data, RenderOptions * options);
+    virtual bool getFrameDataAccess(FrameDataAccess & access);
 
     virtual VarList * getSettings();
 
@@ -20,18 +20,41 @@
 //========================================================================
 #include "plugin_sslnetworkoutput.h"
 
-PluginSSLNetworkOutput::PluginSSLNetworkOutput(FrameBuffer * _fb, RoboCupSSLServer * udp_server, const CameraParameters& camera_params, const RoboCupField& field)
- : VisionPlugin(_fb), _camera_params(camera_params), _field(field)
+PluginSSLNetworkOutput::PluginSSLNetworkOutput(FrameBuffer * _fb, RoboCupSSLServer * udp_server, RoboCupSSLServer * delta_udp_server,
+                                               PluginSSLNetworkOutputSettings * output_settings, const CameraParameters& camera_params, const RoboCupField& field)
+ : VisionPlugin(_fb), _camera_params(camera_params), _field(field), _detection_frame_key("ssl_detection_frame"),
+   _capture_to_send("capture to send"), _send_to_wire("send to wire")
 {
   _udp_server=udp_server;
+  _delta_udp_server=delta_udp_server;
+  _output_settings=output_settings;
+  _settings=new VarList("Oversized Frames");
+  _settings->addChild(_v_fragmented=new VarInt("fragmented frames",0));
+  _settings->addChild(_v_truncated=new VarInt("truncated frames",0));
+  _settings->addChild(_v_dropped=new VarInt("dropped packets",0));
+  _v_fragmented->addFlags(VARTYPE_FLAG_READONLY);
+  _v_truncated->addFlags(VARTYPE_FLAG_READONLY);
+  _v_dropped->addFlags(VARTYPE_FLAG_READONLY);
 }
 
 PluginSSLNetworkOutput::~PluginSSLNetworkOutput()
 {
+  delete _settings;
+}
 
+VarList * PluginSSLNetworkOutput::getSettings()
+{
+  return _settings;
 }
 
 
+bool PluginSSLNetworkOutput::getFrameDataAccess(FrameDataAccess & access)
+{
+  //stamps the frame before sending it:
+  access.write("ssl_detection_frame");
+  return true;
+}
+
 ProcessResult PluginSSLNetworkOutput::process(FrameData * data, RenderOptions * options)
 {
   (void)options;
@@ -39,17 +62,41 @@ ProcessResult PluginSSLNetworkOutput::process(FrameData * data, RenderOptions *
 
   SSL_DetectionFrame * detection_frame = 0;
 
-  detection_frame=(SSL_DetectionFrame *)data->map.get("ssl_detection_frame");
+  detection_frame=data->map.get(_detection_frame_key);
   if (detection_frame != 0) {
     detection_frame->set_t_capture(data->time);
     detection_frame->set_frame_number(data->number);
     detection_frame->set_camera_id(data->cam_id);
     detection_frame->set_t_sent(GetTimeSec());
-    _udp_server->send(*detection_frame);
+    _udp_server->send(*detection_frame,&_send_to_wire,&_counters);
+    if (data->time > 0.0) _capture_to_send.record(detection_frame->t_sent()-data->time);
+    if (_output_settings->delta_enable->getBool()) {
+      _delta_encoder.setKeyframeInterval(_output_settings->delta_keyframe_interval->getInt());
+      _delta_encoder.encode(*detection_frame,_delta_frame);
+      _delta_udp_server->send(_delta_frame);
+    } else {
+      //start over with a keyframe once enabled:
+      _delta_encoder.reset();
+    }
   }
+  _v_fragmented->setInt(_counters.fragmented);
+  _v_truncated->setInt(_counters.truncated);
+  _v_dropped->setInt(_counters.dropped);
   return ProcessingOk;
 }
 
+void PluginSSLNetworkOutput::getLatencyHistograms(vector<LatencyHistogram *> & list) {
+  VisionPlugin::getLatencyHistograms(list);
+  list.push_back(&_capture_to_send);
+  list.push_back(&_send_to_wire);
+}
+
+void PluginSSLNetworkOutput::getCounters(vector<VarInt *> & list) {
+  list.push_back(_v_fragmented);
+  list.push_back(_v_truncated);
+  list.push_back(_v_dropped);
+}
+
 string PluginSSLNetworkOutput::getName() {
   return "Network Output";
 }
@@ -61,6 +108,21 @@ PluginSSLNetworkOutputSettings::PluginSSLNetworkOutputSettings()
   settings->addChild(multicast_address = new VarString("Multicast Address","224.5.23.2"));
   settings->addChild(multicast_port = new VarInt("Multicast Port",10002,1,65535));
   settings->addChild(multicast_interface = new VarString("Multicast Interface",""));
+  //one thread sends the packets of all cameras, batched with sendmmsg():
+  settings->addChild(send_thread = new VarBool("Send Thread",true));
+  //a detection frame larger than this is split or truncated (0 = no limit).
+  //1472 bytes fill an Ethernet frame without IP fragmentation, but split
+  //frames need receivers that reassemble them (see DetectionFrameAssembler),
+  //so this is off unless set:
+  settings->addChild(max_packet_size = new VarInt("Max Packet Size",0,0,65507));
+  settings->addChild(oversized_frames = new VarStringEnum("Oversized Frames","Split"));
+  oversized_frames->addItem("Split");
+  oversized_frames->addItem("Drop Least Confident");
+  //quantized frames, delta-encoded against a keyframe, on a port of their own:
+  settings->addChild(delta_settings = new VarList("Delta Output"));
+  delta_settings->addChild(delta_enable = new VarBool("Enable",false));
+  delta_settings->addChild(delta_port = new VarInt("Multicast Port",10007,1,65535));
+  delta_settings->addChild(delta_keyframe_interval = new VarInt("Keyframe Interval",30,1,10000));
 }
   
 VarList * PluginSSLNetworkOutputSettings::getSettings()
@@ -23,12 +23,18 @@
 
 #include <visionplugin.h>
 #include "robocup_ssl_server.h"
+#include "detection_delta.h"
 #include "camera_calibration.h"
 #include "field.h"
 #include "timer.h"
 
+class PluginSSLNetworkOutputSettings;
+
 /**
 	@author Stefan Zickler
+
+  Besides the full detection frame, it sends the frame delta-encoded to
+  a second server, if "Delta Output" is enabled. See DetectionDeltaEncoder.
 */
 class PluginSSLNetworkOutput : public VisionPlugin
 {
@@ -36,12 +42,29 @@ protected:
  const CameraParameters& _camera_params;
  const RoboCupField& _field;
  RoboCupSSLServer * _udp_server;
+ RoboCupSSLServer * _delta_udp_server;
+ PluginSSLNetworkOutputSettings * _output_settings;
+ DetectionDeltaEncoder _delta_encoder;
+ SSL_DeltaDetectionFrame _delta_frame;
+ FrameDataKey<SSL_DetectionFrame> _detection_frame_key;
+ LatencyHistogram _capture_to_send; //from the capture timestamp to t_sent
+ LatencyHistogram _send_to_wire;    //from t_sent until the socket has the packet
+ RoboCupSSLSendCounters _counters;
+ VarList * _settings;
+ VarInt * _v_fragmented;
+ VarInt * _v_truncated;
+ VarInt * _v_dropped;
 public:
-    PluginSSLNetworkOutput(FrameBuffer * _fb, RoboCupSSLServer * udp_server, const CameraParameters& camera_params, const RoboCupField& field);
+    PluginSSLNetworkOutput(FrameBuffer * _fb, RoboCupSSLServer * udp_server, RoboCupSSLServer * delta_udp_server,
+                           PluginSSLNetworkOutputSettings * output_settings, const CameraParameters& camera_params, const RoboCupField& field);
 
     ~PluginSSLNetworkOutput();
 
     virtual ProcessResult process(FrameData * data, RenderOptions * options);
+    virtual bool getFrameDataAccess(FrameDataAccess & access);
+    virtual void getLatencyHistograms(vector<LatencyHistogram *> & list);
+    virtual void getCounters(vector<VarInt *> & list);
+    virtual VarList * getSettings();
     virtual string getName();
 };
 
@@ -51,6 +74,13 @@ public:
   VarString * multicast_address;
   VarInt * multicast_port;
   VarString * multicast_interface;
+  VarBool * send_thread;
+  VarInt * max_packet_size;
+  VarStringEnum * oversized_frames;
+  VarList * delta_settings;
+  VarBool * delta_enable;
+  VarInt * delta_port;
+  VarInt * delta_keyframe_interval;
 
   PluginSSLNetworkOutputSettings();
   VarList * getSettings();
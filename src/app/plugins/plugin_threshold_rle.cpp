@@ -0,0 +1,379 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    plugin_threshold_rle.cpp
+  \brief   C++ Implementation: plugin_threshold_rle
+  \author  Author Name, 2009
+*/
+//========================================================================
+#include "plugin_threshold_rle.h"
+#include <algorithm>
+
+PluginThresholdRunlengthEncode::PluginThresholdRunlengthEncode(FrameBuffer * _buffer, YUVLUT * _lut, int max_runs)
+ : PluginColorThreshold(_buffer,_lut), _runlist_key("cmv_runlist"), _detection_frame_key("ssl_detection_frame")
+{
+  _max_runs=max_runs;
+  _runs_wanted=0;
+  _consumers=0;
+
+  _settings=new VarList("Segmentation");
+  _settings->addChild(_v_fused=new VarBool("fused threshold + RLE", true));
+  //number of horizontal bands segmented in parallel (1 = serial).
+  //also makes the blob finder connect components band-parallel.
+  _settings->addChild(_v_bands=new VarInt("parallel bands", 1, 1, 64));
+  //encode runs from per-color bitplanes, skipping clear pixels 64 at a time:
+  _settings->addChild(_v_bitplanes=new VarBool("bitplane runs", false));
+
+  //region of interest thresholding, driven by the previous frame's detections:
+  _settings->addChild(_v_roi=new VarBool("ROI thresholding", false));
+  _settings->addChild(_v_roi_padding=new VarInt("ROI padding (px)", 40, 0, 1000));
+  _settings->addChild(_v_roi_stripe=new VarInt("ROI scan stripe (rows)", 32, 0, 10000));
+  _settings->addChild(_v_roi_processed=new VarDouble("processed fraction", 1.0));
+  _v_roi_processed->addFlags(VARTYPE_FLAG_READONLY);
+  _roi_stripe_y=0;
+}
+
+
+PluginThresholdRunlengthEncode::~PluginThresholdRunlengthEncode()
+{
+  delete _settings;
+}
+
+void PluginThresholdRunlengthEncode::setConsumers(const vector<VisionPlugin *> * consumers) {
+  _consumers=consumers;
+}
+
+bool PluginThresholdRunlengthEncode::isThresholdImageNeeded(const FrameData * data) const {
+  if (_consumers==0) return true;
+  unsigned int n=_consumers->size();
+  for (unsigned int i=0;i<n;i++) {
+    VisionPlugin * p=(*_consumers)[i];
+    if (p!=this && p->needsFrameDataItem(data,"cmv_threshold")) return true;
+  }
+  return false;
+}
+
+bool PluginThresholdRunlengthEncode::getFrameDataAccess(FrameDataAccess & access) {
+  access.read("video");
+  access.write("cmv_runlist");
+  access.write("cmv_threshold");
+  //the runs are allocated from the frame's arena:
+  access.write("arena");
+  return true;
+}
+
+ProcessResult PluginThresholdRunlengthEncode::process(FrameData * data, RenderOptions * options) {
+  CMVision::RunList * runlist;
+  if ((runlist=data->map.get(_runlist_key)) == 0) {
+    runlist=data->map.insertOwned(_runlist_key,new CMVision::RunList(0));
+  }
+  //the runs live in the frame's arena, growing past _max_runs if a frame needs more:
+  size_t run_bytes=0;
+  CMVision::Run * runs=(CMVision::Run *)data->arena.allocate("cmv_runlist",max(_max_runs,_runs_wanted)*sizeof(CMVision::Run),&run_bytes);
+  runlist->setStorage(runs,run_bytes/sizeof(CMVision::Run));
+  if (runs==0 || runlist->getMaxRuns() <= 0) {
+    //the encoders write a run before checking for room, so none can be written.
+    //the list is left empty, and the next frame asks for the default size again:
+    printf("Threshold runlength encoder: could not allocate %d runs\n",max(_max_runs,_runs_wanted));
+    _runs_wanted=0;
+    if (data->map.get(_threshold_key) == 0) {
+      data->map.insertOwned(_threshold_key,new Image<raw8>());
+    }
+    return ProcessingFailed;
+  }
+
+  int width=data->video.getWidth();
+  bool fusable=(data->video.getColorFormat()==COLOR_YUV422_UYVY && (width & 0x01)==0);
+
+  if (_v_fused->getBool()==false || fusable==false) {
+    //unfused fallback: threshold the entire image, then encode it.
+    ProcessResult res=PluginColorThreshold::process(data,options);
+    if (res!=ProcessingOk) return res;
+    Image<raw8> * img_thresholded=data->map.get(_threshold_key);
+    CMVision::RegionProcessing::encodeRuns(img_thresholded, runlist);
+  } else {
+    //consumers dereference the image pointer unconditionally, so it always has to exist:
+    Image<raw8> * img_thresholded;
+    if ((img_thresholded=data->map.get(_threshold_key)) == 0) {
+      img_thresholded=data->map.insertOwned(_threshold_key,new Image<raw8>());
+    }
+    ProcessResult res=processFused(data,runlist,img_thresholded,isThresholdImageNeeded(data));
+    if (res!=ProcessingOk) return res;
+  }
+
+  if (runlist->getUsedRuns() == runlist->getMaxRuns()) {
+    printf("Warning: runlength encoder exceeded current max run size of %d\n",runlist->getMaxRuns());
+    _runs_wanted=2*runlist->getMaxRuns();
+  } else {
+    _runs_wanted=2*runlist->getUsedRuns();
+  }
+
+  return ProcessingOk;
+}
+
+//segments horizontal bands of the image, each into its own slice of the run array:
+class ThresholdRunlengthBandJob : public BandJob {
+public:
+  const uyvy * source;
+  int width;
+  int height;
+  YUVLUT * lut;
+  raw8 * image;       //full thresholded image, or 0
+  raw8 * row_buffer;  //one row per band, used if image is 0
+  ColorBitplanes * planes; //one row per band, or 0 to encode from labels
+  const int * row_span_start; //region of interest spans per row, or 0 for full rows
+  const int * row_spans;
+  CMVision::Run * runs;
+  int max_runs;
+  vector<int> band_used;
+
+  int getFirstRow(int band, int num_bands) const { return (int)(((long long)height*band)/num_bands); }
+  int getFirstRun(int band, int num_bands) const { return (int)(((long long)max_runs*band)/num_bands); }
+
+  //thresholds and encodes rows [y_start,y_end), appending runs to runs[num_runs,max_runs).
+  //if row_step is 0, every row is thresholded into the same buffer.
+  //if planes is set, each row is packed into row plane_row of it and encoded from there.
+  //returns the new number of used runs.
+  int segmentRows(int y_start, int y_end, raw8 * row, int row_step, int plane_row, int num_runs, int max_runs) {
+    int macropixels_per_row=width >> 1;
+    for (int y=y_start;y<y_end;y++) {
+      if (row_span_start!=0) {
+        //only threshold the regions of interest. the image row (if anybody
+        //reads it) has to be clear everywhere else:
+        const int * spans=row_spans + 2*row_span_start[y];
+        int num_spans=row_span_start[y+1]-row_span_start[y];
+        if (row_step!=0) fill(row,row+width,raw8(0));
+        for (int i=0;i<num_spans;i++) {
+          int x=spans[2*i];
+          CMVisionThreshold::thresholdSpanYUV422_UYVY(row + x, source + y*macropixels_per_row + (x >> 1), spans[2*i+1]-x, lut);
+        }
+        if (num_runs < max_runs) {
+          num_runs=CMVision::RegionProcessing::encodeRowSpans(row, width, y, spans, num_spans, runs, num_runs, max_runs);
+        } else if (row_step==0) {
+          break;
+        }
+        row+=row_step;
+        continue;
+      }
+      CMVisionThreshold::thresholdSpanYUV422_UYVY(row, source + y*macropixels_per_row, width, lut);
+      if (num_runs < max_runs) {
+        if (planes!=0) {
+          CMVisionThreshold::packBitplanes(planes, plane_row, row);
+          num_runs=CMVision::RegionProcessing::encodeRow(planes, plane_row, y, runs, num_runs, max_runs);
+        } else {
+          num_runs=CMVision::RegionProcessing::encodeRow(row, width, y, runs, num_runs, max_runs);
+        }
+      } else if (row_step==0) {
+        //run list is full and nobody needs the remaining pixels.
+        break;
+      }
+      row+=row_step;
+    }
+    return num_runs;
+  }
+
+  virtual void processBand(int band, int num_bands) {
+    int y_start=getFirstRow(band,num_bands);
+    int y_end=getFirstRow(band+1,num_bands);
+    raw8 * row = image!=0 ? image + y_start*width : row_buffer + band*width;
+    int row_step = image!=0 ? width : 0;
+    band_used[band]=segmentRows(y_start,y_end,row,row_step,band,getFirstRun(band,num_bands),getFirstRun(band+1,num_bands));
+  }
+};
+
+ProcessResult PluginThresholdRunlengthEncode::processFused(FrameData * data, CMVision::RunList * runlist, Image<raw8> * img_thresholded, bool need_image) {
+  int width=data->video.getWidth();
+  int height=data->video.getHeight();
+
+  int num_bands=_v_bands->getInt();
+  if (num_bands > height) num_bands=height;
+  if (num_bands < 1) num_bands=1;
+
+  ThresholdRunlengthBandJob job;
+  job.source=(const uyvy *)(data->video.getData());
+  job.width=width;
+  job.height=height;
+  job.lut=lut;
+  job.runs=runlist->getRunArrayPointer();
+  job.max_runs=runlist->getMaxRuns();
+  job.band_used.resize(num_bands);
+  job.planes=0;
+  job.row_span_start=0;
+  job.row_spans=0;
+  int processed_pixels=width*height;
+  if (_v_roi->getBool() && width > 0 && height > 0) {
+    processed_pixels=buildRowSpans(width,height);
+    job.row_span_start=&_row_span_start[0];
+    job.row_spans=(_row_spans.size() > 0) ? &_row_spans[0] : 0;
+  } else if (_v_bitplanes->getBool()) {
+    _planes.allocate(width,num_bands,lut->getChannelCount(),LUTChannelMode_Numeric);
+    job.planes=&_planes;
+  }
+
+  if (need_image) {
+    img_thresholded->allocate(width,height);
+    job.image=img_thresholded->getPixelData();
+    job.row_buffer=0;
+  } else {
+    //drop any stale image, so nobody can mistake it for this frame's result:
+    img_thresholded->clear();
+    _row_buffer.allocate(width,num_bands);
+    job.image=0;
+    job.row_buffer=_row_buffer.getPixelData();
+  }
+
+  lut->lock();
+  if (num_bands==1) {
+    job.processBand(0,1);
+    runlist->setUsedRuns(job.band_used[0]);
+    runlist->clearBandStarts();
+  } else {
+    BandWorkerPool::run(&job,num_bands);
+
+    //move the band slices together, so the run array looks exactly as if
+    //it had been encoded serially:
+    CMVision::Run * runs=job.runs;
+    vector<int> band_starts;
+    int num_runs=0;
+    for (int b=0;b<num_bands;b++) {
+      int first=job.getFirstRun(b,num_bands);
+      int used=job.band_used[b];
+      band_starts.push_back(num_runs);
+      if (used >= job.getFirstRun(b+1,num_bands)) {
+        //this band ran out of its share of runs. redo the rest of the image
+        //serially, so the list is truncated exactly where the serial encoder
+        //would have stopped.
+        raw8 * row = need_image ? job.image + job.getFirstRow(b,num_bands)*width : job.row_buffer;
+        num_runs=job.segmentRows(job.getFirstRow(b,num_bands),height,row,need_image ? width : 0,0,num_runs,job.max_runs);
+        break;
+      }
+      if (first!=num_runs) {
+        int offset=first-num_runs;
+        for (int i=first;i<used;i++) {
+          runs[i-offset]=runs[i];
+          runs[i-offset].parent-=offset;
+        }
+      }
+      num_runs+=(used-first);
+    }
+    runlist->setUsedRuns(num_runs);
+    runlist->setBandStarts(band_starts);
+  }
+  lut->unlock();
+
+  _v_roi_processed->setDouble((width*height) > 0 ? (double)processed_pixels/(double)(width*height) : 0.0);
+
+  return ProcessingOk;
+}
+
+int PluginThresholdRunlengthEncode::buildRowSpans(int width, int height) {
+  int stripe=_v_roi_stripe->getInt();
+  if (stripe > height) stripe=height;
+  if (stripe < 0) stripe=0;
+  if (_roi_stripe_y >= height) _roi_stripe_y=0;
+
+  //clip the windows to this frame. UYVY spans have to start and end on macropixels:
+  vector<RoiWindow> windows;
+  for (unsigned int i=0;i<_roi_windows.size();i++) {
+    RoiWindow w=_roi_windows[i];
+    w.x1=max(0,w.x1) & ~0x01;
+    w.x2=min(width,(w.x2+1) & ~0x01);
+    w.y1=max(0,w.y1);
+    w.y2=min(height,w.y2);
+    if (w.x1 < w.x2 && w.y1 < w.y2) windows.push_back(w);
+  }
+
+  _row_span_start.resize(height+1);
+  _row_spans.clear();
+  int pixels=0;
+  for (int y=0;y<height;y++) {
+    _row_span_start[y]=_row_spans.size()/2;
+    if (((y - _roi_stripe_y + height) % height) < stripe) {
+      //rotating scan stripe: the full row, to (re-)acquire objects anywhere.
+      _row_spans.push_back(0);
+      _row_spans.push_back(width);
+      pixels+=width;
+      continue;
+    }
+    //windows are sorted by x1, so touching/overlapping ones can be merged in one pass:
+    int x1=-1,x2=-1;
+    for (unsigned int i=0;i<windows.size();i++) {
+      const RoiWindow & w=windows[i];
+      if (y < w.y1 || y >= w.y2) continue;
+      if (x2 >= w.x1) {
+        x2=max(x2,w.x2);
+      } else {
+        if (x2 > x1) {
+          _row_spans.push_back(x1);
+          _row_spans.push_back(x2);
+          pixels+=x2-x1;
+        }
+        x1=w.x1;
+        x2=w.x2;
+      }
+    }
+    if (x2 > x1) {
+      _row_spans.push_back(x1);
+      _row_spans.push_back(x2);
+      pixels+=x2-x1;
+    }
+  }
+  _row_span_start[height]=_row_spans.size()/2;
+
+  _roi_stripe_y=(stripe > 0) ? ((_roi_stripe_y + stripe) % height) : 0;
+  return pixels;
+}
+
+static bool roiWindowLessX(const PluginThresholdRunlengthEncode::RoiWindow & a, const PluginThresholdRunlengthEncode::RoiWindow & b) {
+  return a.x1 < b.x1;
+}
+
+void PluginThresholdRunlengthEncode::addRoiWindow(double pixel_x, double pixel_y, int padding) {
+  RoiWindow w;
+  w.x1=(int)pixel_x - padding;
+  w.x2=(int)pixel_x + padding + 1;
+  w.y1=(int)pixel_y - padding;
+  w.y2=(int)pixel_y + padding + 1;
+  _roi_windows.push_back(w);
+}
+
+void PluginThresholdRunlengthEncode::postProcess(FrameData * data, RenderOptions * options) {
+  (void)options;
+  //the detections of this frame become the regions of interest of the next one:
+  _roi_windows.clear();
+  if (_v_roi->getBool()==false) return;
+  SSL_DetectionFrame * detection_frame=data->map.get(_detection_frame_key);
+  if (detection_frame==0) return;
+
+  int padding=_v_roi_padding->getInt();
+  for (int i=0;i<detection_frame->balls_size();i++) {
+    addRoiWindow(detection_frame->balls(i).pixel_x(),detection_frame->balls(i).pixel_y(),padding);
+  }
+  for (int i=0;i<detection_frame->robots_yellow_size();i++) {
+    addRoiWindow(detection_frame->robots_yellow(i).pixel_x(),detection_frame->robots_yellow(i).pixel_y(),padding);
+  }
+  for (int i=0;i<detection_frame->robots_blue_size();i++) {
+    addRoiWindow(detection_frame->robots_blue(i).pixel_x(),detection_frame->robots_blue(i).pixel_y(),padding);
+  }
+  sort(_roi_windows.begin(),_roi_windows.end(),roiWindowLessX);
+}
+
+VarList * PluginThresholdRunlengthEncode::getSettings() {
+  return _settings;
+}
+
+string PluginThresholdRunlengthEncode::getName() {
+  return "Segmentation+RLE";
+}
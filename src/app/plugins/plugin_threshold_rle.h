@@ -0,0 +1,116 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    plugin_threshold_rle.h
+  \brief   C++ Interface: plugin_threshold_rle
+  \author  Author Name, 2009
+*/
+//========================================================================
+#ifndef PLUGIN_THRESHOLD_RLE_H
+#define PLUGIN_THRESHOLD_RLE_H
+
+#include <visionplugin.h>
+#include "plugin_colorthreshold.h"
+#include "cmvision_region.h"
+#include "lut3d.h"
+#include "band_worker_pool.h"
+#include "messages_robocup_ssl_detection.pb.h"
+
+/**
+	@author Author Name
+	\brief Combined color thresholding and runlength encoding.
+
+	This plugin replaces a PluginColorThreshold followed by a PluginRunlengthEncode.
+	For YUV422 (UYVY) input it thresholds the image row by row and runlength
+	encodes each row while it is still in cache, writing "cmv_runlist" directly.
+
+	The full thresholded image ("cmv_threshold") is only written if one of the
+	consumer plugins reports that it needs it (see VisionPlugin::needsFrameDataItem).
+	Otherwise a single reusable row buffer is used, saving one full-frame
+	memory pass. Other color formats fall back to the unfused two-pass path.
+
+	With "parallel bands" > 1 the image is split into horizontal bands which
+	are segmented on the shared BandWorkerPool. The resulting run list is
+	identical to the serial one; it records where each band starts, so that
+	RegionProcessing::connectComponents can connect the bands in parallel too.
+
+	With "bitplane runs" enabled, each thresholded row is packed into one bit
+	per pixel per color and runs are found with count-trailing-zeros scans,
+	so sparse colors cost next to nothing to encode. The runs are identical.
+	This assumes a numeric LUT, as used by the RoboCup stacks.
+
+	With "ROI thresholding" enabled, only padded windows around the previous
+	frame's ball and robot detections are thresholded and encoded, plus a
+	full-width stripe that moves down the image every frame to (re-)acquire
+	objects. Everything else is treated as clear. The fraction of pixels
+	processed is shown as "processed fraction".
+*/
+class PluginThresholdRunlengthEncode : public PluginColorThreshold
+{
+public:
+  //a region of interest, [x1,x2) x [y1,y2) in image pixels
+  struct RoiWindow {
+    int x1,y1,x2,y2;
+  };
+protected:
+  vector<RoiWindow> _roi_windows;
+
+  int _max_runs;
+  int _runs_wanted; //run capacity to request next frame, from the last frame's demand
+  FrameDataKey<CMVision::RunList> _runlist_key;
+  FrameDataKey<SSL_DetectionFrame> _detection_frame_key;
+  const vector<VisionPlugin *> * _consumers;
+  Image<raw8> _row_buffer;
+
+  VarList * _settings;
+  VarBool * _v_fused;
+  VarInt * _v_bands;
+  VarBool * _v_bitplanes;
+  ColorBitplanes _planes;
+
+  VarBool * _v_roi;
+  VarInt * _v_roi_padding;
+  VarInt * _v_roi_stripe;
+  VarDouble * _v_roi_processed;
+  int _roi_stripe_y;
+  vector<int> _row_span_start;
+  vector<int> _row_spans;
+
+  bool isThresholdImageNeeded(const FrameData * data) const;
+  void addRoiWindow(double pixel_x, double pixel_y, int padding);
+  //fills the per-row spans for this frame and returns the number of pixels they cover:
+  int buildRowSpans(int width, int height);
+  ProcessResult processFused(FrameData * data, CMVision::RunList * runlist, Image<raw8> * img_thresholded, bool need_image);
+public:
+    PluginThresholdRunlengthEncode(FrameBuffer * _buffer, YUVLUT * _lut, int max_runs);
+
+    ~PluginThresholdRunlengthEncode();
+
+    /// sets the plugins that are queried for whether they need the
+    /// thresholded image. If never set, the image is always written.
+    void setConsumers(const vector<VisionPlugin *> * consumers);
+
+    virtual ProcessResult process(FrameData * data, RenderOptions * options);
+    virtual bool getFrameDataAccess(FrameDataAccess & access);
+
+    /// collects the regions of interest for the next frame
+    virtual void postProcess(FrameData * data, RenderOptions * options);
+
+    virtual VarList * getSettings();
+
+    virtual string getName();
+};
+
+#endif
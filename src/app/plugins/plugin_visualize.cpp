@@ -23,7 +23,8 @@
 
 
 PluginVisualize::PluginVisualize(FrameBuffer * _buffer, const CameraParameters& camera_params, const RoboCupField& real_field, const RoboCupCalibrationHalfField& calib_field)
- : VisionPlugin(_buffer), camera_parameters(camera_params), real_field(real_field), calib_field(calib_field)
+ : VisionPlugin(_buffer), camera_parameters(camera_params), real_field(real_field), calib_field(calib_field),
+   _vis_frame_key("vis_frame"), _threshold_key("cmv_threshold"), _colorlist_key("cmv_colorlist")
 {
   _settings=new VarList("Visualization");
   _settings->addChild(_v_enabled=new VarBool("enable", true));
@@ -58,14 +59,36 @@ string PluginVisualize::getName() {
   return "Visualization";
 }
 
+void PluginVisualize::beginFrame(FrameData * data) {
+  VisualizationFrame * vis_frame=data->map.getOrInsertOwned(_vis_frame_key);
+  vis_frame->thresholded=(_v_enabled->getBool() && _v_thresholded->getBool());
+}
+
+bool PluginVisualize::needsFrameDataItem(const FrameData * data, const string & label) const {
+  if (label=="cmv_threshold") {
+    const VisualizationFrame * vis_frame=data->map.get(_vis_frame_key);
+    return (vis_frame==0 || vis_frame->thresholded);
+  }
+  return false;
+}
+
+bool PluginVisualize::getFrameDataAccess(FrameDataAccess & access)
+{
+  access.read("video");
+  access.read("cmv_threshold");
+  access.read("cmv_colorlist");
+  access.write("vis_frame");
+  return true;
+}
+
 ProcessResult PluginVisualize::process(FrameData * data, RenderOptions * options)
 {
   (void)options;
   if (data==0) return ProcessingFailed;
 
   VisualizationFrame * vis_frame;
-  if ((vis_frame=(VisualizationFrame *)data->map.get("vis_frame")) == 0) {
-    vis_frame=(VisualizationFrame *)data->map.insert("vis_frame",new VisualizationFrame());
+  if ((vis_frame=data->map.get(_vis_frame_key)) == 0) {
+    vis_frame=data->map.insertOwned(_vis_frame_key,new VisualizationFrame());
   }
 
   if (_v_enabled->getBool()==true) {
@@ -110,9 +133,10 @@ ProcessResult PluginVisualize::process(FrameData * data, RenderOptions * options
       vis_frame->data.fillBlack();
     }
 
-    if (_v_thresholded->getBool()==true) {
+    //only if the image was asked for when this frame began:
+    if (vis_frame->thresholded==true) {
       if (_threshold_lut!=0) {
-        Image<raw8> * img_thresholded=(Image<raw8> *)(data->map.get("cmv_threshold"));
+        Image<raw8> * img_thresholded=data->map.get(_threshold_key);
         if (img_thresholded!=0) {
           int n = vis_frame->data.getNumPixels();
           if (img_thresholded->getNumPixels()==n) {
@@ -131,7 +155,7 @@ ProcessResult PluginVisualize::process(FrameData * data, RenderOptions * options
     //draw blob finding results:
     if (_v_blobs->getBool()==true) {
       CMVision::ColorRegionList * colorlist;
-      colorlist=(CMVision::ColorRegionList *)data->map.get("cmv_colorlist");
+      colorlist=data->map.get(_colorlist_key);
       if (colorlist!=0) {
         CMVision::RegionLinkedList * regionlist;
         regionlist = colorlist->getColorRegionArrayPointer();
@@ -44,8 +44,10 @@ class VisualizationFrame {
   public:
     rgbImage data;
     bool valid;
+    bool thresholded; //whether the thresholded image is drawn in this frame
     VisualizationFrame() {
       valid=false;
+      thresholded=false;
     }
 };
 
@@ -70,6 +72,10 @@ protected:
   LUT3D * _threshold_lut;
   greyImage* edge_image;
   greyImage* temp_grey_image;
+
+  FrameDataKey<VisualizationFrame> _vis_frame_key;
+  FrameDataKey<Image<raw8> > _threshold_key;
+  FrameDataKey<CMVision::ColorRegionList> _colorlist_key;
   
   void drawFieldLine(double xStart, double yStart, double xEnd, double yEnd, int steps,
                      VisualizationFrame * vis_frame, 
@@ -82,6 +88,9 @@ public:
 
    void setThresholdingLUT(LUT3D * threshold_lut);
    virtual ProcessResult process(FrameData * data, RenderOptions * options);
+   virtual void beginFrame(FrameData * data);
+   virtual bool needsFrameDataItem(const FrameData * data, const string & label) const;
+   virtual bool getFrameDataAccess(FrameDataAccess & access);
    virtual VarList * getSettings();
    virtual string getName();
 };
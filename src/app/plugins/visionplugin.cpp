@@ -21,13 +21,51 @@
 
 #include "visionplugin.h"
 
+void FrameDataAccess::read(const string & label) {
+  reads.push_back(label);
+}
+
+void FrameDataAccess::write(const string & label) {
+  writes.push_back(label);
+}
+
+void FrameDataAccess::clear() {
+  reads.clear();
+  writes.clear();
+}
+
+bool FrameDataAccess::overlaps(const string & a, const string & b) {
+  if (a.size()==b.size()) return a==b;
+  const string & whole=(a.size() < b.size()) ? a : b;
+  const string & part=(a.size() < b.size()) ? b : a;
+  return part.compare(0,whole.size(),whole)==0 && part[whole.size()]=='/';
+}
+
+bool FrameDataAccess::conflictsWith(const FrameDataAccess & other) const {
+  for (unsigned int i=0;i<writes.size();i++) {
+    for (unsigned int j=0;j<other.writes.size();j++) {
+      if (overlaps(writes[i],other.writes[j])) return true;
+    }
+    for (unsigned int j=0;j<other.reads.size();j++) {
+      if (overlaps(writes[i],other.reads[j])) return true;
+    }
+  }
+  for (unsigned int i=0;i<reads.size();i++) {
+    for (unsigned int j=0;j<other.writes.size();j++) {
+      if (overlaps(reads[i],other.writes[j])) return true;
+    }
+  }
+  return false;
+}
+
 VisionPlugin::VisionPlugin(FrameBuffer * _buffer)
 {
   buffer=_buffer;
   enabled=true;
   shared=false;
   visualize=true;
-  setTimeProcessing(0.0);
+  //not recorded in the histogram:
+  time_proc=0.0;
   setTimePostProcessing(0.0);
 }
 
@@ -52,6 +90,24 @@ void VisionPlugin::unlock() {
   mutex.unlock();
 }
 
+bool VisionPlugin::usesParameterSnapshots() const {
+  return false;
+}
+
+void VisionPlugin::watchParameters(VarNotifier * notifier) {
+  connect(notifier,SIGNAL(changeOccured(VarType *)),this,SLOT(slotParametersChanged()),Qt::DirectConnection);
+  slotParametersChanged();
+}
+
+void VisionPlugin::publishParameters() {
+}
+
+void VisionPlugin::slotParametersChanged() {
+  param_mutex.lock();
+  publishParameters();
+  param_mutex.unlock();
+}
+
 bool VisionPlugin::isEnabled() const {
   return enabled;
 }
@@ -91,6 +147,26 @@ ProcessResult VisionPlugin::process(FrameData * data, RenderOptions * options) {
   return ProcessingOk;
 }
 
+void VisionPlugin::beginFrame(FrameData * data) {
+  (void)data;
+}
+
+bool VisionPlugin::needsFrameDataItem(const FrameData * data, const string & label) const {
+  (void)data;
+  (void)label;
+  return false;
+}
+
+void VisionPlugin::addRegionBounds(const FrameData * data, int color, CMVision::RegionBounds & bounds) const {
+  (void)data;
+  (void)color;
+  (void)bounds;
+}
+
+bool VisionPlugin::getFrameDataAccess(FrameDataAccess & access) {
+  (void)access;
+  return false;
+}
 
 void VisionPlugin::postProcess(FrameData * data, RenderOptions * options) {
   (void)data;
@@ -139,6 +215,7 @@ void VisionPlugin::wheelEvent ( QWheelEvent * event, pixelloc loc ) {
 
 void VisionPlugin::setTimeProcessing(double val) {
   time_proc=val;
+  hist_proc.record(val);
 }
 
 void VisionPlugin::setTimePostProcessing(double val) {
@@ -153,6 +230,15 @@ double VisionPlugin::getTimePostProcessing() {
   return time_post;
 }
 
+void VisionPlugin::getLatencyHistograms(vector<LatencyHistogram *> & list) {
+  hist_proc.setName(getName());
+  list.push_back(&hist_proc);
+}
+
+void VisionPlugin::getCounters(vector<VarInt *> & list) {
+  (void)list;
+}
+
 void VisionPlugin::slotKeyPressEvent ( QKeyEvent * event ) {
   keyPressEvent(event);
 }
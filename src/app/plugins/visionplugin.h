@@ -26,19 +26,48 @@
 #include <QMutex>
 #include <QObject>
 #include <string>
+#include <vector>
 
 #include "VarTypes.h"
 #include "framedata.h"
 #include "realtimedisplaywidget.h"
 #include "pixelloc.h"
+#include "latency_histogram.h"
+#include "VarNotifier.h"
 using namespace std;
 using namespace VarTypes;
 
+namespace CMVision {
+  class RegionBounds;
+}
+
 enum ProcessResult {
   ProcessingOk = 0,
   ProcessingFailed = 1,
 };
 
+/*!
+  \class   FrameDataAccess
+  \brief   The FrameData items a plugin reads and writes in process()
+
+  Items are named by their FrameDataMap label. "video" stands for
+  FrameData::video. A label may name a part of an item after a slash,
+  e.g. "ssl_detection_frame/balls". Parts of one item only conflict
+  with each other if they are equal, but every part conflicts with the
+  whole item.
+*/
+class FrameDataAccess {
+public:
+  vector<string> reads;
+  vector<string> writes;
+  void read(const string & label);
+  void write(const string & label);
+  void clear();
+  /// true if the two plugins must not run at the same time
+  bool conflictsWith(const FrameDataAccess & other) const;
+  static bool overlaps(const string & a, const string & b);
+};
+
 /*!
   \class   VisionPlugin
   \brief   A base class for general vision processing plugin
@@ -58,6 +87,19 @@ protected:
     FrameBuffer * buffer;
     double time_proc;
     double time_post;
+    LatencyHistogram hist_proc; //all values passed to setTimeProcessing()
+    QMutex param_mutex; //serializes publishParameters()
+
+    /// calls publishParameters() now and whenever \p notifier reports a
+    /// change, in the thread that made the change. Call this at the end
+    /// of your constructor.
+    void watchParameters(VarNotifier * notifier);
+
+    /// overload this to copy your settings into a new snapshot and
+    /// publish it (see ParameterSnapshot). Calls never overlap.
+    virtual void publishParameters();
+protected slots:
+    void slotParametersChanged();
 public:
 
 
@@ -102,6 +144,46 @@ public:
     /// current frame-data
     virtual ProcessResult process(FrameData * data, RenderOptions * options);
 
+    /// called once for every frame, before any plugin of the stack processes
+    /// it. With a pipelined stack this runs in the thread of the first stage,
+    /// without lock(), while process() may still be busy with an earlier
+    /// frame in another thread: only read settings that are safe to read
+    /// from there (VarTypes, or a ParameterSnapshot picked up only here).
+    /// Overload this to store in \p data what your plugin will read in this
+    /// frame, for needsFrameDataItem() and addRegionBounds() to answer from.
+    virtual void beginFrame(FrameData * data);
+
+    /// returns true if process() will read the FrameDataMap item named
+    /// \p label for the frame \p data.
+    /// Plugins producing optional, expensive outputs (e.g. the full thresholded
+    /// image) query this on their downstream plugins to skip work nobody reads.
+    /// Overload this if your plugin only reads an item depending on its settings.
+    /// This is called by other plugins, in their thread and without your
+    /// lock(), so only answer from what beginFrame() stored in \p data.
+    virtual bool needsFrameDataItem(const FrameData * data, const string & label) const;
+
+    /// lets the blob finder know which regions of LUT channel \p color
+    /// this plugin reads from the "cmv_colorlist" of the frame \p data.
+    /// Add the area/size ranges you filter by to \p bounds, or call
+    /// addUnrestricted() if you need all of them. The default reads no
+    /// regions. Like needsFrameDataItem(), only answer from \p data.
+    virtual void addRegionBounds(const FrameData * data, int color, CMVision::RegionBounds & bounds) const;
+
+    /// declares what the next call to process() reads and writes, so that
+    /// the stack may run it at the same time as plugins it does not conflict
+    /// with. Return false (the default) if you cannot tell; the plugin then
+    /// runs alone, in stack order.
+    /// Items shared with concurrent plugins must be obtained with
+    /// FrameDataMap::getOrInsertOwned().
+    virtual bool getFrameDataAccess(FrameDataAccess & access);
+
+    /// return true if process(), postProcess() and the event handlers
+    /// below are safe to call at the same time as each other and as any
+    /// settings edit, e.g. because process() only reads its settings
+    /// from a ParameterSnapshot picked up at the start of each frame.
+    /// The stack then calls this plugin without lock().
+    virtual bool usesParameterSnapshots() const;
+
     /// any settings of your plugin should be returned here
     /// this will ensure a nice integration with the systems data-tree and automatic
     /// XML settings saving
@@ -146,7 +228,8 @@ public:
     /// These are event handlers that were called on the
     /// visualization window
     /// these events should provide a *locked* (meaning thread-safe) context.
-    /// That is, they will never get triggered during a processing function.
+    /// That is, they will never get triggered during a processing function,
+    /// unless usesParameterSnapshots() returns true.
     /// IMPORTANT, you should call event->accept() if you choose to handle it
     /// because non-accepted events will be forwarded to the next plugin
     /// and multiple plugins might be listening to the same events.
@@ -161,6 +244,14 @@ public:
     double getTimeProcessing();
     double getTimePostProcessing();
 
+    /// adds the latency histograms of this plugin to \p list, starting with
+    /// its processing time. Overload this to report further latencies.
+    virtual void getLatencyHistograms(vector<LatencyHistogram *> & list);
+
+    /// adds event counters of this plugin, e.g. of dropped data, to \p list.
+    /// They are exported along with the latency histograms.
+    virtual void getCounters(vector<VarInt *> & list);
+
 public slots:
     void slotKeyPressEvent ( QKeyEvent * event );
 
@@ -20,7 +20,7 @@
 //========================================================================
 #include "multistack_robocup_ssl.h"
 
-MultiStackRoboCupSSL::MultiStackRoboCupSSL(RenderOptions * _opts, int cameras) : MultiVisionStack("RoboCup SSL Multi-Cam",_opts) {
+MultiStackRoboCupSSL::MultiStackRoboCupSSL(RenderOptions * _opts, int cameras, bool headless) : MultiVisionStack("RoboCup SSL Multi-Cam",_opts) {
   //add global field calibration parameter
   global_field = new RoboCupField();
   settings->addChild(global_field->getSettings());
@@ -42,17 +42,31 @@ MultiStackRoboCupSSL::MultiStackRoboCupSSL(RenderOptions * _opts, int cameras) :
   connect(global_network_output_settings->multicast_port,SIGNAL(wasEdited(VarType *)),this,SLOT(RefreshNetworkOutput()));
   connect(global_network_output_settings->multicast_address,SIGNAL(wasEdited(VarType *)),this,SLOT(RefreshNetworkOutput()));
   connect(global_network_output_settings->multicast_interface,SIGNAL(wasEdited(VarType *)),this,SLOT(RefreshNetworkOutput()));
+  connect(global_network_output_settings->send_thread,SIGNAL(wasEdited(VarType *)),this,SLOT(RefreshNetworkOutput()));
+  connect(global_network_output_settings->max_packet_size,SIGNAL(wasEdited(VarType *)),this,SLOT(RefreshNetworkOutput()));
+  connect(global_network_output_settings->oversized_frames,SIGNAL(wasEdited(VarType *)),this,SLOT(RefreshNetworkOutput()));
+
+  connect(global_network_output_settings->delta_enable,SIGNAL(wasEdited(VarType *)),this,SLOT(RefreshNetworkOutput()));
+  connect(global_network_output_settings->delta_port,SIGNAL(wasEdited(VarType *)),this,SLOT(RefreshNetworkOutput()));
 
   udp_server = new RoboCupSSLServer();
+  delta_udp_server = new RoboCupSSLServer();
 
   global_plugin_publish_geometry = new PluginPublishGeometry(0,udp_server,*global_field);
 
+  merged_udp_server = new RoboCupSSLServer();
+  global_plugin_merge_detections = new PluginMergeDetections(0,merged_udp_server);
+  connect(global_plugin_merge_detections->merge_enable,SIGNAL(wasEdited(VarType *)),this,SLOT(RefreshNetworkOutput()));
+  connect(global_plugin_merge_detections->merge_port,SIGNAL(wasEdited(VarType *)),this,SLOT(RefreshNetworkOutput()));
+
   //add parameter for number of cameras
   createThreads(cameras);
   unsigned int n = threads.size();
   for (unsigned int i = 0; i < n;i++) {
-    threads[i]->setFrameBuffer(new FrameBuffer(5));
-    threads[i]->setStack(new StackRoboCupSSL(_opts,threads[i]->getFrameBuffer(),i,global_field,global_ball_settings,global_plugin_publish_geometry,global_team_selector_blue, global_team_selector_yellow,udp_server,"robocup-ssl-cam-" + QString::number(i).toStdString()));
+    //room for one frame per pipeline stage besides the display readers:
+    threads[i]->setFrameBuffer(new FrameBuffer(8));
+    connect(threads[i],SIGNAL(captureStopped()),this,SLOT(FlushMergedDetections()));
+    threads[i]->setStack(new StackRoboCupSSL(_opts,threads[i]->getFrameBuffer(),i,global_field,global_ball_settings,global_plugin_publish_geometry,global_plugin_merge_detections,global_team_selector_blue, global_team_selector_yellow,udp_server,delta_udp_server,global_network_output_settings,"robocup-ssl-cam-" + QString::number(i).toStdString(),headless));
   }
     //TODO: make LUT widgets aware of each other for easy data-sharing
 }
@@ -63,22 +77,66 @@ string MultiStackRoboCupSSL::getSettingsFileName() {
 
 MultiStackRoboCupSSL::~MultiStackRoboCupSSL() {
   stop();
+  global_plugin_merge_detections->flush();
   delete udp_server;
+  delete merged_udp_server;
+  delete delta_udp_server;
   delete global_plugin_publish_geometry;
+  delete global_plugin_merge_detections;
   delete global_field;
   delete global_ball_settings;
 }
 
+void MultiStackRoboCupSSL::FlushMergedDetections()
+{
+  global_plugin_merge_detections->flush();
+}
+
 void MultiStackRoboCupSSL::RefreshNetworkOutput()
 {
+  RoboCupSSLServer::OversizePolicy policy=RoboCupSSLServer::OversizeSplit;
+  if (global_network_output_settings->oversized_frames->getSelection()=="Drop Least Confident") {
+    policy=RoboCupSSLServer::OversizeTruncate;
+  }
   udp_server->mutex.lock();
   udp_server->close();
   udp_server->_port = global_network_output_settings->multicast_port->getInt();
   udp_server->_net_address = global_network_output_settings->multicast_address->getString();
   udp_server->_net_interface = global_network_output_settings->multicast_interface->getString();
+  udp_server->setSendThread(global_network_output_settings->send_thread->getBool());
+  udp_server->setMaxPacketSize(global_network_output_settings->max_packet_size->getInt());
+  udp_server->setOversizePolicy(policy);
   if (udp_server->open()==false) {
     fprintf(stderr,"ERROR WHEN TRYING TO OPEN UDP NETWORK SERVER!\n");
     fflush(stderr);
   }
   udp_server->mutex.unlock();
+
+  //the cycle in progress still goes out on the old port:
+  FlushMergedDetections();
+  merged_udp_server->mutex.lock();
+  merged_udp_server->close();
+  merged_udp_server->_port = global_plugin_merge_detections->merge_port->getInt();
+  merged_udp_server->_net_address = udp_server->_net_address;
+  merged_udp_server->_net_interface = udp_server->_net_interface;
+  merged_udp_server->setSendThread(global_network_output_settings->send_thread->getBool());
+  merged_udp_server->setMaxPacketSize(global_network_output_settings->max_packet_size->getInt());
+  merged_udp_server->setOversizePolicy(policy);
+  if (global_plugin_merge_detections->merge_enable->getBool() && merged_udp_server->open()==false) {
+    fprintf(stderr,"ERROR WHEN TRYING TO OPEN MERGED UDP NETWORK SERVER!\n");
+    fflush(stderr);
+  }
+  merged_udp_server->mutex.unlock();
+
+  delta_udp_server->mutex.lock();
+  delta_udp_server->close();
+  delta_udp_server->_port = global_network_output_settings->delta_port->getInt();
+  delta_udp_server->_net_address = udp_server->_net_address;
+  delta_udp_server->_net_interface = udp_server->_net_interface;
+  delta_udp_server->setSendThread(global_network_output_settings->send_thread->getBool());
+  if (global_network_output_settings->delta_enable->getBool() && delta_udp_server->open()==false) {
+    fprintf(stderr,"ERROR WHEN TRYING TO OPEN DELTA UDP NETWORK SERVER!\n");
+    fflush(stderr);
+  }
+  delta_udp_server->mutex.unlock();
 }
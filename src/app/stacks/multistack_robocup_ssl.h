@@ -26,6 +26,7 @@
 #include "stack_robocup_ssl.h"
 #include "plugin_detect_balls.h"
 #include "plugin_publishgeometry.h"
+#include "plugin_merge_detections.h"
 #include "cmpattern_teamdetector.h"
 #include "robocup_ssl_server.h"
 #include "field.h"
@@ -42,17 +43,22 @@ class MultiStackRoboCupSSL : public QObject, public MultiVisionStack {
   RoboCupField * global_field;
   PluginDetectBallsSettings * global_ball_settings;
   PluginPublishGeometry * global_plugin_publish_geometry;
+  PluginMergeDetections * global_plugin_merge_detections;
   CMPattern::TeamDetectorSettings * global_team_settings;
   CMPattern::TeamSelector * global_team_selector_blue;
   CMPattern::TeamSelector * global_team_selector_yellow;
   PluginSSLNetworkOutputSettings * global_network_output_settings;
   RoboCupSSLServer * udp_server;
+  RoboCupSSLServer * merged_udp_server; //the merged frames of all cameras
+  RoboCupSSLServer * delta_udp_server;  //the delta-encoded frames
   public:
-  MultiStackRoboCupSSL(RenderOptions * _opts, int cameras);
+  /// with \p headless set, the stacks leave out their GUI-only plugins
+  MultiStackRoboCupSSL(RenderOptions * _opts, int cameras, bool headless=false);
   virtual string getSettingsFileName();
   virtual ~MultiStackRoboCupSSL();
   public slots:
   void RefreshNetworkOutput();
+  void FlushMergedDetections();
 };
 
 #endif
@@ -0,0 +1,108 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    plugin_scheduler.cpp
+  \brief   C++ Implementation: PluginScheduler
+  \author  Author Name, 2009
+*/
+//========================================================================
+
+#include "plugin_scheduler.h"
+#include "timer.h"
+
+PluginScheduler::PluginScheduler()
+{
+  plugins=0;
+  data=0;
+  opts=0;
+  run_first=0;
+}
+
+void PluginScheduler::buildLevels(vector<VisionPlugin *> & stack, unsigned int first, unsigned int last)
+{
+  unsigned int n=last-first;
+  if (access.size() < n) access.resize(n);
+  level.assign(n,0);
+  vector<bool> declared(n,false);
+  int num_levels=0;
+  for (unsigned int i=0;i<n;i++) {
+    access[i].clear();
+    declared[i]=stack[first+i]->getFrameDataAccess(access[i]);
+    for (unsigned int j=0;j<i;j++) {
+      if (level[j] < level[i]) continue;
+      if (declared[i]==false || declared[j]==false || access[i].conflictsWith(access[j])) {
+        level[i]=level[j]+1;
+      }
+    }
+    if (level[i]+1 > num_levels) num_levels=level[i]+1;
+  }
+  //counting sort by level keeps the stack order within a level:
+  level_start.assign(num_levels+1,0);
+  for (unsigned int i=0;i<n;i++) level_start[level[i]+1]++;
+  for (int l=0;l<num_levels;l++) level_start[l+1]+=level_start[l];
+  order.resize(n);
+  vector<unsigned int> next(level_start.begin(),level_start.end()-1);
+  for (unsigned int i=0;i<n;i++) order[next[level[i]]++]=first+i;
+}
+
+void PluginScheduler::processPlugin(VisionPlugin * p)
+{
+  bool locked=(p->usesParameterSnapshots()==false);
+  if (locked) p->lock();
+  double a=GetTimeSec();
+  p->process(data,opts);
+  p->setTimeProcessing(GetTimeSec()-a);
+  if (locked) p->unlock();
+}
+
+double PluginScheduler::run(vector<VisionPlugin *> & stack, unsigned int first, unsigned int last, FrameData * _data, RenderOptions * _opts)
+{
+  if (last > stack.size()) last=stack.size();
+  if (first >= last) return 0.0;
+  plugins=&stack;
+  data=_data;
+  opts=_opts;
+  buildLevels(stack,first,last);
+  int num_levels=getLevelCount();
+  if (num_levels < (int)(last-first)) {
+    //concurrent plugins must not resize the map under each other:
+    data->map.reserve(FrameDataRegistry::getNumKeys());
+  }
+  for (int l=0;l<num_levels;l++) {
+    run_first=level_start[l];
+    int width=level_start[l+1]-level_start[l];
+    if (width==1) {
+      processPlugin(stack[order[run_first]]);
+    } else {
+      BandWorkerPool::run(this,width);
+    }
+  }
+  double total=0.0;
+  for (unsigned int i=first;i<last;i++) {
+    total+=stack[i]->getTimeProcessing();
+  }
+  return total;
+}
+
+int PluginScheduler::getLevelCount() const
+{
+  return level_start.empty() ? 0 : (int)level_start.size()-1;
+}
+
+void PluginScheduler::processBand(int band, int num_bands)
+{
+  (void)num_bands;
+  processPlugin((*plugins)[order[run_first+band]]);
+}
@@ -0,0 +1,78 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    plugin_scheduler.h
+  \brief   C++ Interface: PluginScheduler
+  \author  Author Name, 2009
+*/
+//========================================================================
+
+#ifndef PLUGIN_SCHEDULER_H
+#define PLUGIN_SCHEDULER_H
+#include <vector>
+#include "visionplugin.h"
+#include "band_worker_pool.h"
+using namespace std;
+
+/*!
+  \class   PluginScheduler
+  \brief   Runs the independent plugins of a range of a stack at the same time
+
+  Before every frame, each plugin is asked for its FrameDataAccess.
+  A plugin depends on every earlier plugin it conflicts with. A plugin
+  that cannot declare its access depends on all earlier plugins, and
+  all later plugins depend on it. This gives a dependency graph. The
+  plugins are then grouped into levels: a plugin's level is one more
+  than the highest level of the plugins it depends on.
+
+  The levels run one after another. The plugins of one level run at
+  the same time on the BandWorkerPool. Conflicting plugins keep their
+  stack order, so the results are the same as those of a serial run.
+
+  A plugin that runs in a level with others may still use the
+  BandWorkerPool; its bands are then processed serially by the thread
+  running the plugin (see BandWorkerPool::isInsidePool()).
+
+  One scheduler may only be used by one thread at a time.
+*/
+class PluginScheduler : public BandJob
+{
+protected:
+  vector<FrameDataAccess> access;
+  vector<int> level;           //level of each plugin in the range
+  vector<unsigned int> order;  //plugins sorted by level, then by stack order
+  vector<unsigned int> level_start; //first entry of each level in order
+  //the level being run:
+  vector<VisionPlugin *> * plugins;
+  FrameData * data;
+  RenderOptions * opts;
+  unsigned int run_first;
+
+  void buildLevels(vector<VisionPlugin *> & stack, unsigned int first, unsigned int last);
+  void processPlugin(VisionPlugin * p);
+public:
+  PluginScheduler();
+
+  /// runs process() of the plugins [\p first, \p last) of \p stack.
+  /// returns the sum of their processing times.
+  double run(vector<VisionPlugin *> & stack, unsigned int first, unsigned int last, FrameData * _data, RenderOptions * _opts);
+
+  /// the number of levels of the last run()
+  int getLevelCount() const;
+
+  virtual void processBand(int band, int num_bands);
+};
+
+#endif
@@ -20,11 +20,12 @@
 //========================================================================
 #include "stack_robocup_ssl.h"
 
-StackRoboCupSSL::StackRoboCupSSL(RenderOptions * _opts, FrameBuffer * _fb, int camera_id, RoboCupField * _global_field, PluginDetectBallsSettings * _global_ball_settings,PluginPublishGeometry * _global_plugin_publish_geometry, CMPattern::TeamSelector * _global_team_selector_blue, CMPattern::TeamSelector * _global_team_selector_yellow, RoboCupSSLServer * udp_server, string cam_settings_filename) : VisionStack("RoboCup Image Processing",_opts), global_field(_global_field), global_ball_settings(_global_ball_settings), global_team_selector_blue(_global_team_selector_blue), global_team_selector_yellow(_global_team_selector_yellow) {
+StackRoboCupSSL::StackRoboCupSSL(RenderOptions * _opts, FrameBuffer * _fb, int camera_id, RoboCupField * _global_field, PluginDetectBallsSettings * _global_ball_settings,PluginPublishGeometry * _global_plugin_publish_geometry, PluginMergeDetections * _global_plugin_merge_detections, CMPattern::TeamSelector * _global_team_selector_blue, CMPattern::TeamSelector * _global_team_selector_yellow, RoboCupSSLServer * udp_server, RoboCupSSLServer * delta_udp_server, PluginSSLNetworkOutputSettings * network_output_settings, string cam_settings_filename, bool headless) : VisionStack("RoboCup Image Processing",_opts), global_field(_global_field), global_ball_settings(_global_ball_settings), global_team_selector_blue(_global_team_selector_blue), global_team_selector_yellow(_global_team_selector_yellow) {
     (void)_fb;
     _camera_id=camera_id;
     _cam_settings_filename=cam_settings_filename;
     _udp_server = udp_server;
+    _delta_udp_server = delta_udp_server;
     lut_yuv = new YUVLUT(4,6,6,cam_settings_filename + "-lut-yuv.xml");
     lut_yuv->loadRoboCupChannels(LUTChannelMode_Numeric);
     lut_yuv->addDerivedLUT(new RGBLUT(5,5,5,""));
@@ -34,34 +35,53 @@ StackRoboCupSSL::StackRoboCupSSL(RenderOptions * _opts, FrameBuffer * _fb, int c
 
     _global_plugin_publish_geometry->addCameraParameters(camera_parameters);
 
-    stack.push_back(new PluginDVR(_fb));
+    //the stages below can run on successive frames at the same time,
+    //see the "pipelined stages" option of the capture thread:
+    beginStage("threshold/RLE");
+    //the DVR builds its widget right away, so it needs a GUI:
+    if (headless==false) stack.push_back(new PluginDVR(_fb));
 
-    stack.push_back(new PluginColorCalibration(_fb,lut_yuv, LUTChannelMode_Numeric));
+    if (headless==false) stack.push_back(new PluginColorCalibration(_fb,lut_yuv, LUTChannelMode_Numeric));
     settings->addChild(lut_yuv->getSettings());
 
     stack.push_back(new PluginCameraCalibration(_fb,*camera_parameters,*calib_field));
 
-    stack.push_back(new PluginColorThreshold(_fb,lut_yuv));
-
-    //initialize the runlength encoder...
+    //initialize the combined thresholding + runlength encoder...
     //we don't expect more than 50k runs per image
-    stack.push_back(new PluginRunlengthEncode(_fb,50000));
+    PluginThresholdRunlengthEncode * segmentation=new PluginThresholdRunlengthEncode(_fb,lut_yuv,50000);
+    //only write the full thresholded image if a later plugin of this stack reads it:
+    segmentation->setConsumers(&stack);
+    stack.push_back(segmentation);
 
     //initialize the blob finder
     //we don't expect more than 10k blobs per image
-    stack.push_back(new PluginFindBlobs(_fb,lut_yuv, 10000));
+    beginStage("blobs");
+    PluginFindBlobs * blob_finder=new PluginFindBlobs(_fb,lut_yuv, 10000);
+    //drop regions that none of the detectors below would accept:
+    blob_finder->setConsumers(&stack);
+    stack.push_back(blob_finder);
 
+    beginStage("detection");
     stack.push_back(new PluginDetectRobots(_fb,lut_yuv,*camera_parameters,*global_field,global_team_selector_blue,global_team_selector_yellow));
 
     stack.push_back(new PluginDetectBalls(_fb,lut_yuv,*camera_parameters,*global_field,global_ball_settings));
 
-    stack.push_back(new PluginSSLNetworkOutput(_fb,_udp_server,*camera_parameters,*global_field));
+    beginStage("output");
+    stack.push_back(new PluginSSLNetworkOutput(_fb,_udp_server,_delta_udp_server,network_output_settings,*camera_parameters,*global_field));
 
     stack.push_back(_global_plugin_publish_geometry);
 
-    PluginVisualize * vis=new PluginVisualize(_fb,*camera_parameters,*global_field,*calib_field);
-    vis->setThresholdingLUT(lut_yuv);
-    stack.push_back(vis);
+    //merges the frames of all cameras, after this one's was stamped:
+    stack.push_back(_global_plugin_merge_detections);
+
+    //nobody would look at the visualization frame:
+    if (headless==false) {
+      PluginVisualize * vis=new PluginVisualize(_fb,*camera_parameters,*global_field,*calib_field);
+      vis->setThresholdingLUT(lut_yuv);
+      stack.push_back(vis);
+    }
+
+    initTimingStatistics();
 
 
 }
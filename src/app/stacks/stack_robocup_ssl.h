@@ -31,11 +31,13 @@
 #include "plugin_visualize.h"
 #include "plugin_colorthreshold.h"
 #include "plugin_runlength_encode.h"
+#include "plugin_threshold_rle.h"
 #include "plugin_find_blobs.h"
 #include "plugin_detect_balls.h"
 #include "plugin_detect_robots.h"
 #include "plugin_sslnetworkoutput.h"
 #include "plugin_publishgeometry.h"
+#include "plugin_merge_detections.h"
 #include "plugin_dvr.h"
 #include "cmpattern_teamdetector.h"
 #include "robocup_ssl_server.h"
@@ -47,6 +49,11 @@ using namespace std;
   \brief   The single camera vision stack implementation used for the RoboCup SSL
   \author  Stefan Zickler, (C) 2008
            multiple of these stacks are run in parallel using the MultiStackRoboCupSSL
+
+  A headless stack leaves out the plugins that only serve the GUI
+  (DVR, color calibration and visualization). The camera calibration
+  plugin stays, as it holds the camera parameters, but it never creates
+  its widget unless asked to.
 */
 class StackRoboCupSSL : public VisionStack {
   protected:
@@ -60,8 +67,9 @@ class StackRoboCupSSL : public VisionStack {
   CMPattern::TeamSelector * global_team_selector_yellow;
   RoboCupCalibrationHalfField * calib_field;
   RoboCupSSLServer * _udp_server;
+  RoboCupSSLServer * _delta_udp_server;
   public:
-  StackRoboCupSSL(RenderOptions * _opts, FrameBuffer * _fb, int camera_id, RoboCupField * _global_field, PluginDetectBallsSettings * _global_ball_settings, PluginPublishGeometry * _global_plugin_publish_geometry, CMPattern::TeamSelector * _global_team_selector_blue, CMPattern::TeamSelector * _global_team_selector_yellow, RoboCupSSLServer * udp_server, string cam_settings_filename);
+  StackRoboCupSSL(RenderOptions * _opts, FrameBuffer * _fb, int camera_id, RoboCupField * _global_field, PluginDetectBallsSettings * _global_ball_settings, PluginPublishGeometry * _global_plugin_publish_geometry, PluginMergeDetections * _global_plugin_merge_detections, CMPattern::TeamSelector * _global_team_selector_blue, CMPattern::TeamSelector * _global_team_selector_yellow, RoboCupSSLServer * udp_server, RoboCupSSLServer * delta_udp_server, PluginSSLNetworkOutputSettings * network_output_settings, string cam_settings_filename, bool headless=false);
   virtual string getSettingsFileName();
   virtual ~StackRoboCupSSL();
 };
@@ -26,9 +26,25 @@ VisionStack::VisionStack(string _name, RenderOptions * _opts) {
   //counter_proc=0.0;
   //counter_post_proc=0.0;
   settings=new VarList("Global");
+  //run plugins that do not depend on each other at the same time:
+  settings->addChild(parallel_plugins=new VarBool("parallel plugins",false));
+  stage_settings=0;
+  scheduler=new PluginScheduler();
+  frame_latency.setName("frame");
+  settings->addChild(timing_settings=new VarList("Timing"));
+  timing_settings->addChild(timing_file=new VarString("export file",""));
+  timing_settings->addChild(timing_interval=new VarInt("export interval (s)",10,1));
+  timing_window_start=GetTimeSec();
 }
 
 VisionStack::~VisionStack() {
+  for (unsigned int i=0;i<stages.size();i++) {
+    delete stages[i].scheduler;
+  }
+  delete scheduler;
+  for (unsigned int i=0;i<timing_snapshots.size();i++) {
+    delete timing_snapshots[i];
+  }
   delete settings;
 }
 
@@ -45,17 +61,98 @@ string VisionStack::getSettingsFileName() {
   return name;
 }
 
+void VisionStack::beginStage(const string & stage_name) {
+  if (stage_settings==0) {
+    settings->addChild(stage_settings=new VarList("Pipeline Stages"));
+  }
+  if (stages.empty()==false && stages.back().first==stack.size()) {
+    fprintf(stderr,"VisionStack: stage '%s' has no plugins, ignoring stage '%s'\n",
+            stages.back().name.c_str(),stage_name.c_str());
+    return;
+  }
+  if (stages.empty() && stack.empty()==false) {
+    //plugins added before the first stage form a stage of their own:
+    Stage input;
+    input.first=0;
+    input.name="input";
+    input.occupancy=new VarDouble("input occupancy (%)",0.0);
+    input.occupancy->addFlags(VARTYPE_FLAG_READONLY);
+    input.scheduler=new PluginScheduler();
+    stage_settings->addChild(input.occupancy);
+    stages.push_back(input);
+  }
+  Stage s;
+  s.first=stack.size();
+  s.name=stage_name;
+  s.occupancy=new VarDouble(stage_name + " occupancy (%)",0.0);
+  s.occupancy->addFlags(VARTYPE_FLAG_READONLY);
+  s.scheduler=new PluginScheduler();
+  stage_settings->addChild(s.occupancy);
+  stages.push_back(s);
+}
+
+int VisionStack::getStageCount() const {
+  return stages.empty() ? 1 : (int)stages.size();
+}
+
+string VisionStack::getStageName(int stage) const {
+  if (stage < 0 || stage >= (int)stages.size()) return name;
+  return stages[stage].name;
+}
+
+void VisionStack::processStage(FrameData * data, int stage) {
+  runStage(data,stage);
+}
+
+void VisionStack::beginFrame(FrameData * data) {
+  unsigned int n=stack.size();
+  for (unsigned int i=0;i<n;i++) {
+    stack[i]->beginFrame(data);
+  }
+}
+
+double VisionStack::runStage(FrameData * data, int stage) {
+  //what each plugin reads in this frame is settled before anything runs:
+  if (stage==0) beginFrame(data);
+  if (stages.empty()) {
+    return processRange(data,0,stack.size(),scheduler);
+  }
+  if (stage < 0 || stage >= (int)stages.size()) return 0.0;
+  unsigned int last=(stage+1 < (int)stages.size()) ? stages[stage+1].first : stack.size();
+  return processRange(data,stages[stage].first,last,stages[stage].scheduler);
+}
+
+void VisionStack::setStageOccupancy(int stage, double fraction) {
+  if (stage < 0 || stage >= (int)stages.size()) return;
+  stages[stage].occupancy->setDouble(fraction*100.0);
+}
+
 void VisionStack::process(FrameData * data) {
+  bool show_timing = false;
+  if (show_timing) printf("----------\n");
+  double total=0.0;
+  int n=getStageCount();
+  for (int i=0;i<n;i++) {
+    total+=runStage(data,i);
+  }
+  if (show_timing) printf("Total time: %fms\n",total * 1000.0);
+  //counter_proc+=1.0;
+}
+
+double VisionStack::processRange(FrameData * data, unsigned int first, unsigned int last, PluginScheduler * sched) {
+  if (parallel_plugins->getBool()) {
+    return sched->run(stack,first,last,data,opts);
+  }
   double a=0.0;
   double b=0.0;
-  unsigned int n=stack.size();
   VisionPlugin * p;
   double total=0.0;
   bool show_timing = false;
-  if (show_timing) printf("----------\n");
-  for (unsigned int i=0;i<n;i++) {
+  if (last > stack.size()) last=stack.size();
+  for (unsigned int i=first;i<last;i++) {
     p=stack[i];
-    p->lock();
+    bool locked=(p->usesParameterSnapshots()==false);
+    if (locked) p->lock();
     a=GetTimeSec();
     p->process(data,opts);
     b=GetTimeSec();
@@ -64,10 +161,9 @@ void VisionStack::process(FrameData * data) {
     if (show_timing) {
       printf("Plugin %s: %fms\n",p->getName().c_str(),  p->getTimeProcessing() * 1000.0);
     }
-    p->unlock();
+    if (locked) p->unlock();
   }
-  if (show_timing) printf("Total time: %fms\n",total * 1000.0);
-  //counter_proc+=1.0;
+  return total;
 }
 
 void VisionStack::postProcess(FrameData * data) {
@@ -77,18 +173,88 @@ void VisionStack::postProcess(FrameData * data) {
   VisionPlugin * p;
   for (unsigned int i=0;i<n;i++) {
     p=stack[i];
-    p->lock();
+    bool locked=(p->usesParameterSnapshots()==false);
+    if (locked) p->lock();
     a=GetTimeSec();
     p->postProcess(data,opts);
     b=GetTimeSec();
     p->setTimePostProcessing(b-a);
-    p->unlock();
+    if (locked) p->unlock();
   }
   //counter_post_proc+=1.0;
 }
 
+void VisionStack::initTimingStatistics() {
+  timing_sources.push_back(&frame_latency);
+  for (unsigned int i=0;i<stack.size();i++) {
+    //shared plugins are timed by every stack, so no stack may reset them:
+    if (stack[i]->isSharedAmongStacks()==false) {
+      stack[i]->getLatencyHistograms(timing_sources);
+      stack[i]->getCounters(timing_counters);
+    }
+  }
+  for (unsigned int i=0;i<timing_sources.size();i++) {
+    timing_snapshots.push_back(new LatencyHistogram());
+    VarString * display=new VarString(timing_sources[i]->getName(),"");
+    display->addFlags(VARTYPE_FLAG_READONLY);
+    timing_settings->addChild(display);
+    timing_display.push_back(display);
+  }
+}
+
+void VisionStack::recordFrameLatency(double seconds) {
+  frame_latency.record(seconds);
+}
+
 void VisionStack::updateTimingStatistics() {
+  double now=GetTimeSec();
+  bool new_window=(now-timing_window_start >= timing_interval->getInt());
+  for (unsigned int i=0;i<timing_sources.size();i++) {
+    timing_sources[i]->snapshot(*timing_snapshots[i],new_window);
+    timing_display[i]->setString(timing_snapshots[i]->toString());
+  }
+  if (new_window) {
+    exportTimingStatistics(now);
+    timing_window_start=now;
+  }
+}
 
+void VisionStack::exportTimingStatistics(double now) {
+  string filename=timing_file->getString();
+  if (filename.empty() || timing_snapshots.empty()) return;
+  FILE * f=fopen(filename.c_str(),"a");
+  if (f==0) {
+    fprintf(stderr,"Unable to write timing statistics to '%s'\n",filename.c_str());
+    return;
+  }
+  bool json=(filename.size() >= 5 && filename.compare(filename.size()-5,5,".json")==0);
+  string stack_name=getSettingsFileName();
+  if (json) {
+    fprintf(f,"{\"time\":%.3f,\"stack\":\"%s\",\"histograms\":[",now,stack_name.c_str());
+  } else if (ftell(f)==0) {
+    fprintf(f,"time,stack,name,count,p50_ms,p99_ms,max_ms,mean_ms\n");
+  }
+  for (unsigned int i=0;i<timing_snapshots.size();i++) {
+    const LatencyHistogram & h=*timing_snapshots[i];
+    if (json) {
+      fprintf(f,"%s{\"name\":\"%s\",\"count\":%lld,\"p50_ms\":%.3f,\"p99_ms\":%.3f,\"max_ms\":%.3f,\"mean_ms\":%.3f}",
+              i > 0 ? "," : "",h.getName().c_str(),h.getCount(),
+              h.getPercentile(0.5)*1e3,h.getPercentile(0.99)*1e3,h.getMax()*1e3,h.getMean()*1e3);
+    } else {
+      fprintf(f,"%.3f,%s,%s,%lld,%.3f,%.3f,%.3f,%.3f\n",now,stack_name.c_str(),h.getName().c_str(),h.getCount(),
+              h.getPercentile(0.5)*1e3,h.getPercentile(0.99)*1e3,h.getMax()*1e3,h.getMean()*1e3);
+    }
+  }
+  if (json) fprintf(f,"],\"counters\":[");
+  for (unsigned int i=0;i<timing_counters.size();i++) {
+    if (json) {
+      fprintf(f,"%s{\"name\":\"%s\",\"value\":%d}",i > 0 ? "," : "",timing_counters[i]->getName().c_str(),timing_counters[i]->getInt());
+    } else {
+      fprintf(f,"%.3f,%s,%s,%d,,,,\n",now,stack_name.c_str(),timing_counters[i]->getName().c_str(),timing_counters[i]->getInt());
+    }
+  }
+  if (json) fprintf(f,"]}\n");
+  fclose(f);
 }
 
 void VisionStack::keyPressEvent ( QKeyEvent * event ) {
@@ -96,9 +262,10 @@ void VisionStack::keyPressEvent ( QKeyEvent * event ) {
   VisionPlugin * p;
   for (unsigned int i=0;i<n;i++) {
     p=stack[i];
-    p->lock();
+    bool locked=(p->usesParameterSnapshots()==false);
+    if (locked) p->lock();
     p->keyPressEvent(event);
-    p->unlock();
+    if (locked) p->unlock();
     if (event->isAccepted()) return;
   }
 }
@@ -108,9 +275,10 @@ void VisionStack::mousePressEvent ( QMouseEvent * event, pixelloc loc ) {
   VisionPlugin * p;
   for (unsigned int i=0;i<n;i++) {
     p=stack[i];
-    p->lock();
+    bool locked=(p->usesParameterSnapshots()==false);
+    if (locked) p->lock();
     p->mousePressEvent(event, loc);
-    p->unlock();
+    if (locked) p->unlock();
     if (event->isAccepted()) return;
   }
 }
@@ -120,9 +288,10 @@ void VisionStack::mouseReleaseEvent ( QMouseEvent * event, pixelloc loc ) {
   VisionPlugin * p;
   for (unsigned int i=0;i<n;i++) {
     p=stack[i];
-    p->lock();
+    bool locked=(p->usesParameterSnapshots()==false);
+    if (locked) p->lock();
     p->mouseReleaseEvent(event,loc);
-    p->unlock();
+    if (locked) p->unlock();
     if (event->isAccepted()) return;
   }
 }
@@ -132,9 +301,10 @@ void VisionStack::mouseMoveEvent ( QMouseEvent * event, pixelloc loc ) {
   VisionPlugin * p;
   for (unsigned int i=0;i<n;i++) {
     p=stack[i];
-    p->lock();
+    bool locked=(p->usesParameterSnapshots()==false);
+    if (locked) p->lock();
     p->mouseMoveEvent(event,loc);
-    p->unlock();
+    if (locked) p->unlock();
     if (event->isAccepted()) return;
   }
 }
@@ -144,9 +314,10 @@ void VisionStack::wheelEvent ( QWheelEvent * event, pixelloc loc ) {
   VisionPlugin * p;
   for (unsigned int i=0;i<n;i++) {
     p=stack[i];
-    p->lock();
+    bool locked=(p->usesParameterSnapshots()==false);
+    if (locked) p->lock();
     p->wheelEvent(event,loc);
-    p->unlock();
+    if (locked) p->unlock();
     if (event->isAccepted()) return;
   }
 }
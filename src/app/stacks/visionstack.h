@@ -23,6 +23,7 @@
 
 #include "visionplugin.h"
 #include "framedata.h"
+#include "plugin_scheduler.h"
 #include "timer.h"
 using namespace std;
 
@@ -30,14 +31,56 @@ using namespace std;
   \class   VisionStack
   \brief   Base-class of a single-threaded / single-camera vision stack.
   \author  Stefan Zickler, (C) 2008
+
+  A stack may split its plugins into consecutive stages with
+  beginStage(). A VisionPipeline can then run the stages of successive
+  frames concurrently. Without stages, the whole stack is one stage.
+  With "parallel plugins" enabled, the plugins within a stage are run
+  by a PluginScheduler.
+
+  The stack keeps latency histograms of its plugins and of whole frames
+  (see recordFrameLatency()). updateTimingStatistics() shows them in the
+  "Timing" settings and, every "export interval", appends them to the
+  "export file" and starts over. The counters of the plugins are
+  exported along with them, as running totals. Files ending in .json get one JSON
+  object per export, all others get CSV rows.
 */
 class VisionStack {
 protected:
+  struct Stage {
+    unsigned int first; //index of the first plugin of the stage
+    string name;
+    VarDouble * occupancy;
+    PluginScheduler * scheduler;
+  };
   string name;
   RenderOptions * opts;
   VarList * settings;
+  VarList * stage_settings;
+  vector<Stage> stages;
+  VarBool * parallel_plugins;
+  PluginScheduler * scheduler; //used if there are no stages
+  LatencyHistogram frame_latency;
+  VarList * timing_settings;
+  VarString * timing_file;
+  VarInt * timing_interval;
+  vector<LatencyHistogram *> timing_sources;
+  vector<LatencyHistogram *> timing_snapshots;
+  vector<VarString *> timing_display;
+  vector<VarInt *> timing_counters;
+  double timing_window_start;
   //double counter_proc;
   //double counter_post_proc;
+
+  /// starts a new stage with the next plugin that is added to the stack
+  void beginStage(const string & stage_name);
+  double processRange(FrameData * data, unsigned int first, unsigned int last, PluginScheduler * sched);
+  double runStage(FrameData * data, int stage);
+  /// calls beginFrame() of every plugin; done by the first stage
+  void beginFrame(FrameData * data);
+  /// creates the timing display of all plugins; call after adding them
+  void initTimingStatistics();
+  void exportTimingStatistics(double now);
 public:
     VisionStack(string _name, RenderOptions * _opts);
     virtual ~VisionStack();
@@ -49,6 +92,16 @@ public:
 
     void process(FrameData * data);
     void postProcess(FrameData * data);
+
+    int getStageCount() const;
+    string getStageName(int stage) const;
+    /// runs process() of the plugins of \p stage only.
+    /// stage 0 also calls beginFrame() of all plugins first.
+    void processStage(FrameData * data, int stage);
+    /// reports the fraction of time \p stage was busy
+    void setStageOccupancy(int stage, double fraction);
+    /// records the time from the start of process() to the end of postProcess()
+    void recordFrameLatency(double seconds);
     void updateTimingStatistics();
 
     virtual void keyPressEvent ( QKeyEvent * event );
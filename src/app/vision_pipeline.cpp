@@ -0,0 +1,222 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    vision_pipeline.cpp
+  \brief   C++ Implementation: VisionPipeline
+  \author  Author Name, 2009
+*/
+//========================================================================
+
+#include "vision_pipeline.h"
+#include "timer.h"
+
+VisionPipelineStage::VisionPipelineStage(VisionPipeline * _owner, int _stage)
+{
+  owner=_owner;
+  stage=_stage;
+  stopped=false;
+}
+
+void VisionPipelineStage::push(int idx)
+{
+  mutex.lock();
+  pending.push_back(idx);
+  not_empty.wakeOne();
+  mutex.unlock();
+}
+
+bool VisionPipelineStage::pop(int & idx)
+{
+  mutex.lock();
+  while (pending.empty() && stopped==false) {
+    not_empty.wait(&mutex);
+  }
+  if (pending.empty()) {
+    mutex.unlock();
+    return false;
+  }
+  idx=pending.front();
+  pending.pop_front();
+  mutex.unlock();
+  return true;
+}
+
+void VisionPipelineStage::stopWhenDone()
+{
+  mutex.lock();
+  stopped=true;
+  not_empty.wakeAll();
+  mutex.unlock();
+}
+
+void VisionPipelineStage::run()
+{
+  int idx;
+  while (pop(idx)) {
+    owner->runStage(stage,idx);
+  }
+}
+
+VisionPipeline::VisionPipeline()
+ : stats_key("capture_stats")
+{
+  stack=0;
+  rb=0;
+  in_flight=0;
+  max_in_flight=1;
+  window_start=0.0;
+}
+
+VisionPipeline::~VisionPipeline()
+{
+  stop();
+}
+
+void VisionPipeline::start(VisionStack * _stack, FrameBuffer * _rb)
+{
+  stop();
+  if (_stack==0 || _rb==0) return;
+  stack=_stack;
+  rb=_rb;
+  int n=stack->getStageCount();
+  max_in_flight=n;
+  in_flight=0;
+  busy.assign(n,0.0);
+  start_time.assign(rb->size,0.0);
+  window_start=GetTimeSec();
+  for (int i=1;i<n;i++) {
+    threads.push_back(new VisionPipelineStage(this,i));
+  }
+  for (unsigned int i=0;i<threads.size();i++) {
+    threads[i]->start();
+  }
+}
+
+void VisionPipeline::stop()
+{
+  if (stack==0) return;
+  drain();
+  for (unsigned int i=0;i<threads.size();i++) {
+    threads[i]->stopWhenDone();
+    threads[i]->wait();
+    delete threads[i];
+  }
+  threads.clear();
+  stack=0;
+  rb=0;
+}
+
+bool VisionPipeline::isRunning() const
+{
+  return stack!=0;
+}
+
+VisionStack * VisionPipeline::getStack() const
+{
+  return stack;
+}
+
+int VisionPipeline::claim()
+{
+  flight_mutex.lock();
+  while (in_flight >= max_in_flight) {
+    flight_changed.wait(&flight_mutex);
+  }
+  in_flight++;
+  flight_mutex.unlock();
+
+  for (;;) {
+    writer_mutex.lock();
+    int idx=rb->claimWrite();
+    writer_mutex.unlock();
+    if (idx >= 0) return idx;
+    //every bin is in flight or held by a reader:
+    QThread::yieldCurrentThread();
+  }
+}
+
+void VisionPipeline::abandon(int idx)
+{
+  writer_mutex.lock();
+  rb->abandonBin(idx);
+  writer_mutex.unlock();
+  flight_mutex.lock();
+  in_flight--;
+  flight_changed.wakeAll();
+  flight_mutex.unlock();
+}
+
+void VisionPipeline::submit(int idx)
+{
+  start_time[idx]=GetTimeSec();
+  runStage(0,idx);
+}
+
+void VisionPipeline::drain()
+{
+  flight_mutex.lock();
+  while (in_flight > 0) {
+    flight_changed.wait(&flight_mutex);
+  }
+  flight_mutex.unlock();
+}
+
+void VisionPipeline::runStage(int stage, int idx)
+{
+  double start=GetTimeSec();
+  stack->processStage(rb->getPointer(idx),stage);
+  bool last=(stage+1 >= stack->getStageCount());
+  if (last) {
+    finish(idx);
+  } else {
+    threads[stage]->push(idx);
+  }
+  addBusy(stage,GetTimeSec()-start);
+}
+
+void VisionPipeline::finish(int idx)
+{
+  FrameData * d=rb->getPointer(idx);
+  stack->postProcess(d);
+  stack->recordFrameLatency(GetTimeSec()-start_time[idx]);
+  CaptureStats * stats=d->map.get(stats_key);
+  if (stats!=0) {
+    stats->arena_bytes=d->arena.getAllocatedBytes();
+    stats->arena_high_water=d->arena.getHighWaterBytes();
+  }
+  writer_mutex.lock();
+  rb->publishBin(idx);
+  writer_mutex.unlock();
+  flight_mutex.lock();
+  in_flight--;
+  flight_changed.wakeAll();
+  flight_mutex.unlock();
+}
+
+void VisionPipeline::addBusy(int stage, double seconds)
+{
+  stats_mutex.lock();
+  busy[stage]+=seconds;
+  double now=GetTimeSec();
+  double window=now-window_start;
+  if (window >= 1.0) {
+    for (unsigned int i=0;i<busy.size();i++) {
+      stack->setStageOccupancy(i,busy[i]/window);
+      busy[i]=0.0;
+    }
+    window_start=now;
+  }
+  stats_mutex.unlock();
+}
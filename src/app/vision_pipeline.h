@@ -0,0 +1,127 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    vision_pipeline.h
+  \brief   C++ Interface: VisionPipeline
+  \author  Author Name, 2009
+*/
+//========================================================================
+
+#ifndef VISION_PIPELINE_H
+#define VISION_PIPELINE_H
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <deque>
+#include <vector>
+#include "framedata.h"
+#include "capturestats.h"
+#include "visionstack.h"
+using namespace std;
+
+class VisionPipeline;
+
+/*!
+  \class   VisionPipelineStage
+  \brief   The thread of one stage of a VisionPipeline
+*/
+class VisionPipelineStage : public QThread
+{
+protected:
+  VisionPipeline * owner;
+  int stage;
+  QMutex mutex;
+  QWaitCondition not_empty;
+  deque<int> pending; //ring buffer bins, oldest first
+  bool stopped;
+public:
+  VisionPipelineStage(VisionPipeline * _owner, int _stage);
+  /// hands the bin \p idx to this stage
+  void push(int idx);
+  /// waits for the next bin; returns false once stopped and empty
+  bool pop(int & idx);
+  /// lets run() return after the pending bins
+  void stopWhenDone();
+  virtual void run();
+};
+
+/*!
+  \class   VisionPipeline
+  \brief   Runs the stages of a VisionStack on successive frames at once
+
+  Stage 0 runs in the thread that calls submit(), every further stage
+  in a thread of its own. A frame moves through the stages in order,
+  and each stage takes frames in the order they were submitted, so
+  frames are published in capture order. The last stage runs
+  postProcess() of the whole stack and publishes the frame.
+
+  Every frame in flight occupies a bin of the ring buffer, claimed by
+  claim(). At most one frame per stage is in flight, so the ring
+  buffer needs that many bins on top of what its readers hold.
+
+  A plugin only belongs to one stage, so its process() is never run
+  twice at once. Its postProcess() is serialized with it by the plugin
+  lock, but it sees frames a few frames later than in serial mode.
+
+  The fraction of time each stage was busy is reported to the stack
+  with VisionStack::setStageOccupancy() about once per second. The
+  stage with the highest occupancy bounds the frame rate.
+*/
+class VisionPipeline
+{
+friend class VisionPipelineStage;
+protected:
+  VisionStack * stack;
+  FrameBuffer * rb;
+  FrameDataKey<CaptureStats> stats_key;
+  vector<VisionPipelineStage *> threads; //threads[i] runs stage i+1
+  QMutex writer_mutex; //serializes the ring buffer writer calls
+  QMutex flight_mutex;
+  QWaitCondition flight_changed;
+  int in_flight;
+  int max_in_flight;
+  vector<double> start_time; //per ring buffer bin, when stage 0 began
+  QMutex stats_mutex;
+  vector<double> busy; //seconds per stage since window_start
+  double window_start;
+
+  void runStage(int stage, int idx);
+  void finish(int idx);
+  void addBusy(int stage, double seconds);
+private:
+  VisionPipeline(const VisionPipeline &);
+  VisionPipeline & operator=(const VisionPipeline &);
+public:
+  VisionPipeline();
+  ~VisionPipeline();
+
+  /// starts the stage threads of \p _stack, which writes into \p _rb
+  void start(VisionStack * _stack, FrameBuffer * _rb);
+  /// waits for the frames in flight and ends the stage threads
+  void stop();
+  bool isRunning() const;
+  VisionStack * getStack() const;
+
+  /// claims a ring buffer bin for the next frame, waiting if the pipeline is full
+  int claim();
+  /// gives a bin of claim() back without processing it
+  void abandon(int idx);
+  /// runs stage 0 on the bin \p idx and hands it to the next stage
+  void submit(int idx);
+  /// waits until every submitted frame has been published
+  void drain();
+};
+
+#endif
@@ -0,0 +1,151 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    band_pool_check.cpp
+  \brief   Checks that jobs which are split again from within a band of the
+           BandWorkerPool, as plugins in a parallel PluginScheduler level
+           do, complete and process every band exactly once.
+  \author  Author Name, 2009
+*/
+//========================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <vector>
+#include <QString>
+#include <QThreadPool>
+#include "qgetopt.h"
+#include "band_worker_pool.h"
+
+using namespace std;
+
+/// stands in for a plugin that splits its image into bands
+class InnerJob : public BandJob {
+public:
+  vector<int> runs;
+  vector<bool> on_caller;
+  pthread_t caller;
+
+  InnerJob(int num_bands) : runs(num_bands,0), on_caller(num_bands,false) {
+    caller=pthread_self();
+  }
+  virtual void processBand(int band, int num_bands) {
+    (void)num_bands;
+    runs[band]++;
+    on_caller[band]=(pthread_equal(caller,pthread_self())!=0);
+  }
+};
+
+/// stands in for the PluginScheduler running a level of such plugins
+class OuterJob : public BandJob {
+public:
+  int inner_bands;
+  vector<int> runs;
+  vector<int> errors;
+
+  OuterJob(int num_bands, int _inner_bands) : runs(num_bands,0), errors(num_bands,0) {
+    inner_bands=_inner_bands;
+  }
+  virtual void processBand(int band, int num_bands) {
+    (void)num_bands;
+    runs[band]++;
+    if (BandWorkerPool::isInsidePool()==false) {
+      errors[band]++;
+    }
+    InnerJob inner(inner_bands);
+    BandWorkerPool::run(&inner,inner_bands);
+    for (int i=0;i<inner_bands;i++) {
+      //nested bands have to stay on the thread of the outer band:
+      if (inner.runs[i]!=1 || inner.on_caller[i]==false) errors[band]++;
+    }
+    if (BandWorkerPool::isInsidePool()==false) {
+      errors[band]++;
+    }
+  }
+};
+
+static void onTimeout(int) {
+  fprintf(stderr,"nested jobs did not finish: the pool is deadlocked\n");
+  _exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+  GetOpt opts(argc, argv);
+  bool help=false;
+  QString rounds_str="200";
+  QString threads_str="2";
+  opts.addSwitch("help",&help);
+  opts.addOption('n',"rounds",&rounds_str);
+  opts.addOption('t',"threads",&threads_str);
+  if (!opts.parse()) {
+    help=true;
+  }
+  if (help) {
+    printf("Usage: bandPoolCheck [-n rounds] [-t pool threads]\n");
+    printf(" Limits the thread pool to the given number of threads and runs jobs\n");
+    printf(" with more bands than that, each of which runs a split job of its\n");
+    printf(" own. Checks that every band runs exactly once, that the nested\n");
+    printf(" bands run on the thread of their outer band, and that nothing\n");
+    printf(" waits for a pool thread forever.\n");
+    printf(" Exits with 2 on the first failure or after 30s without progress.\n");
+    exit(1);
+  }
+  int rounds=max(1,rounds_str.toInt());
+  int threads=max(1,threads_str.toInt());
+  QThreadPool::globalInstance()->setMaxThreadCount(threads);
+  signal(SIGALRM,onTimeout);
+
+  if (BandWorkerPool::isInsidePool()) {
+    fprintf(stderr,"the main thread claims to be inside the pool\n");
+    return 2;
+  }
+  int checks=0;
+  for (int round=0;round<rounds;round++) {
+    alarm(30);
+    //more outer bands than pool threads, so that all of them are busy:
+    int outer_bands=threads+1+(round % 3);
+    int inner_bands=2+(round % 4);
+    OuterJob outer(outer_bands,inner_bands);
+    BandWorkerPool::run(&outer,outer_bands);
+    for (int i=0;i<outer_bands;i++) {
+      if (outer.runs[i]!=1 || outer.errors[i]!=0) {
+        fprintf(stderr,"round %d: outer band %d of %d ran %d time(s) with %d error(s)\n",
+                round,i,outer_bands,outer.runs[i],outer.errors[i]);
+        return 2;
+      }
+    }
+    if (BandWorkerPool::isInsidePool()) {
+      fprintf(stderr,"round %d: the main thread is still marked as inside the pool\n",round);
+      return 2;
+    }
+    //a job that is not nested still goes to the pool:
+    InnerJob plain(threads+1);
+    BandWorkerPool::run(&plain,threads+1);
+    for (int i=0;i<threads+1;i++) {
+      if (plain.runs[i]!=1) {
+        fprintf(stderr,"round %d: band %d of a plain job ran %d time(s)\n",round,i,plain.runs[i]);
+        return 2;
+      }
+    }
+    checks++;
+  }
+  alarm(0);
+  printf("%d rounds of nested jobs on %d pool thread(s): all complete\n",checks,threads);
+  return 0;
+}
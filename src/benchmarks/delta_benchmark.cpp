@@ -0,0 +1,298 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    delta_benchmark.cpp
+  \brief   Compares the size and the encoding and decoding time of full
+           detection packets with those of the delta-encoded stream, and
+           checks that the stream decodes within its quantization.
+  \author  Author Name, 2009
+*/
+//========================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <fstream>
+#include <vector>
+#include <QString>
+#include "qgetopt.h"
+#include "timer.h"
+#include "detection_delta.h"
+#include "messages_robocup_ssl_wrapper.pb.h"
+#include "messages_robocup_ssl_refbox_log.pb.h"
+
+using namespace std;
+
+static unsigned int random_state=12345;
+
+/// uniform in [-1,1], the same sequence on every run
+static double noise() {
+  random_state=random_state*1103515245u+12345u;
+  return ((random_state >> 8) & 0xffff)/32767.5-1.0;
+}
+
+/// a game-like scene of one camera: robots and a ball moving along
+/// smooth paths, with measurement noise and occasional misses
+static void makeFrames(int count, int robots, int balls, double fps, vector<SSL_DetectionFrame> & frames) {
+  frames.resize(count);
+  for (int f=0;f<count;f++) {
+    double t=f/fps;
+    SSL_DetectionFrame & d=frames[f];
+    d.set_frame_number(f);
+    d.set_camera_id(0);
+    d.set_t_capture(1000.0+t);
+    d.set_t_sent(1000.0+t+0.004+0.0005*noise());
+    for (int b=0;b<balls;b++) {
+      if (noise() > 0.9) continue;
+      SSL_DetectionBall * ball=d.add_balls();
+      double x=2500.0*sin(0.7*t+b);
+      double y=1500.0*sin(0.45*t+2*b);
+      ball->set_confidence(0.9+0.05*noise());
+      ball->set_area(60+(int)(5*noise()));
+      ball->set_x(x+2.0*noise());
+      ball->set_y(y+2.0*noise());
+      ball->set_pixel_x(390.0+x*0.13+0.3*noise());
+      ball->set_pixel_y(290.0+y*0.13+0.3*noise());
+    }
+    for (int team=0;team<2;team++) {
+      for (int r=0;r<robots;r++) {
+        if (noise() > 0.9) continue;
+        SSL_DetectionRobot * robot=(team==0) ? d.add_robots_yellow() : d.add_robots_blue();
+        double phase=r+team*0.5;
+        double x=(team==0 ? -1.0 : 1.0)*(1200.0+800.0*sin(0.3*t+phase));
+        double y=1800.0*sin(0.2*t+2.0*phase);
+        robot->set_confidence(0.95+0.04*noise());
+        robot->set_robot_id(r);
+        robot->set_x(x+3.0*noise());
+        robot->set_y(y+3.0*noise());
+        robot->set_orientation(fmod(0.5*t+phase,2.0*M_PI)-M_PI+0.01*noise());
+        robot->set_pixel_x(390.0+x*0.13+0.4*noise());
+        robot->set_pixel_y(290.0+y*0.13+0.4*noise());
+        robot->set_height(140.0);
+      }
+    }
+  }
+}
+
+static bool loadLog(const char * file, vector<SSL_DetectionFrame> & frames) {
+  fstream input(file,ios::in | ios::binary);
+  Refbox_Log log;
+  if (!input || log.ParseFromIstream(&input)==false) {
+    fprintf(stderr,"Failed to read log %s\n",file);
+    return false;
+  }
+  frames.resize(log.log_size());
+  for (int i=0;i<log.log_size();i++) frames[i].CopyFrom(log.log(i).frame());
+  return frames.empty()==false;
+}
+
+struct Errors {
+  double position;
+  double pixel;
+  double orientation;
+  double confidence;
+  bool structure; //counts, ids or optional fields differ
+  Errors() : position(0.0), pixel(0.0), orientation(0.0), confidence(0.0), structure(false) {}
+};
+
+static void compare(const SSL_DetectionBall & a, const SSL_DetectionBall & b, Errors & e) {
+  e.confidence=max(e.confidence,(double)fabs(a.confidence()-b.confidence()));
+  e.position=max(e.position,(double)max(fabs(a.x()-b.x()),fabs(a.y()-b.y())));
+  e.position=max(e.position,(double)fabs(a.z()-b.z()));
+  e.pixel=max(e.pixel,(double)max(fabs(a.pixel_x()-b.pixel_x()),fabs(a.pixel_y()-b.pixel_y())));
+  if (a.has_area()!=b.has_area() || a.area()!=b.area() || a.has_z()!=b.has_z()) e.structure=true;
+}
+
+static void compare(const SSL_DetectionRobot & a, const SSL_DetectionRobot & b, Errors & e) {
+  e.confidence=max(e.confidence,(double)fabs(a.confidence()-b.confidence()));
+  e.position=max(e.position,(double)max(fabs(a.x()-b.x()),fabs(a.y()-b.y())));
+  e.position=max(e.position,(double)fabs(a.height()-b.height()));
+  e.pixel=max(e.pixel,(double)max(fabs(a.pixel_x()-b.pixel_x()),fabs(a.pixel_y()-b.pixel_y())));
+  e.orientation=max(e.orientation,(double)fabs(a.orientation()-b.orientation()));
+  if (a.has_robot_id()!=b.has_robot_id() || a.robot_id()!=b.robot_id() ||
+      a.has_orientation()!=b.has_orientation() || a.has_height()!=b.has_height()) e.structure=true;
+}
+
+static void compare(const SSL_DetectionFrame & a, const SSL_DetectionFrame & b, Errors & e) {
+  if (a.frame_number()!=b.frame_number() || a.camera_id()!=b.camera_id() || a.t_capture()!=b.t_capture() ||
+      fabs(a.t_sent()-b.t_sent()) > 1e-6 || a.balls_size()!=b.balls_size() ||
+      a.robots_yellow_size()!=b.robots_yellow_size() || a.robots_blue_size()!=b.robots_blue_size()) {
+    e.structure=true;
+    return;
+  }
+  for (int i=0;i<a.balls_size();i++) compare(a.balls(i),b.balls(i),e);
+  for (int i=0;i<a.robots_yellow_size();i++) compare(a.robots_yellow(i),b.robots_yellow(i),e);
+  for (int i=0;i<a.robots_blue_size();i++) compare(a.robots_blue(i),b.robots_blue(i),e);
+}
+
+int main(int argc, char *argv[])
+{
+  GetOpt opts(argc, argv);
+  bool help=false;
+  QString log_str;
+  QString frames_str="6000";
+  QString robots_str="6";
+  QString balls_str="1";
+  QString fps_str="100";
+  QString interval_str="30";
+  QString passes_str="20";
+  QString drop_str="0";
+  opts.addSwitch("help",&help);
+  opts.addOption('l',"log",&log_str);
+  opts.addOption('n',"frames",&frames_str);
+  opts.addOption('r',"robots",&robots_str);
+  opts.addOption('b',"balls",&balls_str);
+  opts.addOption('f',"fps",&fps_str);
+  opts.addOption('k',"keyframe interval",&interval_str);
+  opts.addOption('p',"passes",&passes_str);
+  opts.addOption('d',"drop",&drop_str);
+  if (!opts.parse()) {
+    help=true;
+  }
+  if (help) {
+    printf("Usage: deltaBenchmark [-l log] [-n frames] [-r robots per team] [-b balls] [-f fps] [-k keyframe interval] [-p passes] [-d N]\n");
+    printf(" Encodes the detection frames of a log, as written by the log client,\n");
+    printf(" or of a synthetic scene of one camera, both as full wrapper packets\n");
+    printf(" and as the delta-encoded stream. Reports the bytes per frame, the\n");
+    printf(" bandwidth at the given frame rate and the time to encode and to\n");
+    printf(" decode a frame, averaged over the passes. Fails if the stream does\n");
+    printf(" not decode to the frames within its quantization.\n");
+    printf(" With -d, every Nth packet is lost on its way to the decoder, and the\n");
+    printf(" frames that could not be decoded for want of their keyframe are counted.\n");
+    exit(1);
+  }
+  double fps=max(1.0,fps_str.toDouble());
+  int interval=max(1,interval_str.toInt());
+  int passes=max(1,passes_str.toInt());
+  int drop=max(0,drop_str.toInt());
+
+  vector<SSL_DetectionFrame> frames;
+  if (log_str.isEmpty()==false) {
+    if (loadLog(log_str.toLatin1().data(),frames)==false) exit(1);
+  } else {
+    makeFrames(max(1,frames_str.toInt()),max(0,robots_str.toInt()),max(0,balls_str.toInt()),fps,frames);
+  }
+  int n=frames.size();
+
+  //sizes and correctness, one encoder per camera as in the network output:
+  vector<DetectionDeltaEncoder *> encoders;
+  DetectionDeltaDecoder decoder;
+  SSL_WrapperPacket wrapper;
+  SSL_DeltaDetectionFrame delta;
+  SSL_DetectionFrame decoded;
+  vector<string> full_packets(n);
+  vector<string> delta_packets(n);
+  double full_bytes=0.0;
+  double delta_bytes=0.0;
+  double keyframe_bytes=0.0;
+  int keyframes=0;
+  int lost=0;
+  Errors errors;
+  for (int i=0;i<n;i++) {
+    unsigned int cam=frames[i].camera_id();
+    while (encoders.size() <= cam) encoders.push_back(new DetectionDeltaEncoder(interval));
+    wrapper.mutable_detection()->CopyFrom(frames[i]);
+    wrapper.SerializeToString(&full_packets[i]);
+    if (encoders[cam]->encode(frames[i],delta)) {
+      keyframes++;
+      keyframe_bytes+=delta.ByteSize();
+    }
+    delta.SerializeToString(&delta_packets[i]);
+    full_bytes+=full_packets[i].size();
+    delta_bytes+=delta_packets[i].size();
+    if (drop > 0 && i % drop==drop-1) {
+      lost++;
+      continue;
+    }
+    if (decoder.decode(delta_packets[i].data(),delta_packets[i].size(),decoded)) {
+      compare(frames[i],decoded,errors);
+    }
+  }
+
+  int missing=decoder.getMissingKeyframes();
+  int failed=decoder.getMalformed();
+  if (drop==0) failed+=missing;
+
+  //the time per frame, over several passes:
+  Timer timer;
+  double t_full_encode=0.0;
+  double t_full_decode=0.0;
+  double t_delta_encode=0.0;
+  double t_delta_decode=0.0;
+  vector<char> buffer(65536);
+  for (int pass=0;pass<passes;pass++) {
+    //as RoboCupSSLServer does it, leaving out the few bytes of the wrapper:
+    timer.start();
+    for (int i=0;i<n;i++) {
+      frames[i].SerializeToArray(&buffer[0],buffer.size());
+    }
+    timer.stop();
+    t_full_encode+=timer.time();
+
+    timer.start();
+    for (int i=0;i<n;i++) {
+      wrapper.ParseFromArray(full_packets[i].data(),full_packets[i].size());
+    }
+    timer.stop();
+    t_full_decode+=timer.time();
+
+    for (unsigned int c=0;c<encoders.size();c++) encoders[c]->reset();
+    timer.start();
+    for (int i=0;i<n;i++) {
+      encoders[frames[i].camera_id()]->encode(frames[i],delta);
+      delta.SerializeToArray(&buffer[0],buffer.size());
+    }
+    timer.stop();
+    t_delta_encode+=timer.time();
+
+    decoder.reset();
+    timer.start();
+    for (int i=0;i<n;i++) {
+      decoder.decode(delta_packets[i].data(),delta_packets[i].size(),decoded);
+    }
+    timer.stop();
+    t_delta_decode+=timer.time();
+  }
+  double per_frame=1e6/((double)n*passes);
+
+  printf("%d frames, keyframe interval %d, %d keyframes\n",n,interval,keyframes);
+  printf("%-24s %12s %12s %12s %12s\n","","bytes/frame","kbit/s","encode us","decode us");
+  printf("%-24s %12.1f %12.1f %12.3f %12.3f\n","full packet",full_bytes/n,full_bytes/n*fps*8e-3,
+         t_full_encode*per_frame,t_full_decode*per_frame);
+  printf("%-24s %12.1f %12.1f %12.3f %12.3f\n","delta stream",delta_bytes/n,delta_bytes/n*fps*8e-3,
+         t_delta_encode*per_frame,t_delta_decode*per_frame);
+  if (keyframes > 0 && keyframes < n) {
+    printf("%-24s %12.1f\n","  keyframes",keyframe_bytes/keyframes);
+    printf("%-24s %12.1f\n","  other frames",(delta_bytes-keyframe_bytes)/(n-keyframes));
+  }
+  printf("delta stream size: %.1f%% of full packets, at %.0f frames/s\n",100.0*delta_bytes/max(full_bytes,1.0),fps);
+  if (drop > 0) {
+    printf("%d packets lost, %d more frames not decoded for want of their keyframe\n",lost,missing);
+  }
+  printf("max error: position %.4f mm, pixel %.4f, orientation %.6f rad, confidence %.5f\n",
+         errors.position,errors.pixel,errors.orientation,errors.confidence);
+
+  for (unsigned int c=0;c<encoders.size();c++) delete encoders[c];
+
+  //half a unit of the quantization, plus float rounding of field-sized values:
+  bool ok=(failed==0 && errors.structure==false && errors.position <= 0.051 &&
+           errors.pixel <= 0.032 && errors.orientation <= 0.000051 && errors.confidence <= 0.00051);
+  if (ok==false) {
+    fprintf(stderr,"the delta stream does not decode to the frames: %d frames failed%s\n",
+            failed,errors.structure ? ", entries differ" : "");
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,198 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    fragment_check.cpp
+  \brief   Checks that detection frames split by DetectionFragments are
+           put back together exactly by DetectionFrameAssembler.
+  \author  Author Name, 2009
+*/
+//========================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <QString>
+#include "qgetopt.h"
+#include "detection_fragments.h"
+
+using namespace std;
+
+static float randomValue(float range) {
+  return range*((rand() % 20001)-10000)/10000.0f;
+}
+
+/// a frame of \p balls balls and \p robots robots per team, with the
+/// optional fields set at random
+static void makeFrame(SSL_DetectionFrame & frame, unsigned int number, unsigned int camera, int balls, int robots) {
+  frame.Clear();
+  frame.set_frame_number(number);
+  frame.set_camera_id(camera);
+  frame.set_t_capture(1000.0+number/60.0);
+  frame.set_t_sent(1000.004+number/60.0);
+  if ((rand() % 4)==0) frame.set_camera_mask(rand() % 16);
+  for (int i=0;i<balls;i++) {
+    SSL_DetectionBall * ball=frame.add_balls();
+    ball->set_confidence((rand() % 1001)/1000.0f);
+    if (rand() & 1) ball->set_area(rand() % 200);
+    ball->set_x(randomValue(3000.0f));
+    ball->set_y(randomValue(2000.0f));
+    if (rand() & 1) ball->set_z(randomValue(100.0f));
+    ball->set_pixel_x(randomValue(780.0f));
+    ball->set_pixel_y(randomValue(580.0f));
+  }
+  for (int team=0;team<2;team++) {
+    for (int i=0;i<robots;i++) {
+      SSL_DetectionRobot * robot=(team==0) ? frame.add_robots_yellow() : frame.add_robots_blue();
+      robot->set_confidence((rand() % 1001)/1000.0f);
+      if (rand() % 4) robot->set_robot_id(rand() % 12);
+      robot->set_x(randomValue(3000.0f));
+      robot->set_y(randomValue(2000.0f));
+      if (rand() % 4) robot->set_orientation(randomValue(3.14f));
+      robot->set_pixel_x(randomValue(780.0f));
+      robot->set_pixel_y(randomValue(580.0f));
+      if (rand() & 1) robot->set_height(140.0f);
+    }
+  }
+}
+
+/// splits \p frame, feeds the fragments in a random order, and compares
+/// the frame that comes out with the original. \p fits tells whether
+/// every ball and robot fits into a packet of \p limit bytes on its own.
+static bool checkFrame(DetectionFrameAssembler & assembler, const SSL_DetectionFrame & frame, int limit, int & fragment_count, bool fits=true) {
+  vector<SSL_DetectionFrame> fragments;
+  if (DetectionFragments::split(frame,limit,fragments)!=fits) {
+    fprintf(stderr,"frame %u: split %s entries too large for %d bytes\n",frame.frame_number(),
+            fits ? "found" : "missed",limit);
+    return false;
+  }
+  fragment_count=fragments.size();
+  for (unsigned int i=0;i<fragments.size();i++) {
+    int size=DetectionFragments::wrappedSize(fragments[i].ByteSize());
+    int entries=fragments[i].balls_size()+fragments[i].robots_yellow_size()+fragments[i].robots_blue_size();
+    //only an entry that is too large on its own may exceed the limit:
+    if (size > limit && (fits || entries!=1)) {
+      fprintf(stderr,"frame %u: fragment %d takes %d of %d bytes\n",frame.frame_number(),i,size,limit);
+      return false;
+    }
+    if (fragments.size() > 1 && (fragments[i].fragment_index()!=i || fragments[i].fragment_count()!=fragments.size())) {
+      fprintf(stderr,"frame %u: fragment %d is numbered %u of %u\n",frame.frame_number(),i,
+              fragments[i].fragment_index(),fragments[i].fragment_count());
+      return false;
+    }
+  }
+  for (int i=fragments.size()-1;i>0;i--) {
+    swap(fragments[i],fragments[rand() % (i+1)]);
+  }
+  SSL_DetectionFrame result;
+  for (unsigned int i=0;i<fragments.size();i++) {
+    bool done=assembler.add(fragments[i],result);
+    if (done!=(i+1==fragments.size())) {
+      fprintf(stderr,"frame %u: assembled after %d of %d fragments\n",frame.frame_number(),i+1,(int)fragments.size());
+      return false;
+    }
+  }
+  if (result.SerializeAsString()!=frame.SerializeAsString()) {
+    fprintf(stderr,"frame %u: the assembled frame differs from the original\n",frame.frame_number());
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  GetOpt opts(argc, argv);
+  bool help=false;
+  QString rounds_str="2000";
+  QString seed_str="1";
+  opts.addSwitch("help",&help);
+  opts.addOption('n',"rounds",&rounds_str);
+  opts.addOption('s',"seed",&seed_str);
+  if (!opts.parse()) {
+    help=true;
+  }
+  if (help) {
+    printf("Usage: fragmentCheck [-n rounds] [-s seed]\n");
+    printf(" Splits random detection frames for packet size limits down to a few\n");
+    printf(" entries per packet, hands the fragments to a DetectionFrameAssembler\n");
+    printf(" in a random order, and compares the result byte for byte with the\n");
+    printf(" original. Also checks that frames with a lost fragment are dropped,\n");
+    printf(" that frames of other cameras pass through in between, and that\n");
+    printf(" entries too large for a packet are sent alone instead of dropped.\n");
+    printf(" Exits with 2 on the first failure.\n");
+    exit(1);
+  }
+  int rounds=max(1,rounds_str.toInt());
+  srand(seed_str.toInt());
+
+  DetectionFrameAssembler assembler;
+  SSL_DetectionFrame frame;
+  SSL_DetectionFrame other;
+  SSL_DetectionFrame result;
+  int limits[]={ 200, 300, 512, 1000, 1472, 65507 };
+  int num_limits=sizeof(limits)/sizeof(limits[0]);
+  int max_fragments=0;
+  for (int round=0;round<rounds;round++) {
+    int limit=limits[round % num_limits];
+    makeFrame(frame,round,round % 4,rand() % 12,rand() % 40);
+    int fragments=0;
+    if (checkFrame(assembler,frame,limit,fragments)==false) return 2;
+    max_fragments=max(max_fragments,fragments);
+
+    //a frame of another camera, not split, between the fragments:
+    makeFrame(other,round,4,1,2);
+    if (assembler.add(other,result)==false || result.SerializeAsString()!=other.SerializeAsString()) {
+      fprintf(stderr,"round %d: a frame that was not split did not pass through\n",round);
+      return 2;
+    }
+  }
+
+  //a frame missing a fragment is never delivered, and the next one is:
+  int incomplete=assembler.getIncomplete();
+  makeFrame(frame,rounds,1,8,30);
+  vector<SSL_DetectionFrame> fragments;
+  DetectionFragments::split(frame,300,fragments);
+  for (unsigned int i=1;i<fragments.size();i++) {
+    if (assembler.add(fragments[i],result)) {
+      fprintf(stderr,"a frame was assembled without its first fragment\n");
+      return 2;
+    }
+  }
+  makeFrame(frame,rounds+1,1,8,30);
+  int fragment_count;
+  if (checkFrame(assembler,frame,300,fragment_count)==false) return 2;
+  if (assembler.getIncomplete()!=incomplete+1) {
+    fprintf(stderr,"the frame with a lost fragment was not counted as incomplete\n");
+    return 2;
+  }
+
+  //balls and robots too large for a packet each go alone into one:
+  makeFrame(frame,rounds+2,2,3,4);
+  SSL_DetectionFrame header(frame);
+  header.clear_balls();
+  header.clear_robots_yellow();
+  header.clear_robots_blue();
+  header.set_fragment_index(100);
+  header.set_fragment_count(100);
+  int limit=DetectionFragments::wrappedSize(header.ByteSize()+2);
+  if (checkFrame(assembler,frame,limit,fragment_count,false)==false) return 2;
+  if (fragment_count!=3+2*4) {
+    fprintf(stderr,"%d entries too large for a packet went into %d fragments\n",3+2*4,fragment_count);
+    return 2;
+  }
+
+  printf("%d frames split into up to %d fragments each: all assembled exactly\n",rounds,max_fragments);
+  return 0;
+}
@@ -0,0 +1,237 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    framebuffer_benchmark.cpp
+  \brief   Stress test and contention benchmark of the lock-free
+           SPMCRingBuffer against the mutex based RingBuffer.
+  \author  Author Name, 2009
+*/
+//========================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <QString>
+#include <QThread>
+#include "qgetopt.h"
+#include "timer.h"
+#include "ringbuffer.h"
+#include "spmc_ringbuffer.h"
+
+using namespace std;
+
+//a frame whose payload is derived from its sequence number, so that
+//readers can detect frames that were overwritten while being read:
+class BenchmarkFrame {
+public:
+  int sequence;
+  vector<int> payload;
+  BenchmarkFrame() {
+    sequence=0;
+  }
+  void fill(int seq, int n) {
+    if ((int)payload.size()!=n) payload.resize(n);
+    sequence=seq;
+    for (int i=0;i<n;i++) payload[i]=seq+i;
+  }
+  bool check(int seq) const {
+    if (sequence!=seq) return false;
+    for (unsigned int i=0;i<payload.size();i++) {
+      if (payload[i]!=seq+(int)i) return false;
+    }
+    return true;
+  }
+};
+
+class ThreadStats {
+public:
+  long long ops;
+  long long errors;
+  double total_wait;
+  double max_wait;
+  ThreadStats() {
+    ops=0;
+    errors=0;
+    total_wait=0.0;
+    max_wait=0.0;
+  }
+  void addWait(double t) {
+    ops++;
+    total_wait+=t;
+    if (t > max_wait) max_wait=t;
+  }
+  void add(const ThreadStats & s) {
+    ops+=s.ops;
+    errors+=s.errors;
+    total_wait+=s.total_wait;
+    if (s.max_wait > max_wait) max_wait=s.max_wait;
+  }
+};
+
+static void spin(double usec) {
+  if (usec <= 0.0) return;
+  double end=GetTimeSec()+usec*1e-6;
+  while (GetTimeSec() < end) {}
+}
+
+class BenchmarkThread : public QThread {
+protected:
+  RingBuffer<BenchmarkFrame> * locked;
+  SPMCRingBuffer<BenchmarkFrame> * lockfree;
+  bool writer;
+  int payload;
+  double work_usec;
+  volatile bool * stop;
+public:
+  ThreadStats stats;
+  BenchmarkThread(RingBuffer<BenchmarkFrame> * _locked, SPMCRingBuffer<BenchmarkFrame> * _lockfree,
+                  bool _writer, int _payload, double _work_usec, volatile bool * _stop) {
+    locked=_locked;
+    lockfree=_lockfree;
+    writer=_writer;
+    payload=_payload;
+    work_usec=_work_usec;
+    stop=_stop;
+  }
+  virtual void run() {
+    int seq=0;
+    while (*stop==false) {
+      if (writer) {
+        seq++;
+        if (lockfree!=0) {
+          lockfree->getPointer(lockfree->curWrite())->fill(seq,payload);
+          spin(work_usec);
+          double t=GetTimeSec();
+          int published=lockfree->publish();
+          stats.addWait(GetTimeSec()-t);
+          if (published!=seq) stats.errors++;
+        } else {
+          locked->getPointer(locked->curWrite())->fill(seq,payload);
+          spin(work_usec);
+          double t=GetTimeSec();
+          locked->nextWrite(true);
+          stats.addWait(GetTimeSec()-t);
+        }
+      } else {
+        if (lockfree!=0) {
+          double t=GetTimeSec();
+          int idx=lockfree->acquireLatest(&seq);
+          stats.addWait(GetTimeSec()-t);
+          if (idx < 0) continue;
+          const BenchmarkFrame * frame=lockfree->getPointer(idx);
+          spin(work_usec);
+          if (frame->check(seq)==false) stats.errors++;
+          lockfree->release(idx);
+        } else {
+          //the display pattern of the old ring: serialize readers, advance, read
+          double t=GetTimeSec();
+          locked->lockRead();
+          locked->nextRead(true);
+          int idx=locked->curRead();
+          stats.addWait(GetTimeSec()-t);
+          const BenchmarkFrame * frame=locked->getPointer(idx);
+          spin(work_usec);
+          if (frame->sequence!=0 && frame->check(frame->sequence)==false) stats.errors++;
+          locked->unlockRead();
+        }
+      }
+    }
+  }
+};
+
+static void runBenchmark(const char * name, bool use_lockfree, int size, int readers, int payload,
+                         double writer_work, double reader_work, double seconds, bool & failed) {
+  RingBuffer<BenchmarkFrame> * locked=0;
+  SPMCRingBuffer<BenchmarkFrame> * lockfree=0;
+  if (use_lockfree) {
+    lockfree=new SPMCRingBuffer<BenchmarkFrame>(size);
+  } else {
+    locked=new RingBuffer<BenchmarkFrame>(size);
+  }
+  volatile bool stop=false;
+  vector<BenchmarkThread *> threads;
+  threads.push_back(new BenchmarkThread(locked,lockfree,true,payload,writer_work,&stop));
+  for (int i=0;i<readers;i++) {
+    threads.push_back(new BenchmarkThread(locked,lockfree,false,payload,reader_work,&stop));
+  }
+  for (unsigned int i=0;i<threads.size();i++) threads[i]->start();
+  usleep((useconds_t)(seconds*1e6));
+  stop=true;
+  for (unsigned int i=0;i<threads.size();i++) threads[i]->wait();
+
+  ThreadStats w=threads[0]->stats;
+  ThreadStats r;
+  for (unsigned int i=1;i<threads.size();i++) r.add(threads[i]->stats);
+  printf("%-10s %10.0f %9.3f %9.1f %10.0f %9.3f %9.1f %7lld",name,
+         w.ops/seconds,w.ops > 0 ? w.total_wait*1e6/w.ops : 0.0,w.max_wait*1e6,
+         r.ops/seconds,r.ops > 0 ? r.total_wait*1e6/r.ops : 0.0,r.max_wait*1e6,w.errors+r.errors);
+  if (lockfree!=0) {
+    printf("  %d stalls, %d retries",lockfree->getWriterStalls(),lockfree->getReadRetries());
+  }
+  printf("\n");
+  if (w.errors+r.errors > 0) failed=true;
+
+  for (unsigned int i=0;i<threads.size();i++) delete threads[i];
+  delete locked;
+  delete lockfree;
+}
+
+int main(int argc, char *argv[])
+{
+  GetOpt opts(argc, argv);
+  bool help=false;
+  QString seconds_str="2";
+  QString readers_str="3";
+  QString size_str="5";
+  QString payload_str="16384";
+  QString writer_work_str="0";
+  QString reader_work_str="0";
+  opts.addSwitch("help",&help);
+  opts.addOption('s',"seconds",&seconds_str);
+  opts.addOption('r',"readers",&readers_str);
+  opts.addOption('z',"size",&size_str);
+  opts.addOption('p',"payload",&payload_str);
+  opts.addOption('w',"writer-work",&writer_work_str);
+  opts.addOption('k',"reader-work",&reader_work_str);
+  if (!opts.parse()) {
+    help=true;
+  }
+  if (help) {
+    printf("Usage: frameBufferBenchmark [-s seconds] [-r readers] [-z bins] [-p payload ints]\n");
+    printf("                            [-w writer usec/frame] [-k reader usec/frame]\n");
+    printf(" Runs one writer and several readers against the mutex based RingBuffer\n");
+    printf(" (readers serialized by lockRead(), as the display widgets did) and against\n");
+    printf(" the lock-free SPMCRingBuffer. Every reader verifies the payload of the frame\n");
+    printf(" it holds; a frame modified while held counts as an error.\n");
+    exit(1);
+  }
+  double seconds=max(0.1,seconds_str.toDouble());
+  int readers=max(1,readers_str.toInt());
+  int size=max(2,size_str.toInt());
+  int payload=max(1,payload_str.toInt());
+  double writer_work=writer_work_str.toDouble();
+  double reader_work=reader_work_str.toDouble();
+
+  printf("%d readers, %d bins, %d ints per frame, %.1f s per run\n",readers,size,payload,seconds);
+  printf("%-10s %10s %9s %9s %10s %9s %9s %7s\n","ring","writes/s","avg(us)","max(us)","reads/s","avg(us)","max(us)","errors");
+  bool failed=false;
+  runBenchmark("mutex",false,size,readers,payload,writer_work,reader_work,seconds,failed);
+  runBenchmark("lock-free",true,size,readers,payload,writer_work,reader_work,seconds,failed);
+  if (failed) {
+    fprintf(stderr,"frames were modified while being read!\n");
+    return 2;
+  }
+  return 0;
+}
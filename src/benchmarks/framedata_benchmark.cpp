@@ -0,0 +1,160 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    framedata_benchmark.cpp
+  \brief   Compares the per-frame cost of FrameDataMap lookups through
+           typed FrameDataKeys with string lookups in a std::map.
+  \author  Author Name, 2009
+*/
+//========================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <QString>
+#include "qgetopt.h"
+#include "timer.h"
+#include "framedata.h"
+
+using namespace std;
+
+class BenchmarkItem {
+public:
+  int value;
+  BenchmarkItem() {
+    value=1;
+  }
+};
+
+//the items of the RoboCup SSL stack:
+static const char * labels[] = {
+  "capture_stats",
+  "cmv_threshold",
+  "cmv_runlist",
+  "cmv_reglist",
+  "cmv_colorlist",
+  "ssl_detection_frame",
+  "vis_frame"
+};
+static const int num_labels=sizeof(labels)/sizeof(labels[0]);
+
+//the lookups one frame of that stack performs, in order
+//(capture, threshold+RLE, blobs, balls, robots, network output, visualization, display):
+static const int frame_lookups[] = {
+  0,
+  2, 1, 5,
+  3, 4, 2,
+  5, 4, 1, 5,
+  5, 4, 1,
+  5,
+  6, 1, 4,
+  6, 6, 0
+};
+static const int num_lookups=sizeof(frame_lookups)/sizeof(frame_lookups[0]);
+
+int main(int argc, char *argv[])
+{
+  GetOpt opts(argc, argv);
+  bool help=false;
+  QString iterations_str="1000000";
+  QString extra_str="0";
+  opts.addSwitch("help",&help);
+  opts.addOption('n',"iterations",&iterations_str);
+  opts.addOption('e',"extra",&extra_str);
+  if (!opts.parse()) {
+    help=true;
+  }
+  if (help) {
+    printf("Usage: frameDataBenchmark [-n frames] [-e extra items]\n");
+    printf(" Times the FrameDataMap lookups of one frame of the RoboCup SSL stack,\n");
+    printf(" once through string labels in a std::map<string,void*> (the old storage),\n");
+    printf(" once through the string compatibility functions of FrameDataMap, and\n");
+    printf(" once through typed FrameDataKeys. Extra items enlarge the maps.\n");
+    exit(1);
+  }
+  int iterations=max(1,iterations_str.toInt());
+  int extra=max(0,extra_str.toInt());
+
+  vector<BenchmarkItem> items(num_labels+extra);
+  vector<string> names(labels,labels+num_labels);
+  for (int i=0;i<extra;i++) {
+    char name[32];
+    sprintf(name,"extra_item_%d",i);
+    names.push_back(name);
+  }
+
+  map<string,void *> string_map;
+  FrameData frame;
+  vector<FrameDataKey<BenchmarkItem> > keys;
+  for (unsigned int i=0;i<names.size();i++) {
+    string_map.insert(make_pair(names[i],(void *)&items[i]));
+    frame.map.insert(names[i],&items[i]);
+    keys.push_back(FrameDataKey<BenchmarkItem>(names[i]));
+  }
+  //plugins keep their keys as members; this is the equivalent:
+  vector<string> lookup_labels;
+  vector<FrameDataKey<BenchmarkItem> > lookup_keys;
+  for (int i=0;i<num_lookups;i++) {
+    lookup_labels.push_back(labels[frame_lookups[i]]);
+    lookup_keys.push_back(keys[frame_lookups[i]]);
+  }
+
+  Timer timer;
+  long long sum_map=0,sum_compat=0,sum_keys=0;
+
+  timer.start();
+  for (int k=0;k<iterations;k++) {
+    for (int i=0;i<num_lookups;i++) {
+      map<string,void *>::const_iterator iter=string_map.find(lookup_labels[i]);
+      if (iter!=string_map.end()) sum_map+=((BenchmarkItem *)iter->second)->value;
+    }
+  }
+  timer.stop();
+  double t_map=timer.timeMSec();
+
+  timer.start();
+  for (int k=0;k<iterations;k++) {
+    for (int i=0;i<num_lookups;i++) {
+      BenchmarkItem * item=(BenchmarkItem *)frame.map.get(lookup_labels[i]);
+      if (item!=0) sum_compat+=item->value;
+    }
+  }
+  timer.stop();
+  double t_compat=timer.timeMSec();
+
+  timer.start();
+  for (int k=0;k<iterations;k++) {
+    for (int i=0;i<num_lookups;i++) {
+      BenchmarkItem * item=frame.map.get(lookup_keys[i]);
+      if (item!=0) sum_keys+=item->value;
+    }
+  }
+  timer.stop();
+  double t_keys=timer.timeMSec();
+
+  long long expected=(long long)iterations*num_lookups;
+  double n=iterations;
+  printf("%d frames, %d lookups per frame, %d items\n",iterations,num_lookups,(int)names.size());
+  printf("lookup path                      ns/frame   ns/lookup\n");
+  printf("std::map<string,void*>         %10.1f  %10.2f\n",t_map*1e6/n,t_map*1e6/(n*num_lookups));
+  printf("FrameDataMap::get(string)      %10.1f  %10.2f\n",t_compat*1e6/n,t_compat*1e6/(n*num_lookups));
+  printf("FrameDataMap::get(FrameDataKey)%10.1f  %10.2f\n",t_keys*1e6/n,t_keys*1e6/(n*num_lookups));
+  if (t_keys > 0.0) printf("speedup of typed keys over std::map: %.1fx\n",t_map/t_keys);
+
+  if (sum_map!=expected || sum_compat!=expected || sum_keys!=expected) {
+    fprintf(stderr,"lookup mismatch: %lld %lld %lld, expected %lld\n",sum_map,sum_compat,sum_keys,expected);
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,158 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    region_benchmark.cpp
+  \brief   Measures run/region extraction throughput on large synthetic
+           frames (2048x1536 by default) and checks the region moments.
+  \author  Author Name, 2009
+*/
+//========================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <QString>
+#include "qgetopt.h"
+#include "timer.h"
+#include "image.h"
+#include "cmvision_region.h"
+
+using namespace std;
+
+//draws a filled, rotated ellipse of the given color:
+static void drawEllipse(Image<raw8> * img, double cx, double cy, double a, double b, double angle, int color) {
+  double c=cos(angle),s=sin(angle);
+  double r=max(a,b);
+  int width=img->getWidth();
+  int height=img->getHeight();
+  raw8 * map=img->getPixelData();
+  for (int y=max(0,(int)(cy-r));y<=min(height-1,(int)(cy+r));y++) {
+    for (int x=max(0,(int)(cx-r));x<=min(width-1,(int)(cx+r));x++) {
+      double u=( (x-cx)*c + (y-cy)*s)/a;
+      double v=(-(x-cx)*s + (y-cy)*c)/b;
+      if (u*u+v*v <= 1.0) map[y*width+x].v=color;
+    }
+  }
+}
+
+//recomputes centroid and covariance of a region by walking its runs,
+//and returns the largest deviation from the values extractRegions found.
+static double checkRegion(const CMVision::Region & reg, const CMVision::Run * runs) {
+  long double n=0,sx=0,sy=0,sxx=0,sxy=0,syy=0;
+  for (int i=reg.run_start;;i=runs[i].next) {
+    const CMVision::Run & r=runs[i];
+    for (int x=r.x;x<r.x+r.width;x++) {
+      n+=1; sx+=x; sy+=r.y; sxx+=(long double)x*x; sxy+=(long double)x*r.y; syy+=(long double)r.y*r.y;
+    }
+    if (runs[i].next==0) break;
+  }
+  long double cx=sx/n,cy=sy/n;
+  double err=0.0;
+  err=max(err,(double)fabsl(cx-reg.cen_x));
+  err=max(err,(double)fabsl(cy-reg.cen_y));
+  err=max(err,(double)fabsl((sxx/n-cx*cx)-reg.cov_xx));
+  err=max(err,(double)fabsl((sxy/n-cx*cy)-reg.cov_xy));
+  err=max(err,(double)fabsl((syy/n-cy*cy)-reg.cov_yy));
+  return err;
+}
+
+int main(int argc, char *argv[])
+{
+  GetOpt opts(argc, argv);
+  bool help=false;
+  QString iterations_str="50";
+  QString width_str="2048";
+  QString height_str="1536";
+  QString blobs_str="200";
+  opts.addSwitch("help",&help);
+  opts.addOption('n',"iterations",&iterations_str);
+  opts.addOption('x',"width",&width_str);
+  opts.addOption('y',"height",&height_str);
+  opts.addOption('b',"blobs",&blobs_str);
+  if (!opts.parse()) {
+    help=true;
+  }
+  if (help) {
+    printf("Usage: regionBenchmark [-n iterations] [-x width] [-y height] [-b blobs]\n");
+    printf(" Builds a synthetic thresholded frame (a field-sized region plus\n");
+    printf(" randomly placed, rotated ellipses), times encodeRuns/connectComponents/\n");
+    printf(" extractRegions on it and verifies the 64-bit region moments.\n");
+    exit(1);
+  }
+  int iterations=max(1,iterations_str.toInt());
+  int width=width_str.toInt();
+  int height=height_str.toInt();
+  int blobs=blobs_str.toInt();
+  if (width < 2 || height < 2) {
+    fprintf(stderr,"Invalid frame size %dx%d.\n",width,height);
+    return 1;
+  }
+
+  Image<raw8> thresholded;
+  thresholded.allocate(width,height);
+  thresholded.fillBlack();
+  //the field covers most of the frame, which is what overflowed the old 32-bit sums:
+  drawEllipse(&thresholded,width*0.5,height*0.5,width*0.7,height*0.7,0.0,1);
+  srand(1);
+  for (int i=0;i<blobs;i++) {
+    double r=3.0 + (rand() % 40);
+    drawEllipse(&thresholded,rand() % width,rand() % height,r,r*(0.3 + 0.7*(rand() % 100)/100.0),
+                (rand() % 628)/100.0,2 + (rand() % 6));
+  }
+
+  CMVision::RunList runlist(width*height/4);
+  CMVision::RegionList reglist(10000);
+  double t_encode=0.0,t_connect=0.0,t_extract=0.0;
+  Timer timer;
+  for (int k=0;k<iterations;k++) {
+    timer.start();
+    CMVision::RegionProcessing::encodeRuns(&thresholded,&runlist);
+    timer.stop(); t_encode+=timer.timeMSec();
+    timer.start();
+    CMVision::RegionProcessing::connectComponents(&runlist);
+    timer.stop(); t_connect+=timer.timeMSec();
+    timer.start();
+    CMVision::RegionProcessing::extractRegions(&reglist,&runlist);
+    timer.stop(); t_extract+=timer.timeMSec();
+  }
+
+  double max_err=0.0;
+  CMVision::Region * reg=reglist.getRegionArrayPointer();
+  for (int i=0;i<reglist.getUsedRegions();i++) {
+    max_err=max(max_err,checkRegion(reg[i],runlist.getRunArrayPointer()));
+  }
+  //the field region is the largest:
+  int field=0;
+  for (int i=1;i<reglist.getUsedRegions();i++) {
+    if (reg[i].area > reg[field].area) field=i;
+  }
+  float major=0.0,minor=0.0;
+  if (reglist.getUsedRegions() > 0) reg[field].getPrincipalVariances(major,minor);
+
+  double n=iterations;
+  double total=(t_encode+t_connect+t_extract)/n;
+  printf("%dx%d, %d runs, %d regions, %d iterations\n",width,height,runlist.getUsedRuns(),reglist.getUsedRegions(),iterations);
+  printf("encode(ms)  connect(ms)  extract(ms)  total(ms)  Mpixel/s\n");
+  printf("%10.4f  %11.4f  %11.4f  %9.4f  %8.1f\n",t_encode/n,t_connect/n,t_extract/n,total,
+         total > 0.0 ? (double)width*height/(total*1000.0) : 0.0);
+  printf("field region: area %d, centroid (%.3f,%.3f), principal std.dev. %.2f / %.2f\n",
+         reglist.getUsedRegions() > 0 ? reg[field].area : 0,
+         reglist.getUsedRegions() > 0 ? reg[field].cen_x : 0.0f,
+         reglist.getUsedRegions() > 0 ? reg[field].cen_y : 0.0f,sqrt(max(0.0f,major)),sqrt(max(0.0f,minor)));
+  printf("max moment error vs. direct summation: %g\n",max_err);
+
+  //float centroids/covariances: allow for single precision rounding of large values
+  return (max_err < 0.5 ? 0 : 2);
+}
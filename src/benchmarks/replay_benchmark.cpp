@@ -0,0 +1,264 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    replay_benchmark.cpp
+  \brief   Replays a directory of recorded frames through the RoboCup SSL
+           stack as fast as possible and reports frames/s, the time of
+           each plugin and a checksum of the detection output.
+  \author  Author Name, 2009
+*/
+//========================================================================
+
+#include <QCoreApplication>
+#include <QString>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cctype>
+#include <algorithm>
+#include "multistack_robocup_ssl.h"
+#include "renderoptions.h"
+#include "capturestats.h"
+#include "conversions.h"
+#include "image_io.h"
+#include "qgetopt.h"
+#include "timer.h"
+#include "VarTypes.h"
+
+using namespace std;
+
+static bool isImageFileName(const string & name) {
+  string::size_type pos=name.find_last_of(".");
+  if (pos==string::npos) return false;
+  string ending=name.substr(pos+1);
+  for (unsigned int i=0;i<ending.size();i++) ending[i]=toupper(ending[i]);
+  return ending=="PNG" || ending=="BMP" || ending=="JPG" || ending=="JPEG";
+}
+
+/// loads the images of \p dir in file name order and converts them to
+/// YUV422 UYVY, the default output of the capture interfaces
+static bool loadFrames(const string & dir, vector<RawImage> & frames) {
+  DIR * dp=opendir(dir.c_str());
+  if (dp==0) {
+    fprintf(stderr,"Failed to open directory %s\n",dir.c_str());
+    return false;
+  }
+  vector<string> files;
+  struct dirent * dirp;
+  while ((dirp=readdir(dp))) {
+    if (isImageFileName(dirp->d_name)) files.push_back(dir + "/" + dirp->d_name);
+  }
+  closedir(dp);
+  sort(files.begin(),files.end());
+
+  for (unsigned int i=0;i<files.size();i++) {
+    int width=-1;
+    int height=-1;
+    rgba * img=ImageIO::readRGBA(width,height,files[i].c_str());
+    if (img==0 || width < 2 || height < 1) {
+      fprintf(stderr,"Failed to load %s\n",files[i].c_str());
+      delete[] img;
+      continue;
+    }
+    RawImage frame;
+    frame.allocate(COLOR_YUV422_UYVY,width & ~1,height);
+    unsigned char * dst=frame.getData();
+    for (int y=0;y<height;y++) {
+      rgba * row=img + y*width;
+      for (int x=0;x+1<width;x+=2) {
+        int y0,u0,v0,y1,u1,v1;
+        Conversions::rgb2yuv(row[x].r,row[x].g,row[x].b,y0,u0,v0);
+        Conversions::rgb2yuv(row[x+1].r,row[x+1].g,row[x+1].b,y1,u1,v1);
+        *dst++=(unsigned char)((u0+u1)/2);
+        *dst++=(unsigned char)y0;
+        *dst++=(unsigned char)((v0+v1)/2);
+        *dst++=(unsigned char)y1;
+      }
+    }
+    delete[] img;
+    frames.push_back(frame);
+  }
+  return frames.empty()==false;
+}
+
+/// FNV-1a, continued from \p hash
+static unsigned long long addToChecksum(unsigned long long hash, const string & bytes) {
+  for (unsigned int i=0;i<bytes.size();i++) {
+    hash^=(unsigned char)bytes[i];
+    hash*=1099511628211ULL;
+  }
+  return hash;
+}
+
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+
+  GetOpt opts(argc, argv);
+  bool help=false;
+  bool send_output=false;
+  QString dir_str;
+  QString settings_str="settings.xml";
+  QString camera_str="0";
+  QString passes_str="10";
+  QString warmup_str="1";
+  opts.addSwitch("help",&help);
+  opts.addOption('d',"directory",&dir_str);
+  opts.addOption('s',"settings",&settings_str);
+  opts.addOption('c',"camera",&camera_str);
+  opts.addOption('n',"passes",&passes_str);
+  opts.addOption('w',"warmup",&warmup_str);
+  opts.addShortOptSwitch('o',QString("send output"),&send_output,false);
+  if (!opts.parse() || dir_str.isEmpty()) {
+    help=true;
+  }
+  if (help) {
+    printf("Usage: replayBenchmark -d directory [-s settings.xml] [-c camera] [-n passes] [-w warmup passes] [-o]\n");
+    printf(" Runs the images of the directory, in file name order, through the\n");
+    printf(" RoboCup SSL stack of the given camera as fast as possible. The LUT and\n");
+    printf(" calibration are those of the settings file, which is never written.\n");
+    printf(" Frame numbers and times are synthetic, so the same settings and images\n");
+    printf(" always give the same detection checksum.\n");
+    printf(" The output stage is skipped unless -o is given, which sends the\n");
+    printf(" detections to the multicast address of the settings.\n");
+    exit(1);
+  }
+  int camera=max(0,camera_str.toInt());
+  int passes=max(1,passes_str.toInt());
+  int warmup=max(0,warmup_str.toInt());
+
+  vector<RawImage> frames;
+  if (loadFrames(dir_str.toStdString(),frames)==false) {
+    fprintf(stderr,"No frames to replay in %s\n",dir_str.toLatin1().data());
+    exit(1);
+  }
+
+  RenderOptions render_opts;
+  MultiStackRoboCupSSL multi_stack(&render_opts,camera+1,true);
+
+  //this must match the data-tree of MainWindow, or the settings will not apply:
+  VarList * root=new VarList("Vision System");
+  VarExternal * stackvar;
+  root->addChild(stackvar=new VarExternal((multi_stack.getSettingsFileName() + ".xml").c_str(),multi_stack.getName()));
+  stackvar->addChild(multi_stack.getSettings());
+  for (unsigned int i=0;i<multi_stack.threads.size();i++) {
+    VisionStack * s=multi_stack.threads[i]->getStack();
+    VarList * threadvar=new VarList(("Camera " + QString::number(i)).toStdString());
+    threadvar->addChild(s->getSettings());
+    threadvar->addChild(multi_stack.threads[i]->getSettings());
+    for (unsigned int j=0;j<s->stack.size();j++) {
+      VisionPlugin * p=s->stack[j];
+      if (p->getSettings()==0) continue;
+      if (p->isSharedAmongStacks()) {
+        if (i==0) stackvar->addChild(p->getSettings());
+      } else {
+        threadvar->addChild(p->getSettings());
+      }
+    }
+    stackvar->addChild(threadvar);
+  }
+  vector<VarType *> world;
+  world.push_back(root);
+  world=VarXML::read(world,settings_str.toStdString());
+  if (send_output) multi_stack.RefreshNetworkOutput();
+
+  VisionStack * stack=multi_stack.threads[camera]->getStack();
+  int stage_count=stack->getStageCount();
+  vector<bool> run_stage(stage_count,true);
+  for (int i=0;i<stage_count;i++) {
+    if (send_output==false && stack->getStageName(i)=="output") run_stage[i]=false;
+  }
+
+  FrameData data;
+  FrameDataKey<SSL_DetectionFrame> detection_key("ssl_detection_frame");
+  data.map.insertOwned(FrameDataKey<CaptureStats>("capture_stats"),new CaptureStats());
+  data.cam_id=camera;
+
+  vector<LatencyHistogram *> sources;
+  for (unsigned int i=0;i<stack->stack.size();i++) {
+    stack->stack[i]->getLatencyHistograms(sources);
+  }
+  LatencyHistogram frame_time;
+  frame_time.setName("frame");
+
+  unsigned long long first_checksum=0;
+  bool deterministic=true;
+  double t_total=0.0;
+  Timer timer;
+  for (int pass=-warmup;pass<passes;pass++) {
+    if (pass==0) {
+      //drop what the warm-up passes recorded:
+      LatencyHistogram discard;
+      for (unsigned int i=0;i<sources.size();i++) sources[i]->snapshot(discard,true);
+    }
+    unsigned long long checksum=14695981039346656037ULL;
+    timer.start();
+    for (unsigned int f=0;f<frames.size();f++) {
+      double start=GetTimeSec();
+      data.arena.beginFrame();
+      data.number=f;
+      data.time=f/60.0;
+      data.video=frames[f];
+      for (int i=0;i<stage_count;i++) {
+        if (run_stage[i]) stack->processStage(&data,i);
+      }
+      stack->postProcess(&data);
+      if (pass >= 0) frame_time.record(GetTimeSec()-start);
+
+      SSL_DetectionFrame * detection=data.map.get(detection_key);
+      if (detection!=0) {
+        //t_sent is the wall clock, everything else depends on the input only:
+        SSL_DetectionFrame copy(*detection);
+        copy.clear_t_sent();
+        string bytes;
+        copy.SerializeToString(&bytes);
+        checksum=addToChecksum(checksum,bytes);
+      } else {
+        checksum=addToChecksum(checksum,string(1,'\0'));
+      }
+    }
+    timer.stop();
+    if (pass < 0) continue;
+    t_total+=timer.time();
+    if (pass==0) {
+      first_checksum=checksum;
+    } else if (checksum!=first_checksum) {
+      fprintf(stderr,"pass %d: checksum %016llx differs from pass 0 (%016llx)\n",pass,checksum,first_checksum);
+      deterministic=false;
+    }
+  }
+
+  int count=(int)frames.size()*passes;
+  printf("%d frames of %dx%d, %d passes after %d warm-up passes, output stage %s\n",
+         (int)frames.size(),frames[0].getWidth(),frames[0].getHeight(),passes,warmup,send_output ? "on" : "skipped");
+  printf("%.3f s, %.1f frames/s\n",t_total,t_total > 0.0 ? count/t_total : 0.0);
+  printf("%-32s %10s %10s %10s %10s\n","plugin","mean ms","p50 ms","p99 ms","max ms");
+  for (unsigned int i=0;i<sources.size();i++) {
+    LatencyHistogram h;
+    sources[i]->snapshot(h);
+    if (h.getCount()==0) continue;
+    printf("%-32s %10.3f %10.3f %10.3f %10.3f\n",h.getName().c_str(),
+           h.getMean()*1e3,h.getPercentile(0.5)*1e3,h.getPercentile(0.99)*1e3,h.getMax()*1e3);
+  }
+  printf("%-32s %10.3f %10.3f %10.3f %10.3f\n",frame_time.getName().c_str(),
+         frame_time.getMean()*1e3,frame_time.getPercentile(0.5)*1e3,frame_time.getPercentile(0.99)*1e3,frame_time.getMax()*1e3);
+  printf("detection checksum: %016llx\n",first_checksum);
+
+  data.video=RawImage();
+  for (unsigned int i=0;i<frames.size();i++) frames[i].clear();
+  if (deterministic==false) return 2;
+  return 0;
+}
@@ -0,0 +1,169 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    runlist_benchmark.cpp
+  \brief   Compares the RunList (AoS) and CompactRunList (SoA) run layouts
+           on recorded frames.
+  \author  Author Name, 2009
+*/
+//========================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <QString>
+#include <QStringList>
+#include "qgetopt.h"
+#include "timer.h"
+#include "image_io.h"
+#include "conversions.h"
+#include "lut3d.h"
+#include "VarXML.h"
+#include "cmvision_threshold.h"
+#include "cmvision_region.h"
+
+using namespace std;
+
+struct LayoutTiming {
+  double encode;
+  double connect;
+  double extract;
+  LayoutTiming() : encode(0.0), connect(0.0), extract(0.0) {}
+};
+
+//returns true if both region tables are identical
+static bool compareRegions(CMVision::RegionList * a, CMVision::RegionList * b) {
+  if (a->getUsedRegions()!=b->getUsedRegions()) return false;
+  CMVision::Region * ra=a->getRegionArrayPointer();
+  CMVision::Region * rb=b->getRegionArrayPointer();
+  for (int i=0;i<a->getUsedRegions();i++) {
+    if (ra[i].color!=rb[i].color || ra[i].area!=rb[i].area ||
+        ra[i].x1!=rb[i].x1 || ra[i].y1!=rb[i].y1 || ra[i].x2!=rb[i].x2 || ra[i].y2!=rb[i].y2 ||
+        ra[i].cen_x!=rb[i].cen_x || ra[i].cen_y!=rb[i].cen_y || ra[i].run_start!=rb[i].run_start ||
+        ra[i].cov_xx!=rb[i].cov_xx || ra[i].cov_xy!=rb[i].cov_xy || ra[i].cov_yy!=rb[i].cov_yy) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  GetOpt opts(argc, argv);
+  bool help=false;
+  QString lut_file;
+  QString iterations_str="100";
+  QString max_runs_str="50000";
+  QStringList frames;
+  opts.addSwitch("help",&help);
+  opts.addOption('l',"lut",&lut_file);
+  opts.addOption('n',"iterations",&iterations_str);
+  opts.addOption('r',"max-runs",&max_runs_str);
+  opts.addVarLengthOption("frames",&frames);
+  if (!opts.parse() || frames.size()==0 || lut_file.isEmpty()) {
+    help=true;
+  }
+  if (help) {
+    printf("Usage: runlistBenchmark --lut <cam-lut-yuv.xml> [-n iterations] [-r max-runs] --frames <image> [<image> ...]\n");
+    printf(" Thresholds each recorded frame with the YUV LUT, then times\n");
+    printf(" encodeRuns/connectComponents/extractRegions on the RunList (AoS)\n");
+    printf(" and CompactRunList (SoA) layouts and checks that both agree.\n");
+    exit(1);
+  }
+  int iterations=iterations_str.toInt();
+  int max_runs=max_runs_str.toInt();
+  if (iterations < 1) iterations=1;
+
+  //load the LUT the same way the vision stacks do:
+  YUVLUT lut(4,6,6,"");
+  lut.loadRoboCupChannels(LUTChannelMode_Numeric);
+  vector<VarType *> lut_nodes=lut.getSettings()->getChildren();
+  VarXML::read(lut_nodes,lut_file.toStdString());
+
+  CMVision::RunList aos(max_runs);
+  CMVision::CompactRunList soa(max_runs);
+  CMVision::RegionList reg_aos(10000);
+  CMVision::RegionList reg_soa(10000);
+  printf("sizeof(Run)=%d bytes, CompactRunList=%d bytes per run\n",(int)sizeof(CMVision::Run),
+    (int)(2*sizeof(unsigned short)+sizeof(raw8)+2*sizeof(int)));
+
+  LayoutTiming t_aos,t_soa;
+  int num_frames=0;
+  long long total_runs=0;
+  bool all_equal=true;
+  Timer timer;
+
+  for (int f=0;f<frames.size();f++) {
+    int width,height;
+    rgb * pixels=ImageIO::readRGB(width,height,frames[f].toStdString().c_str());
+    if (pixels==0) {
+      fprintf(stderr,"Unable to read frame '%s', skipping.\n",frames[f].toStdString().c_str());
+      continue;
+    }
+    yuvImage yuv_img;
+    yuv_img.allocate(width,height);
+    yuv * yuv_pixels=yuv_img.getPixelData();
+    for (int i=0;i<width*height;i++) {
+      yuv_pixels[i]=Conversions::rgb2yuv(pixels[i]);
+    }
+    delete[] pixels;
+
+    Image<raw8> thresholded;
+    thresholded.allocate(width,height);
+    CMVisionThreshold::thresholdImageYUV444(&thresholded,&yuv_img,&lut);
+
+    for (int k=0;k<iterations;k++) {
+      timer.start();
+      CMVision::RegionProcessing::encodeRuns(&thresholded,&aos);
+      timer.stop(); t_aos.encode+=timer.timeMSec();
+      timer.start();
+      CMVision::RegionProcessing::connectComponents(&aos);
+      timer.stop(); t_aos.connect+=timer.timeMSec();
+      timer.start();
+      CMVision::RegionProcessing::extractRegions(&reg_aos,&aos);
+      timer.stop(); t_aos.extract+=timer.timeMSec();
+
+      timer.start();
+      CMVision::RegionProcessing::encodeRuns(&thresholded,&soa);
+      timer.stop(); t_soa.encode+=timer.timeMSec();
+      timer.start();
+      CMVision::RegionProcessing::connectComponents(&soa);
+      timer.stop(); t_soa.connect+=timer.timeMSec();
+      timer.start();
+      CMVision::RegionProcessing::extractRegions(&reg_soa,&soa);
+      timer.stop(); t_soa.extract+=timer.timeMSec();
+    }
+    if (compareRegions(&reg_aos,&reg_soa)==false) {
+      fprintf(stderr,"Frame '%s': region tables differ between layouts!\n",frames[f].toStdString().c_str());
+      all_equal=false;
+    }
+    total_runs+=aos.getUsedRuns();
+    num_frames++;
+  }
+
+  if (num_frames==0) {
+    fprintf(stderr,"No frames could be loaded.\n");
+    return 1;
+  }
+
+  double n=(double)num_frames*iterations;
+  printf("%d frames x %d iterations, %.0f runs/frame on average\n",num_frames,iterations,(double)total_runs/num_frames);
+  printf("layout   encode(ms)  connect(ms)  extract(ms)  total(ms)\n");
+  printf("AoS      %10.4f  %11.4f  %11.4f  %9.4f\n",t_aos.encode/n,t_aos.connect/n,t_aos.extract/n,(t_aos.encode+t_aos.connect+t_aos.extract)/n);
+  printf("SoA      %10.4f  %11.4f  %11.4f  %9.4f\n",t_soa.encode/n,t_soa.connect/n,t_soa.extract/n,(t_soa.encode+t_soa.connect+t_soa.extract)/n);
+  printf("results %s\n",all_equal ? "identical" : "DIFFER");
+
+  return (all_equal ? 0 : 2);
+}
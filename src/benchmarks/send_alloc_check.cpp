@@ -0,0 +1,202 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    send_alloc_check.cpp
+  \brief   Checks that sending packets with a RoboCupSSLServer does not
+           touch the heap once it has warmed up, neither directly nor
+           through the send thread.
+  \author  Author Name, 2009
+*/
+//========================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <new>
+#include <QString>
+#include <QAtomicInt>
+#include "qgetopt.h"
+#include "robocup_ssl_server.h"
+#include "latency_histogram.h"
+
+using namespace std;
+
+//every operator new of the process, from any thread, while counting:
+static QAtomicInt counting;
+static QAtomicInt allocations;
+
+void * operator new(size_t size) {
+  if ((int)counting) allocations.fetchAndAddRelaxed(1);
+  void * p=malloc(size==0 ? 1 : size);
+  if (p==0) throw std::bad_alloc();
+  return p;
+}
+
+void * operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void * p) {
+  free(p);
+}
+
+void operator delete[](void * p) {
+  free(p);
+}
+
+static void makeFrame(SSL_DetectionFrame & frame, int robots) {
+  frame.set_frame_number(0);
+  frame.set_camera_id(1);
+  frame.set_t_capture(1000.0);
+  frame.set_t_sent(1000.004);
+  SSL_DetectionBall * ball=frame.add_balls();
+  ball->set_confidence(0.9f);
+  ball->set_area(60);
+  ball->set_x(100.0f);
+  ball->set_y(-200.0f);
+  ball->set_pixel_x(390.0f);
+  ball->set_pixel_y(290.0f);
+  for (int r=0;r<robots;r++) {
+    SSL_DetectionRobot * robot=(r & 1) ? frame.add_robots_blue() : frame.add_robots_yellow();
+    robot->set_confidence(0.95f);
+    robot->set_robot_id(r/2);
+    robot->set_x(300.0f*r);
+    robot->set_y(-150.0f*r);
+    robot->set_orientation(0.1f*r);
+    robot->set_pixel_x(10.0f*r);
+    robot->set_pixel_y(5.0f*r);
+    robot->set_height(140.0f);
+  }
+}
+
+static void makeGeometry(SSL_GeometryData & geometry) {
+  SSL_GeometryFieldSize * field=geometry.mutable_field();
+  field->set_line_width(10);
+  field->set_field_length(6050);
+  field->set_field_width(4050);
+  field->set_boundary_width(250);
+  field->set_referee_width(425);
+  field->set_goal_width(700);
+  field->set_goal_depth(180);
+  field->set_goal_wall_width(20);
+  field->set_center_circle_radius(500);
+  field->set_defense_radius(500);
+  field->set_defense_stretch(350);
+  field->set_free_kick_from_defense_dist(200);
+  field->set_penalty_spot_from_field_line_dist(450);
+  field->set_penalty_line_from_spot_dist(400);
+  for (int i=0;i<2;i++) {
+    SSL_GeometryCameraCalibration * calib=geometry.add_calib();
+    calib->set_camera_id(i);
+    calib->set_focal_length(500.0f);
+    calib->set_principal_point_x(390.0f);
+    calib->set_principal_point_y(290.0f);
+    calib->set_distortion(0.0f);
+    calib->set_q0(0.7f);
+    calib->set_q1(-0.7f);
+    calib->set_q2(0.0f);
+    calib->set_q3(0.0f);
+    calib->set_tx(0.0f);
+    calib->set_ty(0.0f);
+    calib->set_tz(3500.0f);
+  }
+}
+
+/// sends \p rounds of every kind of packet and returns the heap
+/// allocations they made
+static int sendRounds(RoboCupSSLServer & server, int rounds, SSL_DetectionFrame & frame,
+                      const SSL_GeometryData & geometry, const SSL_WrapperPacket & wrapper,
+                      const SSL_DeltaDetectionFrame & delta, LatencyHistogram * latency) {
+  allocations=0;
+  counting=1;
+  for (int i=0;i<rounds;i++) {
+    frame.set_frame_number(i);
+    frame.set_t_sent(1000.004+i);
+    server.send(frame,latency);
+    server.send(geometry,latency);
+    server.send(wrapper,latency);
+    server.send(delta,latency);
+    //let the send thread keep up with its queue:
+    if (server.hasSendThread() && (i % 8)==7) usleep(1000);
+  }
+  //until the send thread has sent the last packets:
+  if (server.hasSendThread()) usleep(100000);
+  counting=0;
+  return allocations;
+}
+
+int main(int argc, char *argv[])
+{
+  GetOpt opts(argc, argv);
+  bool help=false;
+  QString rounds_str="1000";
+  QString port_str="10010";
+  QString address_str="224.5.23.2";
+  opts.addSwitch("help",&help);
+  opts.addOption('n',"rounds",&rounds_str);
+  opts.addOption('p',"port",&port_str);
+  opts.addOption('a',"address",&address_str);
+  if (!opts.parse()) {
+    help=true;
+  }
+  if (help) {
+    printf("Usage: sendAllocCheck [-n rounds] [-p port] [-a multicast address]\n");
+    printf(" Counts every operator new of the process while a RoboCupSSLServer\n");
+    printf(" sends detection frames, geometry, wrapper packets and delta\n");
+    printf(" frames, after a warm-up of the same packets. Does so with direct\n");
+    printf(" sends and with the send thread, in both cases with a latency\n");
+    printf(" histogram. Exits with 2 if any steady-state send allocated.\n");
+    exit(1);
+  }
+  int rounds=max(1,rounds_str.toInt());
+
+  SSL_DetectionFrame frame;
+  makeFrame(frame,12);
+  SSL_GeometryData geometry;
+  makeGeometry(geometry);
+  SSL_WrapperPacket wrapper;
+  wrapper.mutable_detection()->CopyFrom(frame);
+  wrapper.mutable_geometry()->CopyFrom(geometry);
+  SSL_DeltaDetectionFrame delta;
+  delta.set_frame_number(0);
+  delta.set_t_capture(1000.0);
+  delta.set_t_sent_offset(4000);
+  delta.set_camera_id(1);
+  delta.set_keyframe_distance(0);
+  for (int i=0;i<60;i++) delta.add_robots_yellow(i*37-900);
+  LatencyHistogram latency("send");
+
+  RoboCupSSLServer server(port_str.toInt(),address_str.toStdString());
+  if (server.open()==false) {
+    //the packets still go through all of the server, only the socket fails:
+    printf("could not open the multicast socket, the sends will fail\n");
+  }
+  int failures=0;
+  for (int mode=0;mode<2;mode++) {
+    server.setSendThread(mode==1);
+    const char * name=(mode==0) ? "direct sends" : "send thread";
+    sendRounds(server,16,frame,geometry,wrapper,delta,&latency);
+    int buffer_allocations=server.getBufferAllocations();
+    int n=sendRounds(server,rounds,frame,geometry,wrapper,delta,&latency);
+    printf("%s: %d heap allocations in %d packets\n",name,n,rounds*4);
+    if (n!=0) failures++;
+    if (server.getBufferAllocations()!=buffer_allocations) {
+      printf("%s: the server grew its buffers after the warm-up\n",name);
+      failures++;
+    }
+  }
+  printf("%d packets dropped by a full send queue\n",server.getDroppedPackets());
+  return (failures==0) ? 0 : 2;
+}
@@ -0,0 +1,164 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    threshold_check.cpp
+  \brief   Checks that every SIMD thresholding and bitplane packing kernel
+           the CPU supports gives bit-identical results to the scalar path.
+  \author  Author Name, 2009
+*/
+//========================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <QString>
+#include "qgetopt.h"
+#include "lut3d.h"
+#include "cmvision_threshold.h"
+
+using namespace std;
+
+//bytes after each target span that no kernel may touch:
+#define CHECK_GUARD 64
+#define CHECK_GUARD_VALUE 0xa5
+
+static void fillRandom(unsigned char * data, int size) {
+  for (int i=0;i<size;i++) data[i]=(unsigned char)(rand() & 0xff);
+}
+
+static void fillLUT(YUVLUT & lut, LUTChannelMode mode) {
+  lut.loadRoboCupChannels(mode);
+  lut_mask_t * table=lut.getTable();
+  int channels=lut.getChannelCount();
+  for (unsigned int i=0;i<lut.LUT_SIZE;i++) {
+    if (mode==LUTChannelMode_Numeric) {
+      table[i]=(lut_mask_t)(rand() % channels);
+    } else {
+      table[i]=(lut_mask_t)(rand() & ((1 << min(channels,8))-1));
+    }
+  }
+}
+
+/// thresholds spans of \p num_pixels pixels, starting at \p offset
+/// macropixels into \p source, with \p kernel and with the scalar path
+static bool checkSpan(const YUVLUT & lut, const vector<uyvy> & source, int offset, int num_pixels, ThresholdKernel kernel) {
+  vector<raw8> expected(num_pixels+CHECK_GUARD);
+  vector<raw8> result(num_pixels+CHECK_GUARD);
+  memset((void *)&expected[0],CHECK_GUARD_VALUE,expected.size()*sizeof(raw8));
+  memset((void *)&result[0],CHECK_GUARD_VALUE,result.size()*sizeof(raw8));
+  CMVisionThreshold::thresholdSpanYUV422_UYVY(&expected[0],&source[offset],num_pixels,&lut,ThresholdKernelScalar);
+  CMVisionThreshold::thresholdSpanYUV422_UYVY(&result[0],&source[offset],num_pixels,&lut,kernel);
+  if (memcmp(&expected[0],&result[0],result.size()*sizeof(raw8))!=0) {
+    fprintf(stderr,"%s: span of %d pixels at macropixel %d differs from the scalar path\n",
+            CMVisionThreshold::kernelToString(kernel),num_pixels,offset);
+    return false;
+  }
+  return true;
+}
+
+/// packs random label rows of \p width pixels with \p kernel and with the scalar path
+static bool checkPack(int width, int channels, LUTChannelMode mode, ThresholdKernel kernel) {
+  int height=4;
+  vector<raw8> labels(width*height);
+  for (int i=0;i<width*height;i++) {
+    labels[i].v=(mode==LUTChannelMode_Numeric) ? (rand() % channels) : (rand() & ((1 << min(channels,8))-1));
+  }
+  ColorBitplanes expected;
+  ColorBitplanes result;
+  expected.allocate(width,height,channels,mode);
+  result.allocate(width,height,channels,mode);
+  int words=expected.getWordsPerRow()*channels*height;
+  //plane 0 of numeric mode is never written, so start both out the same:
+  memset(expected.getRow(0,0),0,words*sizeof(uint64_t));
+  memset(result.getRow(0,0),0,words*sizeof(uint64_t));
+  for (int y=0;y<height;y++) {
+    CMVisionThreshold::packBitplanes(&expected,y,&labels[y*width],ThresholdKernelScalar);
+    CMVisionThreshold::packBitplanes(&result,y,&labels[y*width],kernel);
+  }
+  if (memcmp(expected.getRow(0,0),result.getRow(0,0),words*sizeof(uint64_t))!=0) {
+    fprintf(stderr,"%s: bitplanes of width %d (%s) differ from the scalar path\n",
+            CMVisionThreshold::kernelToString(kernel),width,mode==LUTChannelMode_Numeric ? "numeric" : "bitwise");
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  GetOpt opts(argc, argv);
+  bool help=false;
+  QString rounds_str="20";
+  QString seed_str="1";
+  opts.addSwitch("help",&help);
+  opts.addOption('n',"rounds",&rounds_str);
+  opts.addOption('s',"seed",&seed_str);
+  if (!opts.parse()) {
+    help=true;
+  }
+  if (help) {
+    printf("Usage: thresholdCheck [-n rounds] [-s seed]\n");
+    printf(" Thresholds random UYVY data with random LUTs, with every kernel the\n");
+    printf(" CPU supports, and compares the labels and the packed bitplanes\n");
+    printf(" byte for byte with those of the scalar path. Covers every tail\n");
+    printf(" length of the SIMD loops, odd widths and unaligned starts.\n");
+    printf(" Exits with 2 on the first difference.\n");
+    exit(1);
+  }
+  int rounds=max(1,rounds_str.toInt());
+  srand(seed_str.toInt());
+
+  ThresholdKernel best=CMVisionThreshold::getBestKernel();
+  vector<ThresholdKernel> kernels;
+  for (int k=ThresholdKernelScalar+1;k<=ThresholdKernelAVX2;k++) {
+    if (k <= best) {
+      kernels.push_back((ThresholdKernel)k);
+    } else {
+      printf("%s: not supported by this CPU, skipped\n",CMVisionThreshold::kernelToString((ThresholdKernel)k));
+    }
+  }
+
+  YUVLUT lut_numeric(4,6,6,"");
+  YUVLUT lut_bitwise(4,6,6,"");
+  //a full frame, so that all Y/U/V combinations are likely to occur:
+  vector<uyvy> source(1024*768/2);
+  int checks=0;
+  for (int round=0;round<rounds;round++) {
+    fillLUT(lut_numeric,LUTChannelMode_Numeric);
+    fillLUT(lut_bitwise,LUTChannelMode_Bitwise);
+    fillRandom((unsigned char *)&source[0],source.size()*sizeof(uyvy));
+    for (unsigned int k=0;k<kernels.size();k++) {
+      const YUVLUT & lut=(round & 1) ? lut_bitwise : lut_numeric;
+      //every span length up to several SIMD iterations, from varying starts:
+      for (int n=2;n<=160;n+=2) {
+        if (checkSpan(lut,source,rand() % 64,n,kernels[k])==false) return 2;
+        checks++;
+      }
+      //whole rows of odd and even widths, and a whole frame:
+      int widths[]={ 1, 3, 7, 33, 63, 65, 127, 129, 639, 640, 641, 780, 1023, 1024 };
+      for (unsigned int w=0;w<sizeof(widths)/sizeof(widths[0]);w++) {
+        int pixels=widths[w]*2; //two rows keep an odd width even in pixels
+        if (checkSpan(lut,source,rand() % 64,pixels,kernels[k])==false) return 2;
+        if (checkPack(widths[w],lut_numeric.getChannelCount(),LUTChannelMode_Numeric,kernels[k])==false) return 2;
+        if (checkPack(widths[w],lut_bitwise.getChannelCount(),LUTChannelMode_Bitwise,kernels[k])==false) return 2;
+        checks+=3;
+      }
+      if (checkSpan(lut,source,0,source.size()*2,kernels[k])==false) return 2;
+      checks++;
+    }
+  }
+  printf("%d checks of %d kernel(s) against the scalar path: all identical\n",checks,(int)kernels.size());
+  return 0;
+}
@@ -0,0 +1,145 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    main.cpp
+  \brief   The headless vision server: runs the RoboCup SSL stacks and
+           publishes over UDP, without any window or OpenGL context
+  \author  Author Name, 2009
+*/
+//========================================================================
+
+#include <QCoreApplication>
+#include <QObject>
+#include <QString>
+#include <signal.h>
+#include <stdio.h>
+#include "multistack_robocup_ssl.h"
+#include "affinity_manager.h"
+#include "renderoptions.h"
+#include "qgetopt.h"
+#include "VarTypes.h"
+
+static volatile sig_atomic_t quit_requested=0;
+
+static void requestQuit(int sig) {
+  (void)sig;
+  quit_requested=1;
+}
+
+/*!
+  \class   VisionServer
+  \brief   Builds the same data-tree as the GUI, loads settings.xml into
+           it and runs the capture threads until SIGINT or SIGTERM
+
+  The settings are only read. The tree lacks the GUI-only plugins, so
+  writing it back would drop their settings from settings.xml.
+*/
+class VisionServer : public QObject {
+protected:
+  RenderOptions * opts;
+  AffinityManager * affinity;
+  MultiStackRoboCupSSL * multi_stack;
+  VarList * root;
+  vector<VarType *> world;
+
+  virtual void timerEvent(QTimerEvent * e) {
+    (void)e;
+    if (quit_requested) QCoreApplication::quit();
+  }
+public:
+  VisionServer(int cameras, bool enforce_affinity) {
+    affinity=0;
+    if (enforce_affinity) affinity=new AffinityManager();
+    opts=new RenderOptions();
+    multi_stack=new MultiStackRoboCupSSL(opts, cameras, true);
+    if (affinity!=0) affinity->planPlacement(multi_stack->threads.size());
+
+    //this must match the data-tree of MainWindow, or settings.xml will not apply:
+    root=new VarList("Vision System");
+    VarExternal * stackvar;
+    root->addChild(stackvar= new VarExternal((multi_stack->getSettingsFileName() + ".xml").c_str(),multi_stack->getName()));
+    stackvar->addChild(multi_stack->getSettings());
+    for (unsigned int i=0;i<multi_stack->threads.size();i++) {
+      VisionStack * s = multi_stack->threads[i]->getStack();
+      if (affinity!=0) multi_stack->threads[i]->setAffinityManager(affinity);
+      VarList * threadvar = new VarList(("Camera " + QString::number(i)).toStdString());
+      threadvar->addChild(s->getSettings());
+      threadvar->addChild(multi_stack->threads[i]->getSettings());
+      for (unsigned int j=0;j<s->stack.size();j++) {
+        VisionPlugin * p=s->stack[j];
+        if (p->getSettings()==0) continue;
+        if (p->isSharedAmongStacks()) {
+          if (i==0) stackvar->addChild(p->getSettings());
+        } else {
+          threadvar->addChild(p->getSettings());
+        }
+      }
+      stackvar->addChild(threadvar);
+    }
+    if (affinity!=0) affinity->placeThread(AffinityManager::RoleOther);
+
+    world.push_back(root);
+    world=VarXML::read(world,"settings.xml");
+    multi_stack->RefreshNetworkOutput();
+    multi_stack->start();
+    for (unsigned int i=0;i<multi_stack->threads.size();i++) {
+      multi_stack->threads[i]->init();
+    }
+    //a signal handler must not call into Qt, so poll its flag:
+    startTimer(200);
+  }
+
+  ~VisionServer() {
+    delete multi_stack;
+    if (affinity!=0) delete affinity;
+  }
+};
+
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+
+  GetOpt opts(argc, argv);
+  bool help=false;
+  bool enforce_affinity=false;
+  QString cameras_arg;
+  int cameras=2;
+  int ecode=0;
+  opts.addSwitch("help",&help);
+  opts.addShortOptSwitch( 'a',QString("Enforce Processor Affinity"),&enforce_affinity, false);
+  opts.addOption( 'c',QString("cameras"),&cameras_arg);
+  bool valid=opts.parse();
+  if (valid && cameras_arg.isNull()==false) cameras=cameras_arg.toInt(&valid);
+  if (!valid || cameras < 1) {
+    fprintf(stderr,"Invalid command line parameters!\n");
+    help=true;
+    ecode=1;
+  }
+
+  if (help) {
+    printf("SSL-Vision headless server command line options:\n");
+    printf(" -c N      Number of cameras (default 2)\n");
+    printf(" -a        Set Processor Affinity\n");
+    printf(" --help    Show this help\n");
+    printf("Capturing starts immediately with the settings of settings.xml.\n");
+    exit(ecode);
+  }
+
+  signal(SIGINT,requestQuit);
+  signal(SIGTERM,requestQuit);
+
+  VisionServer server(cameras, enforce_affinity);
+  return app.exec();
+}
@@ -60,6 +60,8 @@ TeamDetector::TeamDetector(LUT3D * lut3d, const CameraParameters& camera_params,
   _lut3d=lut3d;
 
   histogram=0;
+  //until init(...) has read the team config, assume the histogram check is used:
+  _histogram_enable=true;
 
   color_id_cyan = _lut3d->getChannelID("Cyan");
   if (color_id_cyan == -1) printf("WARNING color label 'Cyan' not defined in LUT!!!\n");
@@ -175,6 +177,18 @@ TeamDetector::~TeamDetector()
   if (histogram !=0) delete histogram;
 }
 
+void TeamDetector::addRegionBounds(int color, int team_color_id, int max_robots, CMVision::RegionBounds & bounds) const {
+  if (_team==0) {
+    bounds.addUnrestricted();
+    return;
+  }
+  //one center marker per robot:
+  if (color==team_color_id) bounds.add(filter_team,max(max_robots,0));
+  raw8 c;
+  c.v=color;
+  if (_unique_patterns && model.usesColor(c)) bounds.add(filter_others);
+}
+
 void TeamDetector::update(::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot >* robots, int team_color_id, int max_robots, const Image<raw8> * image, CMVision::ColorRegionList * colorlist, CMVision::RegionTree & reg_tree) {
   color_id_team=team_color_id;
   _max_robots=max_robots;
@@ -232,6 +232,18 @@ public:
 
     void init(Team * team);
 
+    //whether update(...) reads the thresholded image (only needed for histogram checks)
+    bool isHistogramEnabled() const {
+      return _histogram_enable;
+    }
+
+    //adds the ranges of the regions of \p color that update(...) looks at,
+    //when it is called with \p max_robots. before init(...), all regions
+    //are needed.
+    //like isHistogramEnabled(), this reads what init(...) set up, so only
+    //call it from the thread that calls init(...) and update(...).
+    void addRegionBounds(int color, int team_color_id, int max_robots, CMVision::RegionBounds & bounds) const;
+
     void findRobotsByModel(::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot >* robots, int team_color_id, const Image<raw8> * image, CMVision::ColorRegionList * colorlist, CMVision::RegionTree & reg_tree);
 
     void findRobotsByTeamMarkerOnly(::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot >* robots, int team_color_id, const Image<raw8> * image, CMVision::ColorRegionList * colorlist);
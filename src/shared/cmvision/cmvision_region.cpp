@@ -21,9 +21,28 @@
 */
 //========================================================================
 #include "cmvision_region.h"
+#include "band_worker_pool.h"
+#include <algorithm>
 
 namespace CMVision {
 
+// connectRange() applied to each band of a band-parallel encoded runlist
+class ConnectBandsJob : public BandJob {
+protected:
+  Run * _map;
+  const std::vector<int> & _starts;
+  int _num;
+public:
+  ConnectBandsJob(Run * map, const std::vector<int> & starts, int num) : _map(map), _starts(starts), _num(num) {}
+  virtual void processBand(int band, int num_bands) {
+    int start=_starts[band];
+    int end=(band+1 < num_bands) ? _starts[band+1] : _num;
+    if (start > _num) start=_num;
+    if (end > _num) end=_num;
+    RegionProcessing::connectRange(_map,start,end);
+  }
+};
+
 RegionProcessing::RegionProcessing()
 {
 }
@@ -46,53 +65,205 @@ void RegionProcessing::encodeRuns(Image<raw8> * tmap, CMVision::RunList * runlis
   int width=tmap->getWidth();
   int height=tmap->getHeight();
 
+  int y,j;
+
+  j = 0;
+  for(y=0; y<height; y++){
+    j = encodeRow(&map[y * width], width, y, runs, j, max_runs);
+    if(j >= max_runs) break;
+  }
+
+  runlist->setUsedRuns(j);
+  runlist->clearBandStarts();
+}
 
+int RegionProcessing::encodeRow(const raw8 * row, int width, int y, CMVision::Run * runs, int num_runs, int max_runs)
+// Run length encodes one row of a thresholded image. This is the inner
+// loop of encodeRuns, exposed so that callers producing the thresholded
+// data row by row (see PluginThresholdRunlengthEncode) can encode each
+// row while it is still in cache.
+{
   raw8 clear(0);
   raw8 m;
-  raw8 *row;
-  int x,y,j,l;
+  int x,j,l;
   CMVision::Run r;
 
   r.next = 0;
+  r.y = y;
+
+  j = num_runs;
+  x = 0;
+  while(x < width){
+    m = row[x];
+    r.x = x;
+
+    l = x;
+
+    //fix by Stefan: stop if x==row-width
+    //(and don't access the row array in that case as it could cause a segfault)
+    //Note that the left argument of the && operator is always evaluated first and as
+    //such this expression should be safe.
+    while(x != width && row[x] == m) x++;
+
+    if(m != clear || x==width) {
+      r.color = m;
+      r.width = x - l;
+      r.parent = j;
+      runs[j++] = r;
+
+      if(j >= max_runs){
+        return j;
+      }
+    }
+  }
+  return j;
+}
 
-  j = 0;
-  for(y=0; y<height; y++){
-    row = &map[y * width];
 
-    r.y = y;
 
-    x = 0;
-    while(x < width){
+
+int RegionProcessing::encodeRowSpans(const raw8 * row, int width, int y, const int * spans, int num_spans, CMVision::Run * runs, int num_runs, int max_runs)
+// Region-of-interest version of encodeRow: only the pixels inside the
+// spans are visited.  Since everything in between is clear, only the
+// clear run at the end of the row has to be added.
+{
+  raw8 clear(0);
+  raw8 m;
+  int x,j,l,end,s,last_end;
+  CMVision::Run r;
+
+  r.next = 0;
+  r.y = y;
+
+  j = num_runs;
+  for(s=0; s<num_spans; s++){
+    x = spans[2*s];
+    end = spans[2*s+1];
+    while(x < end){
       m = row[x];
       r.x = x;
-
       l = x;
+      while(x != end && row[x] == m) x++;
 
-      //fix by Stefan: stop if x==row-width
-      //(and don't access the row array in that case as it could cause a segfault)
-      //Note that the left argument of the && operator is always evaluated first and as
-      //such this expression should be safe.
-      while(x != width && row[x] == m) x++;
-
-      if(m != clear || x==width) {
-        r.color = m; 
+      if(m != clear) {
+        r.color = m;
         r.width = x - l;
         r.parent = j;
         runs[j++] = r;
 
         if(j >= max_runs){
-          runlist->setUsedRuns(j);
-          return;
+          return j;
         }
       }
     }
   }
 
+  last_end = (j == num_runs) ? 0 : (runs[j-1].x + runs[j-1].width);
+  if(last_end != width){
+    r.x = last_end;
+    r.color = clear;
+    r.width = width - last_end;
+    r.parent = j;
+    runs[j++] = r;
+  }
+  return j;
+}
+
+void RegionProcessing::encodeRuns(const ColorBitplanes * planes, CMVision::RunList * runlist)
+// Bitplane version of encodeRuns.  Produces exactly the same runs as
+// encodeRuns on the equivalent thresholded image (in numeric mode).
+{
+  int max_runs = runlist->getMaxRuns();
+  CMVision::Run * runs = runlist->getRunArrayPointer();
+  int height = planes->getHeight();
+  int y,j;
+
+  j = 0;
+  for(y=0; y<height; y++){
+    j = encodeRow(planes, y, y, runs, j, max_runs);
+    if(j >= max_runs) break;
+  }
+
   runlist->setUsedRuns(j);
+  runlist->clearBandStarts();
 }
 
+int RegionProcessing::encodeRow(const ColorBitplanes * planes, int plane_row, int y, CMVision::Run * runs, int num_runs, int max_runs)
+// Finds the start of the next non-clear run with a count-trailing-zeros
+// on the union of all channel planes, then its end with another one on
+// the inverted plane of that run's channel.  Like encodeRow on labels,
+// clear pixels only produce a run at the end of the row.
+{
+  int width = planes->getWidth();
+  int words = planes->getWordsPerRow();
+  int num_channels = planes->getNumChannels();
+  bool numeric = (planes->getMode() == LUTChannelMode_Numeric);
+  int first_channel = numeric ? 1 : 0;
+  if(!numeric && num_channels > 8) num_channels = 8;
+  const uint64_t * plane[256];
+  int c,w,x,end,j;
+  uint64_t any,v;
+  CMVision::Run r;
+
+  for(c=first_channel; c<num_channels; c++) plane[c] = planes->getRow(c, plane_row);
+
+  r.next = 0;
+  r.y = y;
+  j = num_runs;
+  x = 0; // everything left of x has been encoded
+
+  w = 0;
+  while(w < words){
+    // non-clear pixels of this word, at or right of x
+    any = 0;
+    for(c=first_channel; c<num_channels; c++) any |= plane[c][w];
+    any &= (~(uint64_t)0) << (x & 63);
+
+    while(any != 0){
+      x = (w << 6) + __builtin_ctzll(any);
+
+      // which channel starts here?
+      for(c=first_channel; c<num_channels-1; c++){
+        if((plane[c][w] >> (x & 63)) & 0x01) break;
+      }
 
+      // the run ends at the first pixel not in this channel
+      int ww = w;
+      v = (~plane[c][ww]) & ((~(uint64_t)0) << (x & 63));
+      while(v == 0 && ++ww < words) v = ~plane[c][ww];
+      end = (ww < words) ? ((ww << 6) + __builtin_ctzll(v)) : width;
+      if(end > width) end = width;
 
+      r.x = x;
+      r.width = end - x;
+      r.color = numeric ? raw8(c) : raw8(0x01 << c);
+      r.parent = j;
+      runs[j++] = r;
+      if(j >= max_runs) return j;
+
+      x = end;
+      if(ww != w) break; // continue in the word the run ended in
+      any &= (x & 63) ? ((~(uint64_t)0) << (x & 63)) : 0;
+    }
+    if(any == 0){
+      w++;
+      if(x < (w << 6)) x = (w << 6);
+    }else{
+      w = x >> 6;
+    }
+  }
+
+  if(j == num_runs || runs[j-1].x + runs[j-1].width != width){
+    // trailing clear run, which keeps the rows in lock step for connectComponents
+    int last_end = (j == num_runs) ? 0 : (runs[j-1].x + runs[j-1].width);
+    r.x = last_end;
+    r.width = width - last_end;
+    r.color = raw8(0);
+    r.parent = j;
+    runs[j++] = r;
+  }
+  return j;
+}
 
 void RegionProcessing::connectComponents(CMVision::RunList * runlist)
 // Connect components using four-connecteness so that the runs each
@@ -109,20 +280,62 @@ void RegionProcessing::connectComponents(CMVision::RunList * runlist)
 
   CMVision::Run * map=runlist->getRunArrayPointer();
   int num = runlist->getUsedRuns();
+  const std::vector<int> & bands = runlist->getBandStarts();
+  int i,j;
+
+  if(bands.size() > 1){
+    // Connect each band on its own, in parallel.  Every run only ever
+    // points at a parent inside its own band here.
+    ConnectBandsJob job(map,bands,num);
+    BandWorkerPool::run(&job,bands.size());
+
+    // Stitch the seams: union the last row of each band with the first
+    // row of the next one.
+    for(unsigned int b=1; b<bands.size(); b++){
+      int seam = bands[b];
+      if(seam <= 0 || seam >= num || seam <= bands[b-1]) continue;
+      int a_start = seam - 1;
+      while(a_start > 0 && map[a_start-1].y == map[seam-1].y) a_start--;
+      int b_end = seam + 1;
+      while(b_end < num && map[b_end].y == map[seam].y) b_end++;
+      if(map[seam].y != map[seam-1].y + 1) continue;
+      connectSeam(map,a_start,seam,seam,b_end);
+    }
+  }else{
+    connectRange(map,0,num);
+  }
+
+  // Now we need to compress all parent paths.  Since every union keeps
+  // the smaller root, the representative of a region is its first run
+  // and the result does not depend on how the runs were banded.
+  for(i=0; i<num; i++){
+    j = map[i].parent;
+    map[i].parent = map[j].parent;
+  }
+}
+
+void RegionProcessing::connectRange(CMVision::Run * map, int start, int end)
+// The union-find pass of connectComponents, restricted to runs
+// [start,end), which must hold complete, consecutive rows (except for a
+// truncated last row).  Parent paths are left uncompressed.
+{
   int l1,l2;
   CMVision::Run r1,r2;
   int i,j,s;
 
+  if(end - start < 2) return;
+
   // l2 starts on first scan line, l1 starts on second
-  l2 = 0;
-  l1 = 1;
-  while(map[l1].y == 0) l1++; // skip first line
+  l2 = start;
+  l1 = start + 1;
+  while(l1 < end && map[l1].y == map[start].y) l1++; // skip first line
+  if(l1 >= end) return;
 
   // Do rest in lock step
   r1 = map[l1];
   r2 = map[l2];
   s = l1;
-  while(l1 < num){
+  while(l1 < end){
     /*
     printf("%6d:(%3d,%3d,%3d) %6d:(%3d,%3d,%3d)\n",
 	   l1,r1.x,r1.y,r1.width,
@@ -161,20 +374,64 @@ void RegionProcessing::connectComponents(CMVision::RunList * runlist)
     }
 
     // Move to next point where values may change
+    // (never read past end, it may belong to a band processed concurrently)
     i = (r2.x + r2.width) - (r1.x + r1.width);
-    if(i >= 0) r1 = map[++l1];
+    if(i >= 0 && ++l1 < end) r1 = map[l1];
     if(i <= 0) r2 = map[++l2];
   }
+}
 
-  // Now we need to compress all parent paths
-  for(i=0; i<num; i++){
-    j = map[i].parent;
-    map[i].parent = map[j].parent;
+void RegionProcessing::connectSeam(CMVision::Run * map, int a_start, int a_end, int b_start, int b_end)
+// Unions overlapping runs of the same color between row a and the row b
+// directly below it, where both rows may already be part of (separately)
+// connected trees.  Like connectRange, the smaller root always wins.
+{
+  int l1,l2;
+  int i,j;
+
+  l2 = a_start;
+  l1 = b_start;
+  while(l1 < b_end && l2 < a_end){
+    const CMVision::Run & r1 = map[l1];
+    const CMVision::Run & r2 = map[l2];
+
+    if(r1.color==r2.color && r1.color.v!=0) {
+      if((r2.x<=r1.x && r1.x<r2.x+r2.width) ||
+        (r1.x<=r2.x && r2.x<r1.x+r1.width)){
+        i = l1;
+        while(i != map[i].parent) i = map[i].parent;
+        j = l2;
+        while(j != map[j].parent) j = map[j].parent;
+        if(i < j){
+          map[j].parent = i;
+        }else if(j < i){
+          map[i].parent = j;
+        }
+      }
+    }
+
+    i = (r2.x + r2.width) - (r1.x + r1.width);
+    if(i >= 0) l1++;
+    if(i <= 0) l2++;
   }
 }
 
 
 
+void RegionProcessing::computeRegionMoments(CMVision::Region & reg,const CMVision::RegionMoments & m)
+// The sums are exact; the division is done in double precision, so
+// the centroid stays sub-pixel accurate for regions of any size.
+{
+  double a = reg.area;
+  double cx = (double)m.sum_x / a;
+  double cy = (double)m.sum_y / a;
+  reg.cen_x = cx;
+  reg.cen_y = cy;
+  reg.cov_xx = (double)m.sum_xx / a - cx*cx;
+  reg.cov_xy = (double)m.sum_xy / a - cx*cy;
+  reg.cov_yy = (double)m.sum_yy / a - cy*cy;
+}
+
 void RegionProcessing::extractRegions(CMVision::RegionList * reglist, CMVision::RunList * runlist)
 // Takes the list of runs and formats them into a region table,
 // gathering the various statistics along the way.  num is the number
@@ -182,9 +439,10 @@ void RegionProcessing::extractRegions(CMVision::RegionList * reglist, CMVision::
 // reg[] (bounded by max_reg) is returned.  Implemented as a single
 // pass over the array of runs.
 {
-  int b,i,n,a;
+  int b,i,n;
   CMVision::Run r;
   CMVision::Region * reg = reglist->getRegionArrayPointer();
+  CMVision::RegionMoments * mom = reglist->getMomentsArrayPointer();
   CMVision::Run * rmap = runlist->getRunArrayPointer();
   int max_reg=reglist->getMaxRegions();
   int num = runlist->getUsedRuns();
@@ -203,8 +461,9 @@ void RegionProcessing::extractRegions(CMVision::RegionList * reglist, CMVision::
         reg[b].y1 = r.y;
         reg[b].x2 = r.x + r.width;
         reg[b].y2 = r.y;
-        reg[b].cen_x = rangeSum(r.x,r.width);
-        reg[b].cen_y = r.y * r.width;
+        mom[b].sum_x = mom[b].sum_y = 0;
+        mom[b].sum_xx = mom[b].sum_xy = mom[b].sum_yy = 0;
+        addRunMoments(mom[b],r.x,r.y,r.width);
         reg[b].run_start = i;
         reg[b].iterator_id = i; // temporarily use to store last run
         n++;
@@ -220,8 +479,7 @@ void RegionProcessing::extractRegions(CMVision::RegionList * reglist, CMVision::
         reg[b].x2 = max(r.x + r.width,reg[b].x2);
         reg[b].x1 = min((int)r.x,reg[b].x1);
         reg[b].y2 = r.y; // last set by lowest run
-        reg[b].cen_x += rangeSum(r.x,r.width);
-        reg[b].cen_y += r.y * r.width;
+        addRunMoments(mom[b],r.x,r.y,r.width);
         // set previous run to point to this one as next
         rmap[reg[b].iterator_id].next = i;
         reg[b].iterator_id = i;
@@ -229,11 +487,9 @@ void RegionProcessing::extractRegions(CMVision::RegionList * reglist, CMVision::
     }
   }
 
-  // calculate centroids from stored sums
+  // calculate centroids and covariances from stored sums
   for(i=0; i<n; i++){
-    a = reg[i].area;
-    reg[i].cen_x = (float)reg[i].cen_x / a;
-    reg[i].cen_y = (float)reg[i].cen_y / a;
+    computeRegionMoments(reg[i],mom[i]);
     rmap[reg[i].iterator_id].next = 0; // -1;
     reg[i].iterator_id = 0;
     reg[i].x2--; // change to inclusive range
@@ -243,6 +499,204 @@ void RegionProcessing::extractRegions(CMVision::RegionList * reglist, CMVision::
   return;
 }
 
+void RegionProcessing::encodeRuns(Image<raw8> * tmap, CMVision::CompactRunList * runlist)
+// Structure-of-arrays version of encodeRuns.  Produces the same runs
+// (in the same order) as the RunList version.
+{
+  int max_runs = runlist->getMaxRuns();
+  raw8 * map = tmap->getPixelData();
+  int width=tmap->getWidth();
+  int height=tmap->getHeight();
+
+  if(width > 0xFFFF){
+    fprintf(stderr,"CompactRunList: image width %d exceeds 16-bit run coordinates\n",width);
+    runlist->setUsedRows(0);
+    runlist->setUsedRuns(0);
+    return;
+  }
+
+  runlist->setUsedRows(height);
+  unsigned short * rx = runlist->getXArrayPointer();
+  unsigned short * rw = runlist->getWidthArrayPointer();
+  raw8 * rc = runlist->getColorArrayPointer();
+  int * rp = runlist->getParentArrayPointer();
+  int * rn = runlist->getNextArrayPointer();
+  int * row_start = runlist->getRowStart();
+
+  raw8 clear(0);
+  raw8 m;
+  raw8 *row;
+  int x,y,j,l;
+
+  j = 0;
+  for(y=0; y<height; y++){
+    row = &map[y * width];
+    row_start[y] = j;
+
+    x = 0;
+    while(x < width){
+      m = row[x];
+      l = x;
+      while(x != width && row[x] == m) x++;
+
+      if(m != clear || x==width) {
+        rx[j] = l;
+        rw[j] = x - l;
+        rc[j] = m;
+        rp[j] = j;
+        rn[j] = 0;
+        j++;
+
+        if(j >= max_runs){
+          //the last row is only partially encoded:
+          runlist->setUsedRows(y+1);
+          row_start[y+1] = j;
+          runlist->setUsedRuns(j);
+          return;
+        }
+      }
+    }
+  }
+
+  row_start[height] = j;
+  runlist->setUsedRuns(j);
+}
+
+void RegionProcessing::connectComponents(CMVision::CompactRunList * runlist)
+// Structure-of-arrays version of connectComponents.  The same union-find
+// scan, but done one pair of rows at a time using the row offsets, so
+// neither y nor the run records as a whole need to be loaded.
+{
+  const unsigned short * rx = runlist->getXArrayPointer();
+  const unsigned short * rw = runlist->getWidthArrayPointer();
+  const raw8 * rc = runlist->getColorArrayPointer();
+  int * rp = runlist->getParentArrayPointer();
+  const int * row_start = runlist->getRowStart();
+  int num = runlist->getUsedRuns();
+  int rows = runlist->getUsedRows();
+  int l1,l2,l1_end,l2_end;
+  int i,j,s,y;
+
+  s = -1;
+  for(y=1; y<rows; y++){
+    // l2 scans the previous line, l1 the current one
+    l2 = row_start[y-1];
+    l2_end = row_start[y];
+    l1 = l2_end;
+    l1_end = row_start[y+1];
+
+    while(l1 < l1_end && l2 < l2_end){
+      if(rc[l1]==rc[l2] && rc[l1].v!=0) {
+        if((rx[l2]<=rx[l1] && rx[l1]<rx[l2]+rw[l2]) ||
+           (rx[l1]<=rx[l2] && rx[l2]<rx[l1]+rw[l1])){
+          if(s != l1){
+            // if we didn't have a parent already, just take this one
+            rp[l1] = rp[l2];
+            s = l1;
+          }else if(rp[l1] != rp[l2]){
+            // otherwise union the two roots, keeping the smaller index
+            i = rp[l1];
+            while(i != rp[i]) i = rp[i];
+            j = rp[l2];
+            while(j != rp[j]) j = rp[j];
+
+            if(i < j){
+              rp[j] = i;
+              rp[l1] = rp[l2] = i;
+            }else{
+              rp[i] = j;
+              rp[l1] = rp[l2] = j;
+            }
+          }
+        }
+      }
+
+      // Move to next point where values may change
+      i = (rx[l2] + rw[l2]) - (rx[l1] + rw[l1]);
+      if(i >= 0) l1++;
+      if(i <= 0) l2++;
+    }
+  }
+
+  // Now we need to compress all parent paths
+  for(i=0; i<num; i++){
+    j = rp[i];
+    rp[i] = rp[j];
+  }
+}
+
+void RegionProcessing::extractRegions(CMVision::RegionList * reglist, CMVision::CompactRunList * runlist)
+// Structure-of-arrays version of extractRegions, producing the same
+// region table.  y is taken from the row being scanned.
+{
+  int b,i,n,y,end;
+  CMVision::Region * reg = reglist->getRegionArrayPointer();
+  CMVision::RegionMoments * mom = reglist->getMomentsArrayPointer();
+  const unsigned short * rx = runlist->getXArrayPointer();
+  const unsigned short * rw = runlist->getWidthArrayPointer();
+  const raw8 * rc = runlist->getColorArrayPointer();
+  int * rp = runlist->getParentArrayPointer();
+  int * rn = runlist->getNextArrayPointer();
+  const int * row_start = runlist->getRowStart();
+  int max_reg=reglist->getMaxRegions();
+  int rows = runlist->getUsedRows();
+
+  n = 0;
+
+  for(y=0; y<rows; y++){
+    end = row_start[y+1];
+    for(i=row_start[y]; i<end; i++){
+      if(rc[i].v!=0){
+        int x = rx[i];
+        int w = rw[i];
+        if(rp[i] == i){
+          // Add new region if this run is a root (i.e. self parented)
+          rp[i] = b = n;  // renumber to point to region id
+          reg[b].color = rc[i];
+          reg[b].area = w;
+          reg[b].x1 = x;
+          reg[b].y1 = y;
+          reg[b].x2 = x + w;
+          reg[b].y2 = y;
+          mom[b].sum_x = mom[b].sum_y = 0;
+          mom[b].sum_xx = mom[b].sum_xy = mom[b].sum_yy = 0;
+          addRunMoments(mom[b],x,y,w);
+          reg[b].run_start = i;
+          reg[b].iterator_id = i; // temporarily use to store last run
+          n++;
+          if(n >= max_reg) {
+            reglist->setUsedRegions(max_reg);
+            return;
+          }
+        }else{
+          // Otherwise update region stats incrementally
+          b = rp[rp[i]];
+          rp[i] = b; // update parent to identify region id
+          reg[b].area += w;
+          reg[b].x2 = max(x + w,reg[b].x2);
+          reg[b].x1 = min(x,reg[b].x1);
+          reg[b].y2 = y; // last set by lowest run
+          addRunMoments(mom[b],x,y,w);
+          // set previous run to point to this one as next
+          rn[reg[b].iterator_id] = i;
+          reg[b].iterator_id = i;
+        }
+      }
+    }
+  }
+
+  // calculate centroids and covariances from stored sums
+  for(i=0; i<n; i++){
+    computeRegionMoments(reg[i],mom[i]);
+    rn[reg[i].iterator_id] = 0; // -1;
+    reg[i].iterator_id = 0;
+    reg[i].x2--; // change to inclusive range
+  }
+
+  reglist->setUsedRegions(n);
+  return;
+}
+
 
 
 
@@ -250,8 +704,10 @@ void RegionProcessing::extractRegions(CMVision::RegionList * reglist, CMVision::
 int RegionProcessing::separateRegions(CMVision::ColorRegionList * colorlist, CMVision::RegionList * reglist, int min_area)
 // Splits the various regions in the region table a separate list for
 // each color.  The lists are threaded through the table using the
-// region's 'next' field.  Returns the maximal area of the regions,
-// which can be used later to speed up sorting.
+// region's 'next' field.  Regions outside of their color's bounds
+// (see ColorRegionList::getBounds) are dropped and counted.  Returns
+// the maximal area of the regions, which can be used later to speed
+// up sorting.
 {
   CMVision::Region * p;
   int i; // ,l;
@@ -265,6 +721,7 @@ int RegionProcessing::separateRegions(CMVision::ColorRegionList * colorlist, CMV
   // clear out the region list head table
   for(i=0; i<num_colors; i++){
     color[i].reset();
+    colorlist->setDroppedCount(i,0);
   }
 
   // step over the table, adding successive
@@ -278,6 +735,11 @@ int RegionProcessing::separateRegions(CMVision::ColorRegionList * colorlist, CMV
       printf("Found a color of index %d...but colorlist is only allocated for a max index of %d\n",c,num_colors-1);
     } else {
       if(area >= min_area){
+        // reject regions no consumer of this color would accept
+        if(!colorlist->getBounds(c).check(*p)){
+          colorlist->setDroppedCount(c,colorlist->getDroppedCount(c)+1);
+          continue;
+        }
         if(area > max_area) max_area = area;
         color[c].insertFront(p);
       }
@@ -341,23 +803,102 @@ CMVision::Region * RegionProcessing::sortRegionListByArea(CMVision::Region *list
   return(list);
 }
 
-void RegionProcessing::sortRegions(CMVision::ColorRegionList * colors,int max_area)
-// Sorts entire region table by area, using the above
-// function to sort each threaded region list.
+// index-array radix sort: 8 bits per pass over a contiguous key array
+#define CMV_KEY_RBITS 8
+#define CMV_KEY_RADIX (1 << CMV_KEY_RBITS)
+#define CMV_KEY_RMASK (CMV_KEY_RADIX-1)
+
+static bool regionSortKeyGreater(const CMVision::RegionSortKey & a, const CMVision::RegionSortKey & b)
+{
+  return(a.area > b.area || (a.area == b.area && a.pos < b.pos));
+}
+
+void RegionProcessing::sortKeysByArea(CMVision::RegionSortKey * keys,CMVision::RegionSortKey * tmp,int n,int max_area)
+// Stable LSD radix sort, largest area first.  Short lists are
+// insertion sorted, as the counting passes would dominate.
 {
-  int i,p;
-  // do minimal number of passes sufficient to touch all set bits
-  p = 0;
-  while(max_area != 0){
-    max_area >>= CMV_RBITS;
-    p++;
+  int i,j,shift;
+  if(n < 2) return;
+
+  if(n <= 32){
+    for(i=1; i<n; i++){
+      CMVision::RegionSortKey k = keys[i];
+      for(j=i; j>0 && keys[j-1].area < k.area; j--) keys[j] = keys[j-1];
+      keys[j] = k;
+    }
+    return;
   }
 
+  int count[CMV_KEY_RADIX];
+  CMVision::RegionSortKey * src = keys;
+  CMVision::RegionSortKey * dst = tmp;
+  for(shift=0; (max_area >> shift) != 0; shift+=CMV_KEY_RBITS){
+    for(j=0; j<CMV_KEY_RADIX; j++) count[j] = 0;
+    for(i=0; i<n; i++) count[(src[i].area >> shift) & CMV_KEY_RMASK]++;
+    // turn counts into start offsets, highest digit first
+    int sum = 0;
+    for(j=CMV_KEY_RADIX-1; j>=0; j--){
+      int c = count[j];
+      count[j] = sum;
+      sum += c;
+    }
+    for(i=0; i<n; i++) dst[count[(src[i].area >> shift) & CMV_KEY_RMASK]++] = src[i];
+    CMVision::RegionSortKey * t = src;
+    src = dst;
+    dst = t;
+  }
+  if(src != keys){
+    for(i=0; i<n; i++) keys[i] = src[i];
+  }
+}
+
+void RegionProcessing::sortRegions(CMVision::ColorRegionList * colors,int max_area,bool limit_to_bounds)
+// Sorts entire region table by area.  Each threaded region list is
+// copied into a key array, sorted there and then relinked, which
+// avoids chasing 'next' pointers on every pass.  The resulting
+// order is the same as sortRegionListByArea's.
+{
+  int i,n;
   int num_colors=colors->getNumColorRegions();
   CMVision::RegionLinkedList * color = colors->getColorRegionArrayPointer();
-  // sort each list
-  for(i=0; i<num_colors; i++){
-    color[i].setFront(sortRegionListByArea(color[i].getInitialElement(),p));
+  std::vector<CMVision::RegionSortKey> & keys = colors->getSortKeys();
+  std::vector<CMVision::RegionSortKey> & tmp = colors->getSortBuffer();
+
+  for(int c=0; c<num_colors; c++){
+    n = color[c].getNumRegions();
+    if(n < 2) continue;
+    if((int)keys.size() < n){
+      keys.resize(n);
+      tmp.resize(n);
+    }
+
+    // gather
+    n = 0;
+    for(CMVision::Region * p = color[c].getInitialElement(); p != 0; p = p->next){
+      keys[n].area = p->area;
+      keys[n].pos = n;
+      keys[n].reg = p;
+      n++;
+    }
+
+    int max_kept = limit_to_bounds ? colors->getBounds(c).getMaxCount() : 0;
+    if(max_kept > 0 && max_kept < n){
+      // nobody reads past the largest max_kept, so the rest is dropped.
+      // filters stop at the first region below their range, so keeping
+      // the rest unsorted would hide regions from them:
+      std::nth_element(keys.begin(),keys.begin()+max_kept,keys.begin()+n,regionSortKeyGreater);
+      std::sort(keys.begin(),keys.begin()+max_kept,regionSortKeyGreater);
+      colors->setDroppedCount(c,colors->getDroppedCount(c)+n-max_kept);
+      color[c].setNum(max_kept);
+      n = max_kept;
+    }else{
+      sortKeysByArea(&keys[0],&tmp[0],n,max_area);
+    }
+
+    // relink
+    for(i=0; i<n-1; i++) keys[i].reg->next = keys[i+1].reg;
+    keys[n-1].reg->next = 0;
+    color[c].setFront(keys[0].reg);
   }
 }
 
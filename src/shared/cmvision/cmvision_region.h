@@ -27,6 +27,9 @@
 #include "nkdtree.h"
 #include "cmvision_threshold.h"
 #include "lut3d.h"
+#include <vector>
+#include <math.h>
+#include <stdint.h>
 
 #define CMV_DEFAULT_MAX_RUNS 100000
 
@@ -44,22 +47,46 @@ public:
 class RunList {
 private:
   Run * runs;
+  bool owns_runs;
   int max_runs;
   int used_runs;
+  //index of the first run of each horizontal band, if the list was
+  //encoded band-parallel (empty or a single band means serial):
+  std::vector<int> band_starts;
 public:
   RunList(int _max_runs) {
-    runs=new Run[_max_runs];
+    runs=(_max_runs > 0) ? new Run[_max_runs] : 0;
+    owns_runs=true;
     max_runs=_max_runs;
     used_runs=0;
   }
+  //switches to externally owned storage (e.g. a FrameArena block) of
+  //_max_runs runs. the current runs are discarded.
+  void setStorage(Run * _runs, int _max_runs) {
+    if (owns_runs) delete[] runs;
+    runs=_runs;
+    owns_runs=false;
+    max_runs=_max_runs;
+    used_runs=0;
+    band_starts.clear();
+  }
   void setUsedRuns(int runs) {
     used_runs=runs;
   }
   int getUsedRuns() {
     return used_runs;
   }
+  void setBandStarts(const std::vector<int> & starts) {
+    band_starts=starts;
+  }
+  void clearBandStarts() {
+    band_starts.clear();
+  }
+  const std::vector<int> & getBandStarts() const {
+    return band_starts;
+  }
   ~RunList() {
-    delete[] runs;
+    if (owns_runs) delete[] runs;
   }
 public:
   Run * getRunArrayPointer() {
@@ -72,12 +99,94 @@ public:
 
 
 
+/*!
+  \class CompactRunList
+  \brief A structure-of-arrays alternative to RunList
+
+  Stores x and width as 16-bit values, and replaces the per-run y with
+  one offset per image row (getRowStart()[y] is the index of the first
+  run of row y, getRowStart()[getUsedRows()] equals getUsedRuns()).
+  The union-find scan of connectComponents thus reads 9 bytes per run
+  instead of sizeof(Run).
+
+  Run indices (parent, next and Region::run_start) are the same as in a
+  RunList that was encoded from the same image.
+*/
+class CompactRunList {
+private:
+  unsigned short * x;
+  unsigned short * width;
+  raw8 * color;
+  int * parent;
+  int * next;
+  std::vector<int> row_start;
+  int max_runs;
+  int used_runs;
+  int used_rows;
+public:
+  CompactRunList(int _max_runs) {
+    x=new unsigned short[_max_runs];
+    width=new unsigned short[_max_runs];
+    color=new raw8[_max_runs];
+    parent=new int[_max_runs];
+    next=new int[_max_runs];
+    max_runs=_max_runs;
+    used_runs=0;
+    used_rows=0;
+    row_start.push_back(0);
+  }
+  ~CompactRunList() {
+    delete[] x;
+    delete[] width;
+    delete[] color;
+    delete[] parent;
+    delete[] next;
+  }
+  void setUsedRuns(int runs) {
+    used_runs=runs;
+  }
+  int getUsedRuns() const {
+    return used_runs;
+  }
+  int getMaxRuns() const {
+    return max_runs;
+  }
+  //(re-)sizes the row offset table, keeping its content:
+  void setUsedRows(int rows) {
+    if ((int)row_start.size() < rows+1) row_start.resize(rows+1,0);
+    used_rows=rows;
+  }
+  int getUsedRows() const {
+    return used_rows;
+  }
+public:
+  unsigned short * getXArrayPointer() {
+    return x;
+  }
+  unsigned short * getWidthArrayPointer() {
+    return width;
+  }
+  raw8 * getColorArrayPointer() {
+    return color;
+  }
+  int * getParentArrayPointer() {
+    return parent;
+  }
+  int * getNextArrayPointer() {
+    return next;
+  }
+  int * getRowStart() {
+    return &row_start[0];
+  }
+};
+
 class Region{
   public:
   raw8 color;        // id of the color
   int x1,y1,x2,y2;   // bounding box (x1,y1) - (x2,y2)
   float cen_x,cen_y; // centroid
   int area;          // occupied area in pixels
+  float cov_xx,cov_xy,cov_yy; // covariance of the pixel coordinates (second central moments)
   int run_start;     // first run index for this region
   int iterator_id;   // id to prevent duplicate hits by an iterator
   Region *next;      // next region in list
@@ -92,16 +201,58 @@ class Region{
     {return(x2-x1+1);}
   int height() const
     {return(y2-y1+1);}
+
+  // orientation of the major principal axis, in radians from the x-axis
+  float getPrincipalAngle() const
+    {return(0.5f*atan2f(2.0f*cov_xy,cov_xx-cov_yy));}
+
+  // variances along the major and minor principal axes (eigenvalues of the covariance)
+  void getPrincipalVariances(float & major, float & minor) const
+  {
+    float mean=0.5f*(cov_xx+cov_yy);
+    float d=0.5f*(cov_xx-cov_yy);
+    float r=sqrtf(d*d + cov_xy*cov_xy);
+    major=mean+r;
+    minor=mean-r;
+  }
+};
+
+//raw coordinate sums of a region, accumulated in 64-bit so that
+//large regions in wide images do not overflow or lose precision:
+struct RegionMoments {
+  int64_t sum_x,sum_y;
+  int64_t sum_xx,sum_xy,sum_yy;
 };
 
 class RegionList {
 private:
   Region * regions;
+  RegionMoments * moments;
+  bool owns_regions;
   int max_regions;
   int used_regions;
 public:
   RegionList(int _max_regions) {
-    regions=new Region[_max_regions];
+    regions=(_max_regions > 0) ? new Region[_max_regions] : 0;
+    moments=(_max_regions > 0) ? new RegionMoments[_max_regions] : 0;
+    owns_regions=true;
+    max_regions=_max_regions;
+    used_regions=0;
+  }
+  //bytes of external storage needed for _max_regions regions:
+  static size_t getStorageSize(int _max_regions) {
+    return _max_regions*(sizeof(Region)+sizeof(RegionMoments));
+  }
+  //switches to externally owned storage (e.g. a FrameArena block) of
+  //getStorageSize(_max_regions) bytes. the current regions are discarded.
+  void setStorage(void * storage, int _max_regions) {
+    if (owns_regions) {
+      delete[] regions;
+      delete[] moments;
+    }
+    regions=(Region *)storage;
+    moments=(RegionMoments *)(regions + _max_regions);
+    owns_regions=false;
     max_regions=_max_regions;
     used_regions=0;
   }
@@ -112,12 +263,19 @@ public:
     return used_regions;
   }
   ~RegionList() {
-    delete[] regions;
+    if (owns_regions) {
+      delete[] regions;
+      delete[] moments;
+    }
   }
 public:
   Region * getRegionArrayPointer() const {
     return regions;
   }
+  //scratch space used by extractRegions, one entry per region:
+  RegionMoments * getMomentsArrayPointer() const {
+    return moments;
+  }
   int getMaxRegions() const {
     return max_regions;
   }
@@ -155,31 +313,6 @@ public:
   }
 };
 
-class ColorRegionList {
-private:
-  RegionLinkedList * color_regions;
-  int num_color_regions;
-public:
-  ColorRegionList(int _num_color_regions) {
-    color_regions=new RegionLinkedList[_num_color_regions];
-    num_color_regions=_num_color_regions;
-  }
-  ~ColorRegionList() {
-    delete[] color_regions;
-  }
-public:
-  const RegionLinkedList & getRegionList(int idx) const {
-    return color_regions[idx];
-  }
-  RegionLinkedList * getColorRegionArrayPointer() const {
-    return color_regions;
-  }
-  int getNumColorRegions() const {
-    return num_color_regions;
-  }
-};
-
-
 class RegionFilter{
 protected:
   const CMVision::Region *reg;
@@ -210,13 +343,13 @@ public:
     height.min=_min;
     height.max=_max;
   }
-  ClosedRangeInt getArea() {
+  ClosedRangeInt getArea() const {
     return area;
   }
-  ClosedRangeInt getWidth() {
+  ClosedRangeInt getWidth() const {
     return width;
   }
-  ClosedRangeInt getHeight() {
+  ClosedRangeInt getHeight() const {
     return height;
   }
   bool check(const CMVision::Region & reg) {
@@ -256,6 +389,132 @@ public:
   }
 };
 
+//the union of the area/size ranges that consumers of a color's regions
+//accept. separateRegions drops regions outside of it early. a color
+//that nobody has claimed (or that somebody needs unfiltered) keeps all.
+//consumers may also tell how many of the largest regions they read at
+//most, see getMaxCount().
+class RegionBounds {
+protected:
+  bool keep_all;
+  bool claimed;
+  ClosedRangeInt area;
+  ClosedRangeInt width;
+  ClosedRangeInt height;
+  int max_count; //0: no limit
+public:
+  RegionBounds() {
+    clear();
+  }
+  //forgets all claims:
+  void clear() {
+    keep_all=false;
+    claimed=false;
+    area.set(0,0);
+    width.set(0,0);
+    height.set(0,0);
+    max_count=0;
+  }
+  //a consumer that reads every region of this color:
+  void addUnrestricted() {
+    keep_all=true;
+  }
+  //a consumer that only reads regions within the given ranges, and of
+  //those only the _max_count largest (0: all of them):
+  void add(const ClosedRangeInt & _area, const ClosedRangeInt & _width, const ClosedRangeInt & _height, int _max_count=0) {
+    if (claimed==false) {
+      area=_area;
+      width=_width;
+      height=_height;
+      max_count=_max_count;
+      claimed=true;
+    } else {
+      area.set(min(area.min,_area.min),max(area.max,_area.max));
+      width.set(min(width.min,_width.min),max(width.max,_width.max));
+      height.set(min(height.min,_height.min),max(height.max,_height.max));
+      max_count=(max_count==0 || _max_count==0) ? 0 : max_count+_max_count;
+    }
+  }
+  void add(const RegionFilter & filter, int _max_count=0) {
+    add(filter.getArea(),filter.getWidth(),filter.getHeight(),_max_count);
+  }
+  //all claims of another set of bounds:
+  void add(const RegionBounds & other) {
+    if (other.keep_all) addUnrestricted();
+    if (other.claimed) add(other.area,other.width,other.height,other.max_count);
+  }
+  bool isRestricted() const {
+    return (claimed && keep_all==false);
+  }
+  //the number of regions, largest first, that the consumers read at
+  //most, or 0 if they may read all of them:
+  int getMaxCount() const {
+    return isRestricted() ? max_count : 0;
+  }
+  bool check(const CMVision::Region & reg) const {
+    if (isRestricted()==false) return true;
+    return(area.inside(reg.area) && width.inside(reg.width()) && height.inside(reg.height()));
+  }
+};
+
+//sort key used by RegionProcessing::sortRegions; pos is the position in the
+//unsorted list, which makes the order total and the sort stable:
+struct RegionSortKey {
+  int area;
+  int pos;
+  Region * reg;
+};
+
+class ColorRegionList {
+private:
+  RegionLinkedList * color_regions;
+  int num_color_regions;
+  std::vector<RegionSortKey> sort_keys;
+  std::vector<RegionSortKey> sort_tmp;
+  std::vector<RegionBounds> bounds;
+  std::vector<int> dropped;
+public:
+  ColorRegionList(int _num_color_regions) {
+    color_regions=new RegionLinkedList[_num_color_regions];
+    num_color_regions=_num_color_regions;
+    bounds.resize(_num_color_regions);
+    dropped.resize(_num_color_regions,0);
+  }
+  ~ColorRegionList() {
+    delete[] color_regions;
+  }
+public:
+  const RegionLinkedList & getRegionList(int idx) const {
+    return color_regions[idx];
+  }
+  RegionLinkedList * getColorRegionArrayPointer() const {
+    return color_regions;
+  }
+  int getNumColorRegions() const {
+    return num_color_regions;
+  }
+  //bounds applied by separateRegions, unrestricted by default:
+  RegionBounds & getBounds(int idx) {
+    return bounds[idx];
+  }
+  //number of regions separateRegions dropped for being out of bounds:
+  int getDroppedCount(int idx) const {
+    return dropped[idx];
+  }
+  void setDroppedCount(int idx, int count) {
+    dropped[idx]=count;
+  }
+  //scratch space for sorting, kept across frames to avoid reallocation:
+  std::vector<RegionSortKey> & getSortKeys() {
+    return sort_keys;
+  }
+  std::vector<RegionSortKey> & getSortBuffer() {
+    return sort_tmp;
+  }
+};
+
+
+
 
 class RegionTreeGetNext{
 public:
@@ -271,23 +530,37 @@ class RegionProcessing {
 protected:
   //==== Utility Functions ===========================================//
   // sum of integers over range [x,x+w)
-  inline static int rangeSum(int x,int w)
+  inline static int64_t rangeSum(int x,int w)
   {
-    return(w*(2*x + w-1) / 2);
+    return((int64_t)w*(2*x + w-1) / 2);
   }
 
   // sum of integer squares over range [x,x+w)
   // S(n) = n*(n+1)*(2*n+1) / 6
   // R(x,w) = S(x+w-1) - S(x-1)
   // ref: http://mathworld.wolfram.com/SquarePyramidalNumber.html
-  // note: if x+w > 1024, you must use 64-bit ints for correct results
-  inline static int rangeSumSq(int x,int w)
+  // computed in 64-bit, exact for any x+w below ~1.3 million
+  inline static int64_t rangeSumSq(int x,int w)
   {
-    int y = x + w;
-    int rs = y*(y-1)*(2*y-1) - x*(x-1)*(2*x-1);
+    int64_t y = x + w;
+    int64_t rs = y*(y-1)*(2*y-1) - (int64_t)x*(x-1)*(2*x-1);
     return(rs / 6);
   }
 
+  // adds the pixels of run [x,x+w) in row y to the moment sums
+  inline static void addRunMoments(CMVision::RegionMoments & m,int x,int y,int w)
+  {
+    int64_t sx = rangeSum(x,w);
+    m.sum_x  += sx;
+    m.sum_y  += (int64_t)y * w;
+    m.sum_xx += rangeSumSq(x,w);
+    m.sum_xy += y * sx;
+    m.sum_yy += (int64_t)y * y * w;
+  }
+
+  // computes the centroid and covariance of a region from its moment sums
+  static void computeRegionMoments(CMVision::Region & reg,const CMVision::RegionMoments & m);
+
 
 public:
     RegionProcessing();
@@ -295,13 +568,41 @@ public:
     ~RegionProcessing();
 
     static void encodeRuns(Image<raw8> * tmap, CMVision::RunList * runlist);
+    //encodes a single row, appending to runs[num_runs...]. returns the new number of used runs.
+    static int  encodeRow(const raw8 * row, int width, int y, CMVision::Run * runs, int num_runs, int max_runs);
+    //the same, reading row plane_row of per-channel bitplanes. clear areas are skipped 64 pixels
+    //at a time, so the cost only depends on the number of runs. in bitwise mode, a pixel
+    //belonging to several channels is attributed to the lowest one.
+    static int  encodeRow(const ColorBitplanes * planes, int plane_row, int y, CMVision::Run * runs, int num_runs, int max_runs);
+    static void encodeRuns(const ColorBitplanes * planes, CMVision::RunList * runlist);
+    //encodes a row whose pixels outside of the sorted, non-touching spans
+    //[spans[2i],spans[2i+1]) are known to be clear, only looking at the spans.
+    //the result equals encodeRow on the row with everything outside the spans cleared.
+    static int  encodeRowSpans(const raw8 * row, int width, int y, const int * spans, int num_spans, CMVision::Run * runs, int num_runs, int max_runs);
+    //if the runlist carries band starts (see RunList::setBandStarts), the bands are
+    //connected in parallel and then stitched at the seams. the result is identical.
     static void connectComponents(CMVision::RunList * runlist);
+    //connects runs [start,end) only, without the final path compression:
+    static void connectRange(CMVision::Run * map, int start, int end);
+    //unions the runs of two vertically adjacent rows [a_start,a_end) and [b_start,b_end):
+    static void connectSeam(CMVision::Run * map, int a_start, int a_end, int b_start, int b_end);
     static void extractRegions(CMVision::RegionList * reglist, CMVision::RunList * runlist);
+
+    //the same algorithms on the structure-of-arrays run layout:
+    static void encodeRuns(Image<raw8> * tmap, CMVision::CompactRunList * runlist);
+    static void connectComponents(CMVision::CompactRunList * runlist);
+    static void extractRegions(CMVision::RegionList * reglist, CMVision::CompactRunList * runlist);
     //returns the max area found:
     static int  separateRegions(CMVision::ColorRegionList * colorlist, CMVision::RegionList * reglist, int min_area);
 
     static CMVision::Region * sortRegionListByArea(CMVision::Region *list,int passes);
-    static void sortRegions(CMVision::ColorRegionList * colors,int max_area);
+    //sorts every color's list by descending area, ties keeping their list order.
+    //if limit_to_bounds is set, a color whose bounds have a max count (see
+    //RegionBounds::getMaxCount) only keeps that many of its largest regions;
+    //the rest are unlinked and added to its dropped count.
+    static void sortRegions(CMVision::ColorRegionList * colors,int max_area,bool limit_to_bounds=false);
+    //sorts keys [0,n) by descending area (stable), using tmp as buffer:
+    static void sortKeysByArea(CMVision::RegionSortKey * keys,CMVision::RegionSortKey * tmp,int n,int max_area);
 
 };
 
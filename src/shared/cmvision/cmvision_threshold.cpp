@@ -42,40 +42,309 @@ void CMVisionThreshold::colorizeImageFromThresholding(rgbImage & target, const I
   }
 }
 
-bool CMVisionThreshold::thresholdImageYUV422_UYVY(Image<raw8> * target, const RawImage * source, YUVLUT * lut) {
+//x86 SIMD kernels are compiled with per-function target attributes and
+//selected at runtime, so the binary still runs on CPUs without SSE4.1/AVX2.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CMV_THRESHOLD_X86_SIMD
+#include <immintrin.h>
+#endif
+
+static void thresholdSpanScalar(raw8 * target, const uyvy * source, int num_macropixels, const lut_mask_t * LUT, const YUVLUT * lut) {
+  int X_SHIFT=lut->X_SHIFT;
+  int Y_SHIFT=lut->Y_SHIFT;
+  int Z_SHIFT=lut->Z_SHIFT;
+  int Z_AND_Y_BITS=lut->Z_AND_Y_BITS;
+  int Z_BITS = lut->Z_BITS;
+  uyvy p;
+  for (int i=0;i<num_macropixels;i++) {
+    p=source[i];
+    int B=((p.u >> Y_SHIFT) << Z_BITS);
+    int C=(p.v >> Z_SHIFT);
+    target[(i << 1)]   = LUT[(((p.y1 >> X_SHIFT) << Z_AND_Y_BITS) | B | C)];
+    target[(i << 1)+1] = LUT[(((p.y2 >> X_SHIFT) << Z_AND_Y_BITS) | B | C)];
+  }
+}
+
+#ifdef CMV_THRESHOLD_X86_SIMD
+
+//Processes 4 macropixels (8 pixels) per iteration. SSE4.1 has no gather
+//instruction, so only the index computation is vectorized; the lookups
+//themselves are done with lane extracts.
+//Returns the number of macropixels processed.
+__attribute__((target("sse4.1")))
+static int thresholdSpanSSE41(raw8 * target, const uyvy * source, int num_macropixels, const lut_mask_t * LUT, const YUVLUT * lut) {
+  const __m128i x_shift = _mm_cvtsi32_si128(lut->X_SHIFT);
+  const __m128i y_shift = _mm_cvtsi32_si128(lut->Y_SHIFT);
+  const __m128i z_shift = _mm_cvtsi32_si128(lut->Z_SHIFT);
+  const __m128i zy_bits = _mm_cvtsi32_si128(lut->Z_AND_Y_BITS);
+  const __m128i z_bits  = _mm_cvtsi32_si128(lut->Z_BITS);
+  const __m128i byte_mask = _mm_set1_epi32(0xFF);
+  int i=0;
+  for (;i+4<=num_macropixels;i+=4) {
+    //each 32-bit lane holds one macropixel: u | y1<<8 | v<<16 | y2<<24
+    __m128i p  = _mm_loadu_si128((const __m128i *)(source+i));
+    __m128i u  = _mm_and_si128(p,byte_mask);
+    __m128i y1 = _mm_and_si128(_mm_srli_epi32(p,8),byte_mask);
+    __m128i v  = _mm_and_si128(_mm_srli_epi32(p,16),byte_mask);
+    __m128i y2 = _mm_srli_epi32(p,24);
+    __m128i uv = _mm_or_si128(_mm_sll_epi32(_mm_srl_epi32(u,y_shift),z_bits),_mm_srl_epi32(v,z_shift));
+    __m128i idx1 = _mm_or_si128(_mm_sll_epi32(_mm_srl_epi32(y1,x_shift),zy_bits),uv);
+    __m128i idx2 = _mm_or_si128(_mm_sll_epi32(_mm_srl_epi32(y2,x_shift),zy_bits),uv);
+    raw8 * t = target + (i << 1);
+    t[0] = LUT[_mm_extract_epi32(idx1,0)];
+    t[1] = LUT[_mm_extract_epi32(idx2,0)];
+    t[2] = LUT[_mm_extract_epi32(idx1,1)];
+    t[3] = LUT[_mm_extract_epi32(idx2,1)];
+    t[4] = LUT[_mm_extract_epi32(idx1,2)];
+    t[5] = LUT[_mm_extract_epi32(idx2,2)];
+    t[6] = LUT[_mm_extract_epi32(idx1,3)];
+    t[7] = LUT[_mm_extract_epi32(idx2,3)];
+  }
+  return i;
+}
+
+//Processes 8 macropixels (16 pixels) per iteration using 32-bit gathers.
+//Each gather reads 4 bytes starting at the LUT entry and keeps the low byte,
+//so the LUT must be padded by at least 3 bytes (checked by the caller).
+//Returns the number of macropixels processed.
+__attribute__((target("avx2")))
+static int thresholdSpanAVX2(raw8 * target, const uyvy * source, int num_macropixels, const lut_mask_t * LUT, const YUVLUT * lut) {
+  const __m128i x_shift = _mm_cvtsi32_si128(lut->X_SHIFT);
+  const __m128i y_shift = _mm_cvtsi32_si128(lut->Y_SHIFT);
+  const __m128i z_shift = _mm_cvtsi32_si128(lut->Z_SHIFT);
+  const __m128i zy_bits = _mm_cvtsi32_si128(lut->Z_AND_Y_BITS);
+  const __m128i z_bits  = _mm_cvtsi32_si128(lut->Z_BITS);
+  const __m256i byte_mask = _mm256_set1_epi32(0xFF);
+  const int * table = (const int *)LUT;
+  int i=0;
+  for (;i+8<=num_macropixels;i+=8) {
+    __m256i p  = _mm256_loadu_si256((const __m256i *)(source+i));
+    __m256i u  = _mm256_and_si256(p,byte_mask);
+    __m256i y1 = _mm256_and_si256(_mm256_srli_epi32(p,8),byte_mask);
+    __m256i v  = _mm256_and_si256(_mm256_srli_epi32(p,16),byte_mask);
+    __m256i y2 = _mm256_srli_epi32(p,24);
+    __m256i uv = _mm256_or_si256(_mm256_sll_epi32(_mm256_srl_epi32(u,y_shift),z_bits),_mm256_srl_epi32(v,z_shift));
+    __m256i idx1 = _mm256_or_si256(_mm256_sll_epi32(_mm256_srl_epi32(y1,x_shift),zy_bits),uv);
+    __m256i idx2 = _mm256_or_si256(_mm256_sll_epi32(_mm256_srl_epi32(y2,x_shift),zy_bits),uv);
+    __m256i l1 = _mm256_and_si256(_mm256_i32gather_epi32(table,idx1,1),byte_mask);
+    __m256i l2 = _mm256_and_si256(_mm256_i32gather_epi32(table,idx2,1),byte_mask);
+    //interleave to pixel order: each 32-bit lane now holds the 16-bit label pair of one macropixel
+    __m256i pairs = _mm256_or_si256(l1,_mm256_slli_epi32(l2,8));
+    //narrow to 16 bits (per 128-bit lane), then move the two useful quadwords together
+    __m256i packed = _mm256_packus_epi32(pairs,pairs);
+    packed = _mm256_permute4x64_epi64(packed,0x08);
+    _mm_storeu_si128((__m128i *)(target + (i << 1)),_mm256_castsi256_si128(packed));
+  }
+  return i;
+}
+
+#endif
+
+//Bitplane packing: converts 64 labels into one 64-bit word per channel.
+//In numeric mode a bit is set if the label equals the channel id, in
+//bitwise mode if the label has the channel's bit set.
+static inline uint64_t packWordScalar(const raw8 * labels, int n, int channel, LUTChannelMode mode) {
+  uint64_t word=0;
+  if (mode==LUTChannelMode_Numeric) {
+    for (int i=0;i<n;i++) {
+      if (labels[i].v==channel) word|=((uint64_t)1 << i);
+    }
+  } else {
+    for (int i=0;i<n;i++) {
+      if ((labels[i].v >> channel) & 0x01) word|=((uint64_t)1 << i);
+    }
+  }
+  return word;
+}
+
+#ifdef CMV_THRESHOLD_X86_SIMD
+
+//Packs the first num_words complete words of a row, 16 labels per movemask.
+__attribute__((target("sse4.1")))
+static void packBitplanesSSE41(ColorBitplanes * target, int plane_row, const raw8 * labels, int num_words, int first_channel) {
+  int num_channels=target->getNumChannels();
+  bool numeric=(target->getMode()==LUTChannelMode_Numeric);
+  uint64_t * dst[256];
+  for (int ch=first_channel;ch<num_channels;ch++) dst[ch]=target->getRow(ch,plane_row);
+  for (int w=0;w<num_words;w++) {
+    const __m128i * src=(const __m128i *)(labels + (w << 6));
+    __m128i a=_mm_loadu_si128(src);
+    __m128i b=_mm_loadu_si128(src+1);
+    __m128i c=_mm_loadu_si128(src+2);
+    __m128i d=_mm_loadu_si128(src+3);
+    for (int ch=first_channel;ch<num_channels;ch++) {
+      __m128i ma,mb,mc,md;
+      if (numeric) {
+        __m128i id=_mm_set1_epi8((char)ch);
+        ma=_mm_cmpeq_epi8(a,id);
+        mb=_mm_cmpeq_epi8(b,id);
+        mc=_mm_cmpeq_epi8(c,id);
+        md=_mm_cmpeq_epi8(d,id);
+      } else {
+        //move bit ch of every byte into its sign bit:
+        __m128i shift=_mm_cvtsi32_si128(7-ch);
+        ma=_mm_sll_epi16(a,shift);
+        mb=_mm_sll_epi16(b,shift);
+        mc=_mm_sll_epi16(c,shift);
+        md=_mm_sll_epi16(d,shift);
+      }
+      uint64_t word=(uint64_t)(uint16_t)_mm_movemask_epi8(ma)
+                  | ((uint64_t)(uint16_t)_mm_movemask_epi8(mb) << 16)
+                  | ((uint64_t)(uint16_t)_mm_movemask_epi8(mc) << 32)
+                  | ((uint64_t)(uint16_t)_mm_movemask_epi8(md) << 48);
+      dst[ch][w]=word;
+    }
+  }
+}
+
+//Packs the first num_words complete words of a row, 32 labels per movemask.
+__attribute__((target("avx2")))
+static void packBitplanesAVX2(ColorBitplanes * target, int plane_row, const raw8 * labels, int num_words, int first_channel) {
+  int num_channels=target->getNumChannels();
+  bool numeric=(target->getMode()==LUTChannelMode_Numeric);
+  uint64_t * dst[256];
+  for (int ch=first_channel;ch<num_channels;ch++) dst[ch]=target->getRow(ch,plane_row);
+  for (int w=0;w<num_words;w++) {
+    const __m256i * src=(const __m256i *)(labels + (w << 6));
+    __m256i a=_mm256_loadu_si256(src);
+    __m256i b=_mm256_loadu_si256(src+1);
+    for (int ch=first_channel;ch<num_channels;ch++) {
+      __m256i ma,mb;
+      if (numeric) {
+        __m256i id=_mm256_set1_epi8((char)ch);
+        ma=_mm256_cmpeq_epi8(a,id);
+        mb=_mm256_cmpeq_epi8(b,id);
+      } else {
+        __m128i shift=_mm_cvtsi32_si128(7-ch);
+        ma=_mm256_sll_epi16(a,shift);
+        mb=_mm256_sll_epi16(b,shift);
+      }
+      uint64_t word=(uint64_t)(uint32_t)_mm256_movemask_epi8(ma)
+                  | ((uint64_t)(uint32_t)_mm256_movemask_epi8(mb) << 32);
+      dst[ch][w]=word;
+    }
+  }
+}
+
+#endif
+
+ThresholdKernel CMVisionThreshold::getBestKernel() {
+#ifdef CMV_THRESHOLD_X86_SIMD
+  if (__builtin_cpu_supports("avx2")) return ThresholdKernelAVX2;
+  if (__builtin_cpu_supports("sse4.1")) return ThresholdKernelSSE41;
+#endif
+  return ThresholdKernelScalar;
+}
+
+const char * CMVisionThreshold::kernelToString(ThresholdKernel kernel) {
+  switch (kernel) {
+    case ThresholdKernelAuto:   return "auto";
+    case ThresholdKernelScalar: return "scalar";
+    case ThresholdKernelSSE41:  return "sse4.1";
+    case ThresholdKernelAVX2:   return "avx2";
+  }
+  return "unknown";
+}
+
+void CMVisionThreshold::thresholdSpanYUV422_UYVY(raw8 * target, const uyvy * source, int num_pixels, const YUVLUT * lut, ThresholdKernel kernel) {
+  const lut_mask_t * LUT = lut->getTable();
+  int num_macropixels = num_pixels >> 1;
+  int done = 0;
+
+  //never run a kernel the CPU does not support:
+  ThresholdKernel best = getBestKernel();
+  if (kernel==ThresholdKernelAuto || kernel > best) kernel=best;
+
+#ifdef CMV_THRESHOLD_X86_SIMD
+  if (kernel==ThresholdKernelAVX2 && (sizeof(lut_mask_t)!=1 || lut->LUT_SIZE < (0x01u << lut->TOTAL_BITS) + 3)) {
+    //the gather kernel needs byte labels and a padded table:
+    kernel=ThresholdKernelSSE41;
+  }
+  if (kernel==ThresholdKernelAVX2) {
+    done = thresholdSpanAVX2(target, source, num_macropixels, LUT, lut);
+  } else if (kernel==ThresholdKernelSSE41) {
+    done = thresholdSpanSSE41(target, source, num_macropixels, LUT, lut);
+  }
+#else
+  (void)kernel;
+#endif
+
+  //scalar path handles the remainder (and everything if no SIMD is available):
+  thresholdSpanScalar(target + (done << 1), source + done, num_macropixels - done, LUT, lut);
+}
+
+bool CMVisionThreshold::thresholdImageYUV422_UYVY(Image<raw8> * target, const RawImage * source, YUVLUT * lut, ThresholdKernel kernel) {
   if (source->getColorFormat()!=COLOR_YUV422_UYVY) {
     //TODO add YUV444 and maybe even 411 mode
     fprintf(stderr,"CMVision thresholdImageYUV422_UYVY assumes YUV422 as input, but found %s\n", Colors::colorFormatToString(source->getColorFormat()).c_str());
     return false;
   }
 
-  register lut_mask_t * LUT = lut->getTable();
-
-  register unsigned int          target_size    = target->getNumPixels();
-  register uyvy *       source_pointer = (uyvy*)(source->getData());
-  register raw8 *      target_pointer = target->getPixelData();
-
   if (target->getNumPixels() != source->getNumPixels()) {
     fprintf(stderr, "CMVision YUV422_UYVY thresholding: source (num=%d  w=%d  h=%d) and target (num=%d w=%d h=%d) pixel counts do not match!\n", source->getNumPixels(),source->getWidth(),source->getHeight(), target->getNumPixels(),target->getWidth(),target->getHeight());
     return false;
   }
 
   lut->lock();
-  int X_SHIFT=lut->X_SHIFT;
-  int Y_SHIFT=lut->Y_SHIFT;
-  int Z_SHIFT=lut->Z_SHIFT;
-  int Z_AND_Y_BITS=lut->Z_AND_Y_BITS;
-  int Z_BITS = lut->Z_BITS;
-  uyvy p;
-  for (unsigned int i=0;i<target_size;i+=2) {
-    p=source_pointer[(i >> 0x01)];
-    register int B=((p.u >> Y_SHIFT) << Z_BITS);
-    register int C=(p.v >> Z_SHIFT);
-    target_pointer[i] =  LUT[(((p.y1 >> X_SHIFT) << Z_AND_Y_BITS) | B | C)];
-    target_pointer[i+1] =  LUT[(((p.y2 >> X_SHIFT) << Z_AND_Y_BITS) | B | C)];
+  thresholdSpanYUV422_UYVY(target->getPixelData(), (const uyvy *)(source->getData()), target->getNumPixels(), lut, kernel);
+  lut->unlock();
+  return true;
+}
+
+void CMVisionThreshold::packBitplanes(ColorBitplanes * target, int plane_row, const raw8 * labels, ThresholdKernel kernel) {
+  int width=target->getWidth();
+  int num_words=target->getWordsPerRow();
+  int num_channels=target->getNumChannels();
+  LUTChannelMode mode=target->getMode();
+  //in numeric mode, channel 0 is <Clear> and not needed for run extraction:
+  int first_channel=(mode==LUTChannelMode_Numeric) ? 1 : 0;
+  if (mode==LUTChannelMode_Bitwise && num_channels > 8) num_channels=8;
+  int full_words=width >> 6;
+  int done=0;
+
+  ThresholdKernel best = getBestKernel();
+  if (kernel==ThresholdKernelAuto || kernel > best) kernel=best;
+#ifdef CMV_THRESHOLD_X86_SIMD
+  if (kernel==ThresholdKernelAVX2) {
+    packBitplanesAVX2(target, plane_row, labels, full_words, first_channel);
+    done=full_words;
+  } else if (kernel==ThresholdKernelSSE41) {
+    packBitplanesSSE41(target, plane_row, labels, full_words, first_channel);
+    done=full_words;
+  }
+#else
+  (void)kernel;
+#endif
+  for (int w=done;w<num_words;w++) {
+    int n=width - (w << 6);
+    if (n > 64) n=64;
+    for (int ch=first_channel;ch<num_channels;ch++) {
+      target->getRow(ch,plane_row)[w]=packWordScalar(labels + (w << 6), n, ch, mode);
+    }
+  }
+}
+
+bool CMVisionThreshold::thresholdBitplanesYUV422_UYVY(ColorBitplanes * target, const RawImage * source, YUVLUT * lut, ThresholdKernel kernel) {
+  if (source->getColorFormat()!=COLOR_YUV422_UYVY) {
+    fprintf(stderr,"CMVision thresholdBitplanesYUV422_UYVY assumes YUV422 as input, but found %s\n", Colors::colorFormatToString(source->getColorFormat()).c_str());
+    return false;
+  }
+  int width=source->getWidth();
+  int height=source->getHeight();
+  if (target->getWidth()!=width || target->getHeight()!=height || (width & 0x01)!=0) {
+    fprintf(stderr, "CMVision YUV422_UYVY bitplane thresholding: source (w=%d h=%d) and target (w=%d h=%d) sizes do not match!\n", width, height, target->getWidth(), target->getHeight());
+    return false;
+  }
+
+  Image<raw8> row;
+  row.allocate(width,1);
+  const uyvy * src=(const uyvy *)(source->getData());
+  lut->lock();
+  for (int y=0;y<height;y++) {
+    thresholdSpanYUV422_UYVY(row.getPixelData(), src + y*(width >> 1), width, lut, kernel);
+    packBitplanes(target, y, row.getPixelData(), kernel);
   }
   lut->unlock();
-  //printf("time: %f\n",t.time());
   return true;
 }
 
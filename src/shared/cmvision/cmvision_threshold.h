@@ -27,6 +27,81 @@
 #include "image.h"
 #include "colors.h"
 #include "timer.h"
+#include <stdint.h>
+
+/// The kernels available for thresholding YUV422 (UYVY) data.
+/// ThresholdKernelAuto selects the fastest kernel supported by the running CPU.
+enum ThresholdKernel {
+  ThresholdKernelAuto = 0,
+  ThresholdKernelScalar,
+  ThresholdKernelSSE41,
+  ThresholdKernelAVX2
+};
+
+/*!
+  \class ColorBitplanes
+  \brief Bit-packed thresholding result: one bit per pixel per LUT channel
+
+  Each row of each channel is stored as getWordsPerRow() 64-bit words,
+  pixel x of a row being bit (x & 63) of word (x >> 6). Bits beyond the
+  image width are always zero. The channels of one row are stored next
+  to each other, since run extraction visits all channels of a row.
+
+  In LUTChannelMode_Numeric, plane c is set where the pixel's label equals
+  c, so the planes are disjoint; plane 0 (<Clear>) is never filled.
+  In LUTChannelMode_Bitwise, plane c is bit c of the pixel's label mask.
+*/
+class ColorBitplanes {
+protected:
+  uint64_t * bits;
+  int width;
+  int height;
+  int num_channels;
+  int words_per_row;
+  LUTChannelMode mode;
+public:
+  ColorBitplanes() {
+    bits=0;
+    width=height=num_channels=words_per_row=0;
+    mode=LUTChannelMode_Numeric;
+  }
+  ~ColorBitplanes() {
+    delete[] bits;
+  }
+  void allocate(int w, int h, int channels, LUTChannelMode _mode) {
+    int words=(w + 63) >> 6;
+    if (bits==0 || words*h*channels != words_per_row*height*num_channels) {
+      delete[] bits;
+      bits=new uint64_t[words*h*channels];
+    }
+    width=w;
+    height=h;
+    num_channels=channels;
+    words_per_row=words;
+    mode=_mode;
+  }
+  int getWidth() const {
+    return width;
+  }
+  int getHeight() const {
+    return height;
+  }
+  int getNumChannels() const {
+    return num_channels;
+  }
+  int getWordsPerRow() const {
+    return words_per_row;
+  }
+  LUTChannelMode getMode() const {
+    return mode;
+  }
+  uint64_t * getRow(int channel, int y) const {
+    return bits + ((y * num_channels) + channel) * words_per_row;
+  }
+  bool test(int channel, int x, int y) const {
+    return ((getRow(channel,y)[x >> 6] >> (x & 63)) & 0x01) != 0;
+  }
+};
 
 /**
 	@author James Bruce (Original CMVision implementation and algorithms),
@@ -38,10 +113,27 @@ public:
 
     ~CMVisionThreshold();
 
-    static bool thresholdImageYUV422_UYVY(Image<raw8> * target, const RawImage * source, YUVLUT * lut);
+    /// returns the fastest UYVY kernel supported by this CPU (checked at runtime)
+    static ThresholdKernel getBestKernel();
+    static const char * kernelToString(ThresholdKernel kernel);
+
+    /// thresholds \p num_pixels pixels (must be even) of UYVY data into \p target.
+    /// The caller is responsible for locking the LUT.
+    /// All kernels produce bit-identical results.
+    static void thresholdSpanYUV422_UYVY(raw8 * target, const uyvy * source, int num_pixels, const YUVLUT * lut, ThresholdKernel kernel=ThresholdKernelAuto);
+
+    static bool thresholdImageYUV422_UYVY(Image<raw8> * target, const RawImage * source, YUVLUT * lut, ThresholdKernel kernel=ThresholdKernelAuto);
     static bool thresholdImageYUV444(Image<raw8> * target, const ImageInterface * source, YUVLUT * lut);
     static bool thresholdImageRGB(Image<raw8> * target, const ImageInterface * source, RGBLUT * lut);
 
+    /// packs one row of labels (as produced by the thresholding functions) into
+    /// row \p plane_row of \p target, using SIMD compare/movemask where available.
+    static void packBitplanes(ColorBitplanes * target, int plane_row, const raw8 * labels, ThresholdKernel kernel=ThresholdKernelAuto);
+
+    /// thresholds a UYVY image directly into per-channel bitplanes.
+    /// \p target must have been allocated with the image size and the LUT's channel count.
+    static bool thresholdBitplanesYUV422_UYVY(ColorBitplanes * target, const RawImage * source, YUVLUT * lut, ThresholdKernel kernel=ThresholdKernelAuto);
+
     static void colorizeImageFromThresholding(rgbImage & target, const Image<raw8> & source, LUT3D * lut);
 
     //static void thresholdImage(Image * target, const Image<yuv> * source, const YUVLUT * lut);
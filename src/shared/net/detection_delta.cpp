@@ -0,0 +1,347 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    detection_delta.cpp
+  \brief   C++ Implementation: DetectionDeltaEncoder, DetectionDeltaDecoder
+  \author  Author Name, 2009
+*/
+//========================================================================
+#include "detection_delta.h"
+#include <math.h>
+#include <algorithm>
+
+typedef ::google::protobuf::RepeatedField< ::google::protobuf::int32 > ValueList;
+
+//quantized values stay within this, so their differences fit into an int:
+#define DELTA_MAX_VALUE 0x3fffffff
+
+#define DELTA_POSITION_SCALE 10.0
+#define DELTA_PIXEL_SCALE 16.0
+#define DELTA_ORIENTATION_SCALE 10000.0
+#define DELTA_CONFIDENCE_SCALE 1000.0
+
+static int quantizeValue(double v, double scale) {
+  double s=floor(v*scale+0.5);
+  if (s > DELTA_MAX_VALUE) return DELTA_MAX_VALUE;
+  if (s < -DELTA_MAX_VALUE) return -DELTA_MAX_VALUE;
+  if (s!=s) return 0; //NaN
+  return (int)s;
+}
+
+static int quantizeCount(unsigned int v) {
+  return (int)min(v,(unsigned int)DELTA_MAX_VALUE);
+}
+
+static const ValueList & getList(const SSL_DeltaDetectionFrame & f, int list) {
+  if (list==0) return f.balls();
+  if (list==1) return f.robots_yellow();
+  return f.robots_blue();
+}
+
+static ValueList * mutableList(SSL_DeltaDetectionFrame & f, int list) {
+  if (list==0) return f.mutable_balls();
+  if (list==1) return f.mutable_robots_yellow();
+  return f.mutable_robots_blue();
+}
+
+int DetectionDelta::valueCount(Kind kind) {
+  return kind==Ball ? 7 : 8;
+}
+
+int DetectionDelta::optionalBit(Kind kind, int value) {
+  //area/robot_id, z/orientation, height:
+  if (value==1) return 0;
+  if (value==4) return 1;
+  if (value==7 && kind==Robot) return 2;
+  return -1;
+}
+
+void DetectionDelta::quantize(const SSL_DetectionBall & ball, Entry & e) {
+  e.flags=0;
+  e.value[0]=quantizeValue(ball.confidence(),DELTA_CONFIDENCE_SCALE);
+  e.value[1]=0;
+  if (ball.has_area()) {
+    e.flags|=1;
+    e.value[1]=quantizeCount(ball.area());
+  }
+  e.value[2]=quantizeValue(ball.x(),DELTA_POSITION_SCALE);
+  e.value[3]=quantizeValue(ball.y(),DELTA_POSITION_SCALE);
+  e.value[4]=0;
+  if (ball.has_z()) {
+    e.flags|=2;
+    e.value[4]=quantizeValue(ball.z(),DELTA_POSITION_SCALE);
+  }
+  e.value[5]=quantizeValue(ball.pixel_x(),DELTA_PIXEL_SCALE);
+  e.value[6]=quantizeValue(ball.pixel_y(),DELTA_PIXEL_SCALE);
+  e.value[7]=0;
+}
+
+void DetectionDelta::quantize(const SSL_DetectionRobot & robot, Entry & e) {
+  e.flags=0;
+  e.value[0]=quantizeValue(robot.confidence(),DELTA_CONFIDENCE_SCALE);
+  e.value[1]=0;
+  if (robot.has_robot_id()) {
+    e.flags|=1;
+    e.value[1]=quantizeCount(robot.robot_id());
+  }
+  e.value[2]=quantizeValue(robot.x(),DELTA_POSITION_SCALE);
+  e.value[3]=quantizeValue(robot.y(),DELTA_POSITION_SCALE);
+  e.value[4]=0;
+  if (robot.has_orientation()) {
+    e.flags|=2;
+    e.value[4]=quantizeValue(robot.orientation(),DELTA_ORIENTATION_SCALE);
+  }
+  e.value[5]=quantizeValue(robot.pixel_x(),DELTA_PIXEL_SCALE);
+  e.value[6]=quantizeValue(robot.pixel_y(),DELTA_PIXEL_SCALE);
+  e.value[7]=0;
+  if (robot.has_height()) {
+    e.flags|=4;
+    e.value[7]=quantizeValue(robot.height(),DELTA_POSITION_SCALE);
+  }
+}
+
+void DetectionDelta::restore(const Entry & e, SSL_DetectionBall & ball) {
+  ball.set_confidence(e.value[0]/DELTA_CONFIDENCE_SCALE);
+  if (e.flags & 1) ball.set_area(e.value[1]);
+  ball.set_x(e.value[2]/DELTA_POSITION_SCALE);
+  ball.set_y(e.value[3]/DELTA_POSITION_SCALE);
+  if (e.flags & 2) ball.set_z(e.value[4]/DELTA_POSITION_SCALE);
+  ball.set_pixel_x(e.value[5]/DELTA_PIXEL_SCALE);
+  ball.set_pixel_y(e.value[6]/DELTA_PIXEL_SCALE);
+}
+
+void DetectionDelta::restore(const Entry & e, SSL_DetectionRobot & robot) {
+  robot.set_confidence(e.value[0]/DELTA_CONFIDENCE_SCALE);
+  if (e.flags & 1) robot.set_robot_id(e.value[1]);
+  robot.set_x(e.value[2]/DELTA_POSITION_SCALE);
+  robot.set_y(e.value[3]/DELTA_POSITION_SCALE);
+  if (e.flags & 2) robot.set_orientation(e.value[4]/DELTA_ORIENTATION_SCALE);
+  robot.set_pixel_x(e.value[5]/DELTA_PIXEL_SCALE);
+  robot.set_pixel_y(e.value[6]/DELTA_PIXEL_SCALE);
+  if (e.flags & 4) robot.set_height(e.value[7]/DELTA_POSITION_SCALE);
+}
+
+DetectionDeltaEncoder::DetectionDeltaEncoder(int _keyframe_interval)
+{
+  keyframe_interval=max(_keyframe_interval,1);
+  have_keyframe=false;
+  keyframe_number=0;
+  keyframe_camera=0;
+  keyframes=0;
+}
+
+void DetectionDeltaEncoder::setKeyframeInterval(int frames) {
+  keyframe_interval=max(frames,1);
+}
+
+void DetectionDeltaEncoder::reset() {
+  have_keyframe=false;
+}
+
+int DetectionDeltaEncoder::getKeyframes() const {
+  return keyframes;
+}
+
+int DetectionDeltaEncoder::matchList(Kind kind, int list) {
+  const vector<Entry> & key=keyframe[list];
+  const vector<Entry> & cur=entries[list];
+  match[list].assign(cur.size(),-1);
+  used.assign(key.size(),false);
+  int matched=0;
+  for (unsigned int i=0;i<cur.size();i++) {
+    int best=-1;
+    double best_d2=0.0;
+    for (unsigned int j=0;j<key.size();j++) {
+      if (used[j]) continue;
+      //robots must agree on their id, or on having none:
+      if (kind==Robot && ((cur[i].flags & 1)!=(key[j].flags & 1) || cur[i].value[1]!=key[j].value[1])) continue;
+      double dx=(double)cur[i].value[2]-key[j].value[2];
+      double dy=(double)cur[i].value[3]-key[j].value[3];
+      double d2=dx*dx+dy*dy;
+      if (best < 0 || d2 < best_d2) {
+        best=j;
+        best_d2=d2;
+      }
+    }
+    if (best >= 0) {
+      used[best]=true;
+      match[list][i]=best;
+      matched++;
+    }
+  }
+  return matched;
+}
+
+bool DetectionDeltaEncoder::encode(const SSL_DetectionFrame & frame, SSL_DeltaDetectionFrame & out) {
+  for (int l=0;l<3;l++) {
+    int n=(l==0) ? frame.balls_size() : (l==1) ? frame.robots_yellow_size() : frame.robots_blue_size();
+    entries[l].resize(n);
+    for (int i=0;i<n;i++) {
+      if (l==0) {
+        quantize(frame.balls(i),entries[l][i]);
+      } else if (l==1) {
+        quantize(frame.robots_yellow(i),entries[l][i]);
+      } else {
+        quantize(frame.robots_blue(i),entries[l][i]);
+      }
+    }
+  }
+
+  unsigned int distance=frame.frame_number()-keyframe_number;
+  bool is_keyframe=(have_keyframe==false || frame.camera_id()!=keyframe_camera ||
+                    distance==0 || distance >= (unsigned int)keyframe_interval);
+  if (is_keyframe==false) {
+    int matched=0;
+    int total=0;
+    for (int l=0;l<3;l++) {
+      matched+=matchList(l==0 ? Ball : Robot,l);
+      total+=entries[l].size();
+    }
+    if (total-matched > matched) is_keyframe=true;
+  }
+
+  out.Clear();
+  out.set_frame_number(frame.frame_number());
+  out.set_t_capture(frame.t_capture());
+  out.set_t_sent_offset(quantizeValue(frame.t_sent()-frame.t_capture(),1e6));
+  out.set_camera_id(frame.camera_id());
+  out.set_keyframe_distance(is_keyframe ? 0 : distance);
+
+  for (int l=0;l<3;l++) {
+    Kind kind=(l==0) ? Ball : Robot;
+    int count=valueCount(kind);
+    ValueList * values=mutableList(out,l);
+    for (unsigned int i=0;i<entries[l].size();i++) {
+      const Entry & e=entries[l][i];
+      const Entry * ref=0;
+      int head=e.flags;
+      if (is_keyframe==false && match[l][i] >= 0) {
+        ref=&keyframe[l][match[l][i]];
+        head|=(match[l][i]+1) << FlagBits;
+      }
+      values->Add(head);
+      for (int v=0;v<count;v++) {
+        int bit=optionalBit(kind,v);
+        if (bit >= 0 && (e.flags & (1 << bit))==0) continue;
+        if (ref!=0 && (bit < 0 || (ref->flags & (1 << bit)))) {
+          values->Add(e.value[v]-ref->value[v]);
+        } else {
+          values->Add(e.value[v]);
+        }
+      }
+    }
+  }
+
+  if (is_keyframe) {
+    for (int l=0;l<3;l++) keyframe[l].swap(entries[l]);
+    have_keyframe=true;
+    keyframe_number=frame.frame_number();
+    keyframe_camera=frame.camera_id();
+    keyframes++;
+  }
+  return is_keyframe;
+}
+
+DetectionDeltaDecoder::DetectionDeltaDecoder()
+{
+  missing_keyframes=0;
+  malformed=0;
+}
+
+void DetectionDeltaDecoder::reset() {
+  keyframes.clear();
+}
+
+int DetectionDeltaDecoder::getMissingKeyframes() const {
+  return missing_keyframes;
+}
+
+int DetectionDeltaDecoder::getMalformed() const {
+  return malformed;
+}
+
+bool DetectionDeltaDecoder::decodeList(Kind kind, const ValueList & values, const vector<Entry> * reference, vector<Entry> & out) {
+  int count=valueCount(kind);
+  int n=values.size();
+  int pos=0;
+  out.clear();
+  while (pos < n) {
+    int head=values.Get(pos++);
+    if (head < 0) return false;
+    Entry e;
+    e.flags=head & ((1 << FlagBits)-1);
+    int ref_index=(head >> FlagBits)-1;
+    const Entry * ref=0;
+    if (ref_index >= 0) {
+      if (reference==0 || ref_index >= (int)reference->size()) return false;
+      ref=&(*reference)[ref_index];
+    }
+    for (int v=0;v<MaxValues;v++) {
+      e.value[v]=0;
+      if (v >= count) continue;
+      int bit=optionalBit(kind,v);
+      if (bit >= 0 && (e.flags & (1 << bit))==0) continue;
+      if (pos >= n) return false;
+      e.value[v]=values.Get(pos++);
+      if (ref!=0 && (bit < 0 || (ref->flags & (1 << bit)))) e.value[v]+=ref->value[v];
+    }
+    out.push_back(e);
+  }
+  return true;
+}
+
+bool DetectionDeltaDecoder::decode(const SSL_DeltaDetectionFrame & delta, SSL_DetectionFrame & frame) {
+  const Keyframe * key=0;
+  bool is_keyframe=(delta.keyframe_distance()==0);
+  if (is_keyframe==false) {
+    map<unsigned int, Keyframe>::const_iterator it=keyframes.find(delta.camera_id());
+    if (it==keyframes.end() || it->second.frame_number!=delta.frame_number()-delta.keyframe_distance()) {
+      missing_keyframes++;
+      return false;
+    }
+    key=&it->second;
+  }
+
+  for (int l=0;l<3;l++) {
+    if (decodeList(l==0 ? Ball : Robot,getList(delta,l),key==0 ? 0 : &key->list[l],decoded[l])==false) {
+      malformed++;
+      return false;
+    }
+  }
+
+  frame.Clear();
+  frame.set_frame_number(delta.frame_number());
+  frame.set_t_capture(delta.t_capture());
+  frame.set_t_sent(delta.t_capture()+delta.t_sent_offset()*1e-6);
+  frame.set_camera_id(delta.camera_id());
+  for (unsigned int i=0;i<decoded[0].size();i++) restore(decoded[0][i],*frame.add_balls());
+  for (unsigned int i=0;i<decoded[1].size();i++) restore(decoded[1][i],*frame.add_robots_yellow());
+  for (unsigned int i=0;i<decoded[2].size();i++) restore(decoded[2][i],*frame.add_robots_blue());
+
+  if (is_keyframe) {
+    Keyframe & k=keyframes[delta.camera_id()];
+    k.frame_number=delta.frame_number();
+    for (int l=0;l<3;l++) k.list[l].swap(decoded[l]);
+  }
+  return true;
+}
+
+bool DetectionDeltaDecoder::decode(const void * data, int size, SSL_DetectionFrame & frame) {
+  if (packet.ParseFromArray(data,size)==false) {
+    malformed++;
+    return false;
+  }
+  return decode(packet,frame);
+}
@@ -0,0 +1,169 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    detection_delta.h
+  \brief   C++ Interface: DetectionDeltaEncoder, DetectionDeltaDecoder
+  \author  Author Name, 2009
+*/
+//========================================================================
+#ifndef DETECTION_DELTA_H
+#define DETECTION_DELTA_H
+#include <vector>
+#include <map>
+#include "messages_robocup_ssl_detection.pb.h"
+#include "messages_robocup_ssl_delta.pb.h"
+using namespace std;
+
+/*!
+  \class   DetectionDelta
+  \brief   The quantization shared by DetectionDeltaEncoder and
+           DetectionDeltaDecoder
+
+  Each ball or robot is a run of integers in its list of an
+  SSL_DeltaDetectionFrame:
+
+    balls:  head, confidence, [area], x, y, [z], pixel_x, pixel_y
+    robots: head, confidence, [robot_id], x, y, [orientation], pixel_x, pixel_y, [height]
+
+  The values in brackets are only present if the detection has them, as
+  told by the low three bits of head: bit 0 for area or robot_id, bit 1
+  for z or orientation, bit 2 for height. The rest of head is 0 for an
+  entry that is sent as it is, or 1 plus the index of the entry in the
+  same list of the keyframe that it is relative to. Each value of such
+  an entry is the difference to the same value of the keyframe entry,
+  if that entry has it, and the value itself otherwise. Keyframes only
+  hold entries that are sent as they are.
+
+  The values are rounded to units of
+    x, y, z, height     0.1 mm
+    pixel_x, pixel_y    1/16 pixel
+    orientation         0.0001 rad
+    confidence          0.001
+  and area and robot_id are sent as they are.
+*/
+class DetectionDelta {
+public:
+  static const int MaxValues=8;
+  static const int FlagBits=3;
+  /// a quantized ball or robot
+  struct Entry {
+    int flags;
+    int value[MaxValues]; //in the order of the proto fields, 0 if absent
+  };
+  enum Kind {
+    Ball,
+    Robot
+  };
+  /// the values of an entry of \p kind, without its head
+  static int valueCount(Kind kind);
+  /// the bit of head telling whether \p value is present, -1 if it always is
+  static int optionalBit(Kind kind, int value);
+
+  static void quantize(const SSL_DetectionBall & ball, Entry & e);
+  static void quantize(const SSL_DetectionRobot & robot, Entry & e);
+  static void restore(const Entry & e, SSL_DetectionBall & ball);
+  static void restore(const Entry & e, SSL_DetectionRobot & robot);
+};
+
+/*!
+  \class   DetectionDeltaEncoder
+  \brief   Turns the detection frames of one camera into
+           SSL_DeltaDetectionFrames
+
+  Every "keyframe interval" frames, the frame is sent as a keyframe.
+  The frames in between are relative to the last keyframe, not to each
+  other, so a lost packet only costs that packet, and a lost keyframe
+  costs the frames up to the next one.
+
+  Robots are paired with the nearest robot of the keyframe that has the
+  same team and id, balls with the nearest ball. If fewer than half of
+  the entries of a frame have a partner, the frame becomes a keyframe
+  early, as the scene has changed too much for the differences to pay.
+  A new camera id, or a frame number that did not advance, restarts with
+  a keyframe as well.
+
+  Once its vectors have grown to the size of a frame, encoding does not
+  allocate.
+*/
+class DetectionDeltaEncoder : public DetectionDelta {
+protected:
+  int keyframe_interval;
+  bool have_keyframe;
+  unsigned int keyframe_number;
+  unsigned int keyframe_camera;
+  int keyframes;
+  vector<Entry> keyframe[3]; //0: balls, 1: yellow robots, 2: blue robots
+  vector<Entry> entries[3];  //of the frame being encoded
+  vector<int> match[3];      //per entry, the index of its keyframe entry or -1
+  vector<bool> used;
+
+  int matchList(Kind kind, int list);
+public:
+  DetectionDeltaEncoder(int _keyframe_interval=30);
+
+  void setKeyframeInterval(int frames);
+  /// makes the next frame a keyframe
+  void reset();
+  /// encodes \p frame into \p out. returns true if it became a keyframe.
+  bool encode(const SSL_DetectionFrame & frame, SSL_DeltaDetectionFrame & out);
+  /// keyframes encoded so far
+  int getKeyframes() const;
+};
+
+/*!
+  \class   DetectionDeltaDecoder
+  \brief   Turns SSL_DeltaDetectionFrames back into SSL_DetectionFrames
+
+  Keeps the last keyframe of every camera. A frame relative to a
+  keyframe that was not received, or that has been replaced, is not
+  decoded; the stream recovers with the camera's next keyframe.
+
+  It only needs protobuf, so a client can use it on its own:
+
+    DetectionDeltaDecoder decoder;
+    SSL_DetectionFrame frame;
+    int n=udp.recv(buffer,sizeof(buffer),src);
+    if (decoder.decode(buffer,n,frame)) { ... }
+*/
+class DetectionDeltaDecoder : public DetectionDelta {
+protected:
+  struct Keyframe {
+    unsigned int frame_number;
+    vector<Entry> list[3];
+  };
+  map<unsigned int, Keyframe> keyframes; //per camera
+  vector<Entry> decoded[3];
+  SSL_DeltaDetectionFrame packet;
+  int missing_keyframes;
+  int malformed;
+
+  bool decodeList(Kind kind, const ::google::protobuf::RepeatedField< ::google::protobuf::int32 > & values,
+                  const vector<Entry> * reference, vector<Entry> & out);
+public:
+  DetectionDeltaDecoder();
+
+  /// returns false if \p delta cannot be decoded, leaving \p frame undefined
+  bool decode(const SSL_DeltaDetectionFrame & delta, SSL_DetectionFrame & frame);
+  /// decodes a received packet
+  bool decode(const void * data, int size, SSL_DetectionFrame & frame);
+  /// forgets all keyframes
+  void reset();
+  /// frames that were dropped because their keyframe was not received
+  int getMissingKeyframes() const;
+  /// frames that were dropped because they could not be parsed
+  int getMalformed() const;
+};
+
+#endif
@@ -0,0 +1,221 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    detection_fragments.cpp
+  \brief   C++ Implementation: DetectionFragments, DetectionFrameAssembler
+  \author  Author Name, 2009
+*/
+//========================================================================
+#include "detection_fragments.h"
+#include <google/protobuf/io/coded_stream.h>
+#include <algorithm>
+
+using google::protobuf::io::CodedOutputStream;
+
+//more fragments than a frame could need are taken as garbage:
+#define FRAGMENTS_MAX_COUNT 256
+
+/// a ball or robot of a detection frame
+struct DetectionEntry {
+  int list;     //0: balls, 1: yellow robots, 2: blue robots
+  int index;    //in its list
+  int position; //in the frame, counting all lists
+  int size;     //bytes it adds to the frame
+  float confidence;
+  bool operator<(const DetectionEntry & other) const {
+    return confidence > other.confidence;
+  }
+};
+
+/// the size of a length-delimited field of \p size bytes, with a one byte tag
+static int fieldSize(int size) {
+  return 1 + CodedOutputStream::VarintSize32(size) + size;
+}
+
+static void getEntries(const SSL_DetectionFrame & frame, vector<DetectionEntry> & entries) {
+  DetectionEntry e;
+  for (e.list=0;e.list<3;e.list++) {
+    int n=(e.list==0) ? frame.balls_size() : (e.list==1) ? frame.robots_yellow_size() : frame.robots_blue_size();
+    for (e.index=0;e.index<n;e.index++) {
+      const ::google::protobuf::MessageLite * m;
+      if (e.list==0) {
+        m=&frame.balls(e.index);
+        e.confidence=frame.balls(e.index).confidence();
+      } else if (e.list==1) {
+        m=&frame.robots_yellow(e.index);
+        e.confidence=frame.robots_yellow(e.index).confidence();
+      } else {
+        m=&frame.robots_blue(e.index);
+        e.confidence=frame.robots_blue(e.index).confidence();
+      }
+      e.size=fieldSize(m->ByteSize());
+      e.position=entries.size();
+      entries.push_back(e);
+    }
+  }
+}
+
+static void addEntry(SSL_DetectionFrame & to, const SSL_DetectionFrame & from, const DetectionEntry & e) {
+  if (e.list==0) {
+    to.add_balls()->CopyFrom(from.balls(e.index));
+  } else if (e.list==1) {
+    to.add_robots_yellow()->CopyFrom(from.robots_yellow(e.index));
+  } else {
+    to.add_robots_blue()->CopyFrom(from.robots_blue(e.index));
+  }
+}
+
+/// sets \p to to the fields of \p from that are not lists of entries
+static void copyHeader(const SSL_DetectionFrame & from, SSL_DetectionFrame & to) {
+  to.Clear();
+  to.set_frame_number(from.frame_number());
+  to.set_t_capture(from.t_capture());
+  to.set_t_sent(from.t_sent());
+  to.set_camera_id(from.camera_id());
+  if (from.has_camera_mask()) to.set_camera_mask(from.camera_mask());
+}
+
+int DetectionFragments::wrappedSize(int frame_size) {
+  return fieldSize(frame_size);
+}
+
+bool DetectionFragments::split(const SSL_DetectionFrame & frame, int limit, vector<SSL_DetectionFrame> & fragments) {
+  vector<DetectionEntry> entries;
+  getEntries(frame,entries);
+  SSL_DetectionFrame header;
+  copyHeader(frame,header);
+  //the largest the fragment fields can get:
+  header.set_fragment_index(entries.size());
+  header.set_fragment_count(entries.size());
+  int header_size=header.ByteSize();
+
+  //fill each fragment up in the order of the frame. an entry too large
+  //on its own gets a fragment to itself, which no other entry fits into:
+  vector<int> fragment_of(entries.size(),0);
+  int count=0;
+  int size=header_size;
+  bool fits=true;
+  for (unsigned int i=0;i<entries.size();i++) {
+    if (size > header_size && fieldSize(size+entries[i].size) > limit) {
+      count++;
+      size=header_size;
+    }
+    fragment_of[i]=count;
+    size+=entries[i].size;
+    if (fieldSize(size) > limit) fits=false;
+  }
+  count++; //the last one, which is sent even without entries
+
+  fragments.resize(count);
+  for (int j=0;j<count;j++) {
+    copyHeader(frame,fragments[j]);
+    if (count > 1) {
+      fragments[j].set_fragment_index(j);
+      fragments[j].set_fragment_count(count);
+    }
+  }
+  for (unsigned int i=0;i<entries.size();i++) {
+    addEntry(fragments[fragment_of[i]],frame,entries[i]);
+  }
+  return fits;
+}
+
+bool DetectionFragments::truncate(const SSL_DetectionFrame & frame, int limit, SSL_DetectionFrame & out) {
+  vector<DetectionEntry> entries;
+  getEntries(frame,entries);
+  copyHeader(frame,out);
+  vector<DetectionEntry> by_confidence(entries);
+  stable_sort(by_confidence.begin(),by_confidence.end());
+  vector<bool> keep(entries.size(),false);
+  int size=out.ByteSize();
+  bool complete=true;
+  for (unsigned int i=0;i<by_confidence.size();i++) {
+    if (fieldSize(size+by_confidence[i].size) > limit) {
+      complete=false;
+      continue;
+    }
+    size+=by_confidence[i].size;
+    keep[by_confidence[i].position]=true;
+  }
+  for (unsigned int j=0;j<entries.size();j++) {
+    if (keep[j]) addEntry(out,frame,entries[j]);
+  }
+  return complete;
+}
+
+DetectionFrameAssembler::DetectionFrameAssembler() {
+  incomplete=0;
+  malformed=0;
+}
+
+bool DetectionFrameAssembler::add(const SSL_DetectionFrame & fragment, SSL_DetectionFrame & frame) {
+  if (fragment.has_fragment_count()==false) {
+    frame.CopyFrom(fragment);
+    return true;
+  }
+  unsigned int count=fragment.fragment_count();
+  unsigned int index=fragment.fragment_index();
+  if (count==0 || count > FRAGMENTS_MAX_COUNT || index >= count) {
+    malformed++;
+    return false;
+  }
+  map<unsigned int, Pending>::iterator it=pending.find(fragment.camera_id());
+  if (it==pending.end()) {
+    it=pending.insert(make_pair(fragment.camera_id(),Pending())).first;
+    it->second.received=0;
+  }
+  Pending & p=it->second;
+  if (p.received==0 || p.frame_number!=fragment.frame_number() || p.fragments.size()!=count) {
+    if (p.received > 0) {
+      //a fragment that differs in its count is garbage, not a new frame:
+      if (p.frame_number==fragment.frame_number()) {
+        malformed++;
+        return false;
+      }
+      incomplete++;
+    }
+    p.frame_number=fragment.frame_number();
+    p.received=0;
+    p.fragments.resize(count);
+    p.have.assign(count,false);
+  }
+  if (p.have[index]) return false; //a duplicate
+  p.fragments[index].CopyFrom(fragment);
+  p.have[index]=true;
+  p.received++;
+  if (p.received < (int)count) return false;
+
+  copyHeader(p.fragments[0],frame);
+  for (unsigned int j=0;j<count;j++) {
+    const SSL_DetectionFrame & f=p.fragments[j];
+    frame.mutable_balls()->MergeFrom(f.balls());
+    frame.mutable_robots_yellow()->MergeFrom(f.robots_yellow());
+    frame.mutable_robots_blue()->MergeFrom(f.robots_blue());
+  }
+  p.received=0;
+  return true;
+}
+
+void DetectionFrameAssembler::reset() {
+  pending.clear();
+}
+
+int DetectionFrameAssembler::getIncomplete() const {
+  return incomplete;
+}
+
+int DetectionFrameAssembler::getMalformed() const {
+  return malformed;
+}
@@ -0,0 +1,95 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    detection_fragments.h
+  \brief   C++ Interface: DetectionFragments, DetectionFrameAssembler
+  \author  Author Name, 2009
+*/
+//========================================================================
+#ifndef DETECTION_FRAGMENTS_H
+#define DETECTION_FRAGMENTS_H
+#include <vector>
+#include <map>
+#include "messages_robocup_ssl_detection.pb.h"
+using namespace std;
+
+/*!
+  \class   DetectionFragments
+  \brief   Makes detection frames fit into packets of a limited size
+
+  Sizes are those of an SSL_WrapperPacket that holds nothing but the
+  detection frame, as RoboCupSSLServer sends it.
+
+  split() fills the fragments with the balls, then the yellow robots,
+  then the blue robots of the frame, each fragment taking as many as
+  fit. A ball or robot too large for any packet is sent anyway, alone
+  in a fragment above the limit. All fragments carry the frame number, times, camera id and
+  camera mask of the frame, and, if there is more than one,
+  fragment_index and fragment_count.
+*/
+class DetectionFragments {
+public:
+  /// the size of a wrapper packet holding a detection frame of \p frame_size bytes
+  static int wrappedSize(int frame_size);
+  /// splits \p frame into fragments of at most \p limit bytes each,
+  /// leaving out nothing. an entry that does not fit into a packet on its
+  /// own is put into a fragment of its own that exceeds \p limit; returns
+  /// false if there was any.
+  static bool split(const SSL_DetectionFrame & frame, int limit, vector<SSL_DetectionFrame> & fragments);
+  /// sets \p out to the most confident entries of \p frame that fit into
+  /// \p limit bytes, in the order of the frame. returns false if any
+  /// were left out.
+  static bool truncate(const SSL_DetectionFrame & frame, int limit, SSL_DetectionFrame & out);
+};
+
+/*!
+  \class   DetectionFrameAssembler
+  \brief   Puts the fragments of split detection frames back together
+
+  Frames that were not split pass through as they are. The fragments of
+  a frame may arrive in any order, but those of an older frame of the
+  same camera are dropped once a newer one arrives, as UDP gives no
+  guarantee that the rest ever comes:
+
+    DetectionFrameAssembler assembler;
+    SSL_DetectionFrame frame;
+    if (packet.has_detection() && assembler.add(packet.detection(),frame)) { ... }
+*/
+class DetectionFrameAssembler {
+protected:
+  struct Pending {
+    unsigned int frame_number;
+    int received;
+    vector<SSL_DetectionFrame> fragments;
+    vector<bool> have;
+  };
+  map<unsigned int, Pending> pending; //per camera
+  int incomplete;
+  int malformed;
+public:
+  DetectionFrameAssembler();
+
+  /// adds a received frame or fragment. returns true once \p frame holds
+  /// a whole frame, leaving it undefined otherwise.
+  bool add(const SSL_DetectionFrame & fragment, SSL_DetectionFrame & frame);
+  /// forgets all fragments received so far
+  void reset();
+  /// frames dropped because a newer frame of their camera arrived first
+  int getIncomplete() const;
+  /// fragments dropped because their index or count made no sense
+  int getMalformed() const;
+};
+
+#endif
@@ -192,6 +192,56 @@ bool UDP::send(const void *data,int length,const Address &dest)
   return(len == length);
 }
 
+int UDP::send(const void * const *data,const int *length,int count,const Address &dest,bool *sent_ok)
+{
+  int sent = 0;
+  int pos = 0;
+#ifdef __linux__
+  const int max_batch = 64;
+  mmsghdr msgs[max_batch];
+  iovec iov[max_batch];
+
+  while(pos < count){
+    int n = min(count - pos,max_batch);
+    for(int i=0; i<n; i++){
+      iov[i].iov_base = (void*)data[pos+i];
+      iov[i].iov_len = length[pos+i];
+      memset(&msgs[i],0,sizeof(msgs[i]));
+      msgs[i].msg_hdr.msg_name = (void*)&dest.addr;
+      msgs[i].msg_hdr.msg_namelen = dest.addr_len;
+      msgs[i].msg_hdr.msg_iov = &iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int done = sendmmsg(fd,msgs,n,0);
+    if(done <= 0){
+      // the first datagram failed; skip only that one
+      if(sent_ok) sent_ok[pos] = false;
+      pos++;
+      continue;
+    }
+    for(int i=0; i<done; i++){
+      if(msgs[i].msg_len > 0){
+        sent_packets++;
+        sent_bytes += msgs[i].msg_len;
+      }
+      if(sent_ok) sent_ok[pos+i] = true;
+    }
+    // after a partial batch, the next call retries the datagram that
+    // stopped it and reports its error
+    sent += done;
+    pos += done;
+  }
+#else
+  for(; pos<count; pos++){
+    bool ok = send(data[pos],length[pos],dest);
+    if(ok) sent++;
+    if(sent_ok) sent_ok[pos] = ok;
+  }
+#endif
+
+  return(sent);
+}
+
 int UDP::recv(void *data,int length,Address &src)
 {
   src.addr_len = sizeof(src.addr);
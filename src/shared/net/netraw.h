@@ -69,6 +69,10 @@ public:
     {return(fd >= 0);}
 
   bool send(const void *data,int length,const Address &dest);
+  // sends count datagrams at once, returns how many were sent.
+  // a datagram that fails is skipped, the following ones are still sent;
+  // if given, sent_ok[i] tells whether datagram i went out.
+  int  send(const void * const *data,const int *length,int count,const Address &dest,bool *sent_ok=0);
   int  recv(void *data,int length,Address &src);
   bool wait(int timeout_ms = -1) const;
   bool havePendingData() const
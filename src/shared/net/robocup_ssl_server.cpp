@@ -19,20 +19,87 @@
 */
 //========================================================================
 #include "robocup_ssl_server.h"
+#include "detection_fragments.h"
+#include "timer.h"
+#include <google/protobuf/io/coded_stream.h>
+#include <algorithm>
+
+using google::protobuf::io::CodedOutputStream;
+
+//enough for a detection frame of two full teams:
+#define SSL_SERVER_INITIAL_BUFFER 4096
+//packets the send thread can hold, a power of two:
+#define SSL_SERVER_QUEUE_SIZE 64
+//packets per sendmmsg():
+#define SSL_SERVER_MAX_BATCH 16
+
+RoboCupSSLSendThread::RoboCupSSLSendThread(RoboCupSSLServer * _server)
+{
+  server=_server;
+}
+
+void RoboCupSSLSendThread::run()
+{
+  server->runSendThread();
+}
 
 RoboCupSSLServer::RoboCupSSLServer(int port,
                      string net_address,
                      string net_interface)
+ : send_thread(this), send_queue(SSL_SERVER_QUEUE_SIZE)
 {
   _port=port;
   _net_address=net_address;
   _net_interface=net_interface;
 
+  for (unsigned int i=0;i<send_queue.size();i++) {
+    send_queue[i].sequence=i;
+    send_queue[i].size=0;
+    send_queue[i].queued=0.0;
+    send_queue[i].wire_latency=0;
+    send_queue[i].counters=0;
+    send_queue[i].data.resize(SSL_SERVER_INITIAL_BUFFER);
+  }
+  queue_tail=0;
+  queue_head=0;
+  use_send_thread=0;
+  stopping=0;
+  dropped_packets=0;
+  max_packet_size=0;
+  oversize_policy=OversizeSplit;
 }
 
 
 RoboCupSSLServer::~RoboCupSSLServer()
 {
+  if (send_thread.isRunning()) {
+    stopping=1;
+    queued.release();
+    send_thread.wait();
+  }
+}
+
+void RoboCupSSLServer::setSendThread(bool enable)
+{
+  use_send_thread=enable ? 1 : 0;
+  //once started, the thread stays until the server is deleted,
+  //so packets that are still queued will be sent:
+  if (enable && send_thread.isRunning()==false) send_thread.start();
+}
+
+bool RoboCupSSLServer::hasSendThread() const
+{
+  return (int)use_send_thread!=0;
+}
+
+void RoboCupSSLServer::setMaxPacketSize(int bytes)
+{
+  max_packet_size=max(bytes,0);
+}
+
+void RoboCupSSLServer::setOversizePolicy(OversizePolicy policy)
+{
+  oversize_policy=(int)policy;
 }
 
 void RoboCupSSLServer::close() {
@@ -50,6 +117,7 @@ bool RoboCupSSLServer::open() {
 
   Net::Address multiaddr,interface;
   multiaddr.setHost(_net_address.c_str(),_port);
+  _multiaddr=multiaddr;
   if(_net_interface.length() > 0){
     interface.setHost(_net_interface.c_str(),_port);
   }else{
@@ -65,32 +133,194 @@ bool RoboCupSSLServer::open() {
   return(true);
 }
 
-bool RoboCupSSLServer::send(const SSL_WrapperPacket & packet) {
-  string buffer;
-  packet.SerializeToString(&buffer);
-  Net::Address multiaddr;
-  multiaddr.setHost(_net_address.c_str(),_port);
+unsigned char * RoboCupSSLServer::beginPacket(int size, SendSlot * & slot) {
+  vector<unsigned char> * buffer;
+  slot=0;
+  if ((int)use_send_thread) {
+    //claim the slot at the tail, unless the send thread has not freed it yet:
+    unsigned int mask=send_queue.size()-1;
+    int pos=queue_tail;
+    for (;;) {
+      SendSlot & s=send_queue[(unsigned int)pos & mask];
+      int dif=(int)((unsigned int)(int)s.sequence - (unsigned int)pos);
+      if (dif==0) {
+        if (queue_tail.testAndSetOrdered(pos,(int)((unsigned int)pos+1))) {
+          slot=&s;
+          break;
+        }
+        pos=queue_tail;
+      } else if (dif < 0) {
+        dropped_packets.fetchAndAddRelaxed(1);
+        return 0;
+      } else {
+        pos=queue_tail;
+      }
+    }
+    buffer=&slot->data;
+  } else {
+    buffer=buffers.localData();
+    if (buffer==0) {
+      buffer=new vector<unsigned char>(SSL_SERVER_INITIAL_BUFFER);
+      buffers.setLocalData(buffer);
+      buffer_allocations.fetchAndAddRelaxed(1);
+    }
+  }
+  if ((int)buffer->size() < size) {
+    buffer->resize(max(size,(int)buffer->size()*2));
+    buffer_allocations.fetchAndAddRelaxed(1);
+  }
+  return &(*buffer)[0];
+}
+
+bool RoboCupSSLServer::endPacket(SendSlot * slot, int size, LatencyHistogram * wire_latency, RoboCupSSLSendCounters * counters) {
+  if (slot!=0) {
+    slot->size=size;
+    slot->wire_latency=wire_latency;
+    slot->counters=counters;
+    slot->queued=GetTimeSec();
+    //the slot was claimed at the position sequence-1 held:
+    slot->sequence.fetchAndStoreOrdered((int)((unsigned int)(int)slot->sequence+1));
+    queued.release();
+    return true;
+  }
+  double start=GetTimeSec();
   bool result;
   mutex.lock();
-  result=mc.send(buffer.c_str(),buffer.length(),multiaddr);
+  result=mc.send(&(*buffers.localData())[0],size,_multiaddr);
   mutex.unlock();
+  if (wire_latency!=0) wire_latency->record(GetTimeSec()-start);
   if (result==false) {
-    fprintf(stderr,"Sending UDP datagram failed (maybe too large?). Size was: %zu byte(s)\n",buffer.length());
+    if (counters!=0) counters->dropped.fetchAndAddRelaxed(1);
+    fprintf(stderr,"Sending UDP datagram failed (maybe too large?). Size was: %d byte(s)\n",size);
   }
   return(result);
 }
 
-bool RoboCupSSLServer::send(const SSL_DetectionFrame & frame) {
-  SSL_WrapperPacket pkt;
-  SSL_DetectionFrame * nframe = pkt.mutable_detection();
-  nframe->CopyFrom(frame);
-  return send(pkt);
+/// the size of a length-delimited field of \p size bytes, with a one byte tag
+static int fieldSize(int size) {
+  return 1 + CodedOutputStream::VarintSize32(size) + size;
 }
 
-bool RoboCupSSLServer::send(const SSL_GeometryData & geometry) {
-  SSL_WrapperPacket pkt;
-  SSL_GeometryData * gdata = pkt.mutable_geometry();
-  gdata->CopyFrom(geometry);
-  return send(pkt);
+bool RoboCupSSLServer::sendWrapped(int field, const ::google::protobuf::MessageLite & msg, int msg_size,
+                                   LatencyHistogram * wire_latency, RoboCupSSLSendCounters * counters) {
+  //the wire format of a wrapper packet with only this field set:
+  int size=fieldSize(msg_size);
+  SendSlot * slot;
+  unsigned char * buffer=beginPacket(size,slot);
+  if (buffer==0) {
+    if (counters!=0) counters->dropped.fetchAndAddRelaxed(1);
+    return false;
+  }
+  buffer[0]=(unsigned char)((field << 3) | 2); //length-delimited
+  unsigned char * p=CodedOutputStream::WriteVarint32ToArray(msg_size,buffer+1);
+  msg.SerializeWithCachedSizesToArray(p);
+  return endPacket(slot,size,wire_latency,counters);
 }
 
+bool RoboCupSSLServer::sendOversized(const SSL_DetectionFrame & frame, int limit,
+                                     LatencyHistogram * wire_latency, RoboCupSSLSendCounters * counters) {
+  //this is rare, so it may allocate:
+  if ((int)oversize_policy==OversizeTruncate) {
+    SSL_DetectionFrame part;
+    bool truncated=(DetectionFragments::truncate(frame,limit,part)==false);
+    if (truncated && counters!=0) counters->truncated.fetchAndAddRelaxed(1);
+    return sendWrapped(SSL_WrapperPacket::kDetectionFieldNumber,part,part.ByteSize(),wire_latency,counters);
+  }
+
+  //a ball or robot that does not fit on its own is still sent, in a
+  //packet larger than the limit:
+  vector<SSL_DetectionFrame> fragments;
+  DetectionFragments::split(frame,limit,fragments);
+  bool result=true;
+  for (unsigned int i=0;i<fragments.size();i++) {
+    result=sendWrapped(SSL_WrapperPacket::kDetectionFieldNumber,fragments[i],fragments[i].ByteSize(),wire_latency,counters) && result;
+  }
+  if (counters!=0) {
+    if (fragments.size() > 1) counters->fragmented.fetchAndAddRelaxed(1);
+  }
+  return result;
+}
+
+void RoboCupSSLServer::runSendThread() {
+  const void * data[SSL_SERVER_MAX_BATCH];
+  int length[SSL_SERVER_MAX_BATCH];
+  bool sent_ok[SSL_SERVER_MAX_BATCH];
+  unsigned int mask=send_queue.size()-1;
+  for (;;) {
+    int n=0;
+    if ((int)stopping==0) {
+      queued.acquire();
+      n=min(1+queued.available(),SSL_SERVER_MAX_BATCH);
+      if (n > 1) queued.acquire(n-1);
+    }
+    if ((int)stopping) {
+      //the senders are gone and the count includes the stop request,
+      //so send only what is ready:
+      n=0;
+      while (n < SSL_SERVER_MAX_BATCH &&
+             (int)send_queue[(queue_head+n) & mask].sequence==(int)((unsigned int)queue_head+n+1)) n++;
+      if (n==0) return;
+    }
+    for (int i=0;i<n;i++) {
+      SendSlot & s=send_queue[(queue_head+i) & mask];
+      //a later sender may have finished first; this one is about to:
+      while ((int)s.sequence!=(int)((unsigned int)queue_head+i+1)) QThread::yieldCurrentThread();
+      data[i]=&s.data[0];
+      length[i]=s.size;
+    }
+    mutex.lock();
+    int sent=mc.send(data,length,n,_multiaddr,sent_ok);
+    mutex.unlock();
+    if (sent < n) {
+      fprintf(stderr,"Sending UDP datagrams failed: %d of %d sent\n",sent,n);
+    }
+    double now=GetTimeSec();
+    for (int i=0;i<n;i++) {
+      SendSlot & s=send_queue[(queue_head+i) & mask];
+      if (s.wire_latency!=0) s.wire_latency->record(now-s.queued);
+      if (sent_ok[i]==false && s.counters!=0) s.counters->dropped.fetchAndAddRelaxed(1);
+      s.sequence.fetchAndStoreOrdered((int)((unsigned int)queue_head+i+send_queue.size()));
+    }
+    queue_head=(int)((unsigned int)queue_head+n);
+  }
+}
+
+int RoboCupSSLServer::getBufferAllocations() const {
+  return buffer_allocations;
+}
+
+int RoboCupSSLServer::getDroppedPackets() const {
+  return dropped_packets;
+}
+
+bool RoboCupSSLServer::send(const SSL_WrapperPacket & packet, LatencyHistogram * wire_latency) {
+  int size=packet.ByteSize();
+  SendSlot * slot;
+  unsigned char * buffer=beginPacket(size,slot);
+  if (buffer==0) return false;
+  packet.SerializeWithCachedSizesToArray(buffer);
+  return endPacket(slot,size,wire_latency,0);
+}
+
+bool RoboCupSSLServer::send(const SSL_DetectionFrame & frame, LatencyHistogram * wire_latency, RoboCupSSLSendCounters * counters) {
+  int msg_size=frame.ByteSize();
+  int limit=max_packet_size;
+  if (limit > 0 && fieldSize(msg_size) > limit) {
+    return sendOversized(frame,limit,wire_latency,counters);
+  }
+  return sendWrapped(SSL_WrapperPacket::kDetectionFieldNumber,frame,msg_size,wire_latency,counters);
+}
+
+bool RoboCupSSLServer::send(const SSL_GeometryData & geometry, LatencyHistogram * wire_latency) {
+  return sendWrapped(SSL_WrapperPacket::kGeometryFieldNumber,geometry,geometry.ByteSize(),wire_latency,0);
+}
+
+
+bool RoboCupSSLServer::send(const SSL_DeltaDetectionFrame & frame, LatencyHistogram * wire_latency) {
+  int size=frame.ByteSize();
+  SendSlot * slot;
+  unsigned char * buffer=beginPacket(size,slot);
+  if (buffer==0) return false;
+  frame.SerializeWithCachedSizesToArray(buffer);
+  return endPacket(slot,size,wire_latency,0);
+}
@@ -22,22 +22,134 @@
 #define ROBOCUP_SSL_SERVER_H
 #include "netraw.h"
 #include <string>
+#include <vector>
 #include <QMutex>
+#include <QAtomicInt>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadStorage>
+#include "latency_histogram.h"
 #include "messages_robocup_ssl_detection.pb.h"
 #include "messages_robocup_ssl_geometry.pb.h"
 #include "messages_robocup_ssl_wrapper.pb.h"
+#include "messages_robocup_ssl_delta.pb.h"
 using namespace std;
+
+class RoboCupSSLServer;
+
+/*!
+  \class   RoboCupSSLSendCounters
+  \brief   What happened to the detection frames of one sender that did not
+           fit into a packet
+*/
+class RoboCupSSLSendCounters
+{
+public:
+  QAtomicInt fragmented; //frames split into several packets
+  QAtomicInt truncated;  //frames sent without some of their entries
+  QAtomicInt dropped;    //packets that could not be queued or sent
+};
+
+/*!
+  \class   RoboCupSSLSendThread
+  \brief   The thread that sends the queued packets of a RoboCupSSLServer
+*/
+class RoboCupSSLSendThread : public QThread
+{
+protected:
+  RoboCupSSLServer * server;
+public:
+  RoboCupSSLSendThread(RoboCupSSLServer * _server);
+  virtual void run();
+};
+
 /**
 	@author Stefan Zickler
+
+  Every sending thread serializes into a buffer of its own, outside of
+  the mutex. The buffer keeps its size between sends, and the multicast
+  address is resolved once by open(), so sending a detection frame or
+  the geometry does not allocate once the buffer fits the packets.
+  getBufferAllocations() counts the exceptions.
+
+  With setSendThread(true), send() serializes into a slot of a bounded
+  queue instead and returns without taking the mutex. Any number of
+  threads may queue at once; the slots are claimed with an atomic
+  counter, so no sender waits for another. A RoboCupSSLSendThread takes
+  all packets that are ready and sends them with a single sendmmsg(),
+  which lets the packets of cameras that finish together share one
+  system call and one locking of the mutex. If the queue is full, the
+  packet is dropped and counted by getDroppedPackets().
+
+  The time from send() until the packet was handed to the socket is
+  recorded into the histogram passed to send(), in either mode.
+
+  A detection frame whose packet would exceed setMaxPacketSize() is
+  either split or truncated, see OversizePolicy and DetectionFragments.
+  Each fragment is a complete detection frame with the frame number,
+  capture time and camera id of the original, and its fragment_index
+  and fragment_count, so a receiver can tell when it has all of them;
+  DetectionFrameAssembler puts them back together. Truncation keeps the
+  most confident balls and robots that fit into one packet. Other
+  packets are sent as they are. Without a DetectionFrameAssembler, a
+  receiver takes each fragment for a whole frame, so only set a limit if
+  all receivers reassemble; there is none by default.
+
+  SSL_DeltaDetectionFrames are sent on their own, not in a wrapper
+  packet, as the port they are sent to carries nothing else.
 */
 class RoboCupSSLServer{
 friend class MultiStackRoboCupSSL;
+friend class RoboCupSSLSendThread;
+public:
+  enum OversizePolicy {
+    OversizeSplit,   //send as many packets as needed
+    OversizeTruncate //drop the least confident entries
+  };
 protected:
+  struct SendSlot {
+    QAtomicInt sequence; //position+1 once queued, position+queue size once free again
+    int size;
+    double queued;
+    LatencyHistogram * wire_latency;
+    RoboCupSSLSendCounters * counters;
+    vector<unsigned char> data;
+  };
+
   Net::UDP mc; // multicast server
   QMutex mutex;
   int _port;
   string _net_address;
   string _net_interface;
+  Net::Address _multiaddr; // resolved by open()
+  QThreadStorage<vector<unsigned char> *> buffers;
+  QAtomicInt buffer_allocations;
+
+  QAtomicInt use_send_thread;
+  RoboCupSSLSendThread send_thread;
+  vector<SendSlot> send_queue; //a power of two of slots
+  QAtomicInt queue_tail;       //next position to claim
+  int queue_head;              //next position to send, only used by send_thread
+  QSemaphore queued;           //one per queued packet
+  QAtomicInt stopping;
+  QAtomicInt dropped_packets;
+  QAtomicInt max_packet_size; //0 for no limit
+  QAtomicInt oversize_policy;
+
+  /// returns room for a packet of \p size bytes. \p slot is set to the
+  /// queue slot, or to 0 for the calling thread's own buffer.
+  unsigned char * beginPacket(int size, SendSlot * & slot);
+  /// sends or queues the packet of beginPacket()
+  bool endPacket(SendSlot * slot, int size, LatencyHistogram * wire_latency, RoboCupSSLSendCounters * counters);
+  /// sends \p msg, of \p msg_size bytes, as field \p field of an
+  /// SSL_WrapperPacket, without building the packet
+  bool sendWrapped(int field, const ::google::protobuf::MessageLite & msg, int msg_size,
+                   LatencyHistogram * wire_latency, RoboCupSSLSendCounters * counters);
+  /// sends a detection frame that does not fit into one packet
+  bool sendOversized(const SSL_DetectionFrame & frame, int limit,
+                     LatencyHistogram * wire_latency, RoboCupSSLSendCounters * counters);
+  /// the loop of send_thread
+  void runSendThread();
 
 public:
     RoboCupSSLServer(int port = 10002,
@@ -47,9 +159,24 @@ public:
     ~RoboCupSSLServer();
     bool open();
     void close();
-    bool send(const SSL_WrapperPacket & packet);
-    bool send(const SSL_DetectionFrame & frame);
-    bool send(const SSL_GeometryData & geometry);
+    bool send(const SSL_WrapperPacket & packet, LatencyHistogram * wire_latency=0);
+    bool send(const SSL_DetectionFrame & frame, LatencyHistogram * wire_latency=0, RoboCupSSLSendCounters * counters=0);
+    bool send(const SSL_GeometryData & geometry, LatencyHistogram * wire_latency=0);
+    bool send(const SSL_DeltaDetectionFrame & frame, LatencyHistogram * wire_latency=0);
+
+    /// the largest wrapper packet a detection frame may take, 0 for no limit
+    void setMaxPacketSize(int bytes);
+    void setOversizePolicy(OversizePolicy policy);
+
+    /// queues packets for the send thread instead of sending them right away
+    void setSendThread(bool enable);
+    bool hasSendThread() const;
+
+    /// buffers created or enlarged by the send functions so far. It stops
+    /// growing once every sending thread has seen its largest packet.
+    int getBufferAllocations() const;
+    /// packets dropped because the send queue was full
+    int getDroppedPackets() const;
 
 };
 
@@ -20,12 +20,16 @@
 //========================================================================
 #include "affinity_manager.h"
 
-AffinityManager::AffinityManager()
+AffinityManager::AffinityManager(const string & _sysfs_root)
 {
   _mutex=new pthread_mutex_t;
   pthread_mutex_init((pthread_mutex_t*)_mutex, NULL);
+  sysfs_root=_sysfs_root;
   max_cpu_id=0;
-  parseCpuInfo();
+  num_nodes=1;
+  node_ids.assign(1,0);
+  planned=false;
+  if (parseSysfsTopology()==false) parseCpuInfo();
 }
 
 AffinityManager::~AffinityManager()
@@ -34,44 +38,283 @@ AffinityManager::~AffinityManager()
   delete _mutex;
 }
 
+int AffinityManager::getNodeCount() const {
+  return num_nodes;
+}
+
+int AffinityManager::getCoreCount() const {
+  int n=0;
+  for (unsigned int i=0;i<cores.size();i++) {
+    if (cores[i].enabled) n++;
+  }
+  return n;
+}
+
+const vector<AffinityManager::PhysicalCore> & AffinityManager::getCores() const {
+  return cores;
+}
+
 void AffinityManager::demandCore(int core) {
+  if (planned) {
+    if (core >= 0 && core < (int)camera_cores.size()) {
+      placeThread(RoleCamera,core);
+    } else {
+      placeThread(RoleOther);
+    }
+    return;
+  }
+  if (cores.empty()) return;
+  if (core < 0) core=0;
+  vector<int> core_indices;
+  core_indices.push_back(core % cores.size());
+  char label[64];
+  snprintf(label,sizeof(label),"core %d",core);
+  DT_LOCK;
+  pinCurrentThread(core_indices,label);
+  DT_UNLOCK;
+}
 
+void AffinityManager::placeThread(ThreadRole role, int camera) {
   DT_LOCK;
+  if (planned==false || camera_cores.empty()) {
+    DT_UNLOCK;
+    return;
+  }
+  if (camera < 0) camera=0;
+  camera=camera % camera_cores.size();
+  if (role==RoleCamera) {
+    char label[32];
+    snprintf(label,sizeof(label),"camera %d",camera);
+    pinCurrentThread(camera_cores[camera],label);
+  } else {
+    pinCurrentThread(other_cores,"other");
+  }
+  DT_UNLOCK;
+}
+
+void AffinityManager::pinCurrentThread(const vector<int> & core_indices, const string & label) {
   unsigned int tid=(long int)syscall(__NR_gettid);
-  printf("The ID of this thread is: %d\n", tid);
   cpu_set_t cpu_set;
-  //int n = max_cpu_id+1;
-  sched_getaffinity(tid, sizeof(cpu_set), &cpu_set);
-  for (int i=0;i<CPU_SETSIZE;i++) {
-    CPU_CLR(i, &cpu_set);
+  CPU_ZERO(&cpu_set);
+  int n=0;
+  for (unsigned int i=0;i<core_indices.size();i++) {
+    const PhysicalCore & core=cores[core_indices[i]];
+    for (unsigned int j=0;j<core.processor_ids.size();j++) {
+      CPU_SET(core.processor_ids[j],&cpu_set);
+      n++;
+    }
+  }
+  if (n==0) return;
+  if (sched_setaffinity(tid, sizeof(cpu_set), &cpu_set) == 0) {
+    printf("Affinity: thread %d (%s) runs on %s\n",tid,label.c_str(),formatCores(core_indices).c_str());
+  } else {
+    printf("Error while setting affinity of thread %d (%s)\n",tid,label.c_str());
   }
-  int max_cores=cores.size();
- 
+}
 
-  if (core < 0) core=0;
-  int modded_core=core % max_cores;
+string AffinityManager::formatCores(const vector<int> & core_indices) const {
+  string result;
+  char buf[32];
+  for (unsigned int i=0;i<core_indices.size();i++) {
+    const PhysicalCore & core=cores[core_indices[i]];
+    snprintf(buf,sizeof(buf),"%score %d.%d (CPUs",i > 0 ? ", " : "",core.package,core.core_id);
+    result+=buf;
+    for (unsigned int j=0;j<core.processor_ids.size();j++) {
+      snprintf(buf,sizeof(buf)," %d",core.processor_ids[j]);
+      result+=buf;
+    }
+    result+=")";
+  }
+  return result;
+}
+
+void AffinityManager::planPlacement(int cameras, int reserved) {
+  DT_LOCK;
+  camera_cores.clear();
+  other_cores.clear();
+  planned=false;
+  if (cameras < 1 || cores.empty()) {
+    DT_UNLOCK;
+    return;
+  }
+  if (reserved < 0) reserved=0;
+
+  //the free cores of every node, in order:
+  vector<vector<int> > free_cores(num_nodes);
+  int total=0;
+  for (unsigned int i=0;i<cores.size();i++) {
+    if (cores[i].enabled) {
+      free_cores[cores[i].node].push_back(i);
+      total++;
+    }
+  }
+  if (total==0) {
+    DT_UNLOCK;
+    return;
+  }
+  //without enough cores, keep fewer for the other threads:
+  if (total - reserved < cameras) reserved=max(0,total-cameras);
+  int dedicated=total-reserved;
 
-  /* This commented code could be used to set affinity for hyperthreading
-     For now, we leave this up to the system scheduler...
-    int wraps=core/max_cores;
-    if (wraps > 0) {
-      int ht_channel=wraps % cores[modded_core].processor_ids.size();
+  camera_cores.resize(cameras);
+  vector<int> camera_node(cameras,-1);
+  vector<unsigned int> next(num_nodes,0);
+  //each camera gets its first core on the node with the most free cores,
+  //then the cores left for cameras go round-robin to those on the same node:
+  int assigned=0;
+  int with_core=0;
+  for (int c=0;c<cameras && assigned<dedicated;c++) {
+    int best=-1;
+    for (int nd=0;nd<num_nodes;nd++) {
+      int left=free_cores[nd].size()-next[nd];
+      if (left > 0 && (best==-1 || left > (int)(free_cores[best].size()-next[best]))) best=nd;
+    }
+    if (best==-1) break;
+    camera_node[c]=best;
+    camera_cores[c].push_back(free_cores[best][next[best]++]);
+    assigned++;
+    with_core++;
+  }
+  bool progress=true;
+  while (assigned<dedicated && progress) {
+    progress=false;
+    for (int c=0;c<cameras && assigned<dedicated;c++) {
+      int nd=camera_node[c];
+      if (nd < 0 || next[nd] >= free_cores[nd].size()) continue;
+      camera_cores[c].push_back(free_cores[nd][next[nd]++]);
+      assigned++;
+      progress=true;
+    }
+  }
+  for (int nd=0;nd<num_nodes;nd++) {
+    for (unsigned int i=next[nd];i<free_cores[nd].size();i++) other_cores.push_back(free_cores[nd][i]);
+  }
+  //cameras without a core of their own share one with an earlier camera:
+  for (int c=0;c<cameras;c++) {
+    if (camera_cores[c].empty()) {
+      camera_cores[c]=camera_cores[c % with_core];
+      camera_node[c]=camera_node[c % with_core];
+    }
+  }
+  bool shared_other=other_cores.empty();
+  if (shared_other) {
+    for (unsigned int i=0;i<cores.size();i++) {
+      if (cores[i].enabled) other_cores.push_back(i);
     }
-  */
+  }
+  planned=true;
 
-  for (unsigned int i=0; i < cores[modded_core].processor_ids.size(); i++) {
-    CPU_SET(cores[modded_core].processor_ids[i],&cpu_set);
+  printf("== Affinity Manager Thread Placement ==============================\n");
+  printf(" %d NUMA node(s), %d physical core(s), %d camera(s)\n",num_nodes,total,cameras);
+  for (int c=0;c<cameras;c++) {
+    printf(" - Camera %d: node %d, %s\n",c,node_ids[camera_node[c]],formatCores(camera_cores[c]).c_str());
   }
-  if (sched_setaffinity(tid, sizeof(cpu_set), &cpu_set) == 0) {
-    printf("Affinity set successfully\n");
-    for (int i=0;i<CPU_SETSIZE;i++) {
-      if (CPU_ISSET(i,&cpu_set)) printf("Set CPU: %d\n",i);
+  printf(" - Other threads: %s\n",formatCores(other_cores).c_str());
+  if (with_core < cameras) printf(" WARNING: fewer physical cores than cameras, some cameras share a core\n");
+  if (shared_other) printf(" WARNING: no core left, other threads share the camera cores\n");
+  printf("==================================================================\n");
+  DT_UNLOCK;
+}
+
+bool AffinityManager::readInt(const string & path, int & value) {
+  FILE * f=fopen(path.c_str(),"r");
+  if (f==0) return false;
+  bool ok=(fscanf(f,"%d",&value)==1);
+  fclose(f);
+  return ok;
+}
+
+bool AffinityManager::readCpuList(const string & path, vector<int> & cpus) {
+  //e.g. "0-3,8,10-11"
+  FILE * f=fopen(path.c_str(),"r");
+  if (f==0) return false;
+  char line[4096];
+  bool ok=(fgets(line,sizeof(line),f)!=0);
+  fclose(f);
+  if (ok==false) return false;
+  char * p=line;
+  while (*p!=0 && *p!='\n') {
+    char * end;
+    long first=strtol(p,&end,10);
+    if (end==p) return false;
+    long last=first;
+    p=end;
+    if (*p=='-') {
+      last=strtol(p+1,&end,10);
+      if (end==p+1) return false;
+      p=end;
     }
-  } else {
-    printf("Error while setting affinity\n");
-  }	
+    for (long i=first;i<=last;i++) cpus.push_back((int)i);
+    if (*p==',') p++;
+  }
+  return true;
+}
+
+bool AffinityManager::parseSysfsTopology() {
+  vector<int> online;
+  if (readCpuList(sysfs_root + "/cpu/online",online)==false || online.empty()) return false;
+
+  vector<int> cpu_node;
+  num_nodes=1;
+  node_ids.assign(1,0);
+  vector<int> nodes;
+  if (readCpuList(sysfs_root + "/node/online",nodes)) {
+    int next_node=0;
+    for (unsigned int i=0;i<nodes.size();i++) {
+      vector<int> node_cpus;
+      char path[64];
+      snprintf(path,sizeof(path),"/node/node%d/cpulist",nodes[i]);
+      if (readCpuList(sysfs_root + path,node_cpus)==false || node_cpus.empty()) continue;
+      //nodes are numbered densely here, as node ids may have gaps:
+      if (next_node==0) node_ids.clear();
+      node_ids.push_back(nodes[i]);
+      for (unsigned int j=0;j<node_cpus.size();j++) {
+        if (node_cpus[j] >= (int)cpu_node.size()) cpu_node.resize(node_cpus[j]+1,0);
+        cpu_node[node_cpus[j]]=next_node;
+      }
+      next_node++;
+    }
+    if (next_node > 0) num_nodes=next_node;
+  }
 
+  DT_LOCK;
+  cores.clear();
+  max_cpu_id=0;
+  for (unsigned int i=0;i<online.size();i++) {
+    int cpu=online[i];
+    int package=0;
+    int core_id=cpu;
+    char path[96];
+    snprintf(path,sizeof(path),"/cpu/cpu%d/topology/physical_package_id",cpu);
+    readInt(sysfs_root + path,package);
+    snprintf(path,sizeof(path),"/cpu/cpu%d/topology/core_id",cpu);
+    readInt(sysfs_root + path,core_id);
+    if (cpu > max_cpu_id) max_cpu_id=cpu;
+    int node=(cpu < (int)cpu_node.size()) ? cpu_node[cpu] : 0;
+    //SMT siblings share package and core id:
+    unsigned int k=0;
+    while (k<cores.size() && (cores[k].package!=package || cores[k].core_id!=core_id)) k++;
+    if (k==cores.size()) {
+      cores.push_back(PhysicalCore());
+      cores[k].enabled=true;
+      cores[k].node=node;
+      cores[k].package=package;
+      cores[k].core_id=core_id;
+    }
+    cores[k].processor_ids.push_back(cpu);
+  }
+  printf("== Affinity Manager CPU Detection Results =========================\n");
+  printf(" Found %zu core(s) on %d NUMA node(s):\n", cores.size(), num_nodes);
+  for (unsigned int i=0;i< cores.size(); i++) {
+    printf(" - Core %d.%d on node %d with %zu HT Processor(s) (IDs: ",cores[i].package,cores[i].core_id,node_ids[cores[i].node],cores[i].processor_ids.size());
+    for (unsigned j=0;j< cores[i].processor_ids.size(); j++) {
+      printf("[%d] ",cores[i].processor_ids[j]);
+    }
+    printf(")\n");
+  }
+  printf("==================================================================\n");
   DT_UNLOCK;
+  return true;
 }
 
 int AffinityManager::parseFileUpTo(FILE * f, char * output, int len, char end) {
@@ -107,8 +350,12 @@ void AffinityManager::parseCpuInfo() {
   char value[256];
   int phys_id=0;
   int proc_id=0;
-  int max_cpu_id=0;
+  max_cpu_id=0;
   f=fopen("/proc/cpuinfo","r");
+  if (f==0) {
+    DT_UNLOCK;
+    return;
+  }
 
   PhysicalCore core;
 
@@ -132,6 +379,7 @@ void AffinityManager::parseCpuInfo() {
             }
           }
           cores[phys_id].enabled=true;
+          cores[phys_id].core_id=phys_id;
           cores[phys_id].processor_ids.push_back(proc_id);
         }
       }
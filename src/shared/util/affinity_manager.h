@@ -23,6 +23,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
+#include <string>
 #include <vector>
 #include <unistd.h>
 #include <asm/unistd.h>
@@ -36,28 +38,77 @@ using namespace std;
 
 /**
 	@author Stefan Zickler
+
+	Detects the CPU topology (NUMA nodes, physical cores and their SMT
+	siblings) from sysfs, falling back to /proc/cpuinfo, and places
+	threads according to a plan made by planPlacement():
+
+	Each camera gets dedicated physical cores on a single NUMA node,
+	including all their SMT siblings, so that no other thread competes
+	for the same core. The capture and processing threads of a camera
+	run on these cores, as do threads started by them and the pool
+	threads running their bands (see BandWorkerPool). All other threads
+	(GUI, network, ...) run on the cores left over.
 */
 class AffinityManager{
 public:
   class PhysicalCore {
     public:
     bool enabled;
+    int node;
+    int package;
+    int core_id;
     vector<int> processor_ids;
     PhysicalCore() {
       enabled=false;
+      node=0;
+      package=0;
+      core_id=0;
       processor_ids.clear();
     }
   };
+  enum ThreadRole {
+    RoleCamera,
+    RoleOther
+  };
 protected:
     pthread_mutex_t * _mutex;
+    string sysfs_root;
     vector<PhysicalCore> cores;
     int max_cpu_id;
+    int num_nodes;
+    bool planned;
+    vector<vector<int> > camera_cores; //indices into cores, per camera
+    vector<int> other_cores;
+    vector<int> node_ids; //the sysfs id of each node
     int parseFileUpTo(FILE * f, char * output, int len, char end);
     void parseCpuInfo();
+    bool parseSysfsTopology();
+    static bool readInt(const string & path, int & value);
+    static bool readCpuList(const string & path, vector<int> & cpus);
+    string formatCores(const vector<int> & core_indices) const;
+    void pinCurrentThread(const vector<int> & core_indices, const string & label);
 public:
 
+    /// plans dedicated cores for \p cameras cameras, keeping at least
+    /// \p reserved cores for all other threads if there are enough,
+    /// and prints the plan
+    void planPlacement(int cameras, int reserved=1);
+
+    /// pins the calling thread according to the plan
+    void placeThread(ThreadRole role, int camera=0);
+
+    /// with a plan, cores below the number of cameras stand for those
+    /// cameras and all others for other threads. Without a plan, pins the calling
+    /// thread to physical core \p core.
     void demandCore(int core);
-    AffinityManager();
+
+    int getNodeCount() const;
+    int getCoreCount() const;
+    const vector<PhysicalCore> & getCores() const;
+
+    /// \p _sysfs_root is where the "cpu" and "node" directories are
+    AffinityManager(const string & _sysfs_root="/sys/devices/system");
 
     ~AffinityManager();
 
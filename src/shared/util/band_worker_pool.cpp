@@ -0,0 +1,99 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    band_worker_pool.cpp
+  \brief   C++ Implementation: band_worker_pool
+  \author  Author Name, 2009
+*/
+//========================================================================
+#include "band_worker_pool.h"
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+#include <sched.h>
+
+//the CPUs last set for the calling pool thread:
+static __thread bool worker_cpus_set=false;
+static __thread cpu_set_t worker_cpus;
+//whether the calling thread is processing a band of a split job:
+static __thread bool inside_pool=false;
+
+class BandRunnable : public QRunnable {
+protected:
+  BandJob * _job;
+  int _band;
+  int _num_bands;
+  QSemaphore * _done;
+  const cpu_set_t * _cpus;
+public:
+  BandRunnable(BandJob * job, int band, int num_bands, QSemaphore * done, const cpu_set_t * cpus) {
+    _job=job;
+    _band=band;
+    _num_bands=num_bands;
+    _done=done;
+    _cpus=cpus;
+    setAutoDelete(true);
+  }
+  virtual void run() {
+    //follow the affinity of the submitting thread (see AffinityManager):
+    if (_cpus!=0 && (worker_cpus_set==false || CPU_EQUAL(&worker_cpus,_cpus)==0)) {
+      if (sched_setaffinity(0,sizeof(cpu_set_t),_cpus)==0) {
+        worker_cpus=*_cpus;
+        worker_cpus_set=true;
+      }
+    }
+    inside_pool=true;
+    _job->processBand(_band,_num_bands);
+    inside_pool=false;
+    _done->release();
+  }
+};
+
+void BandWorkerPool::run(BandJob * job, int num_bands) {
+  if (num_bands <= 1) {
+    job->processBand(0,1);
+    return;
+  }
+  if (inside_pool) {
+    //a band that splits again would wait for pool threads while holding
+    //one, which can starve the pool; process the nested bands right here:
+    for (int i=0;i<num_bands;i++) {
+      job->processBand(i,num_bands);
+    }
+    return;
+  }
+  QSemaphore done(0);
+  cpu_set_t cpus;
+  bool have_cpus=(sched_getaffinity(0,sizeof(cpus),&cpus)==0);
+  QThreadPool * pool=QThreadPool::globalInstance();
+  for (int i=1;i<num_bands;i++) {
+    pool->start(new BandRunnable(job,i,num_bands,&done,have_cpus ? &cpus : 0));
+  }
+  //the calling thread does its share instead of idling:
+  inside_pool=true;
+  job->processBand(0,num_bands);
+  inside_pool=false;
+  done.acquire(num_bands-1);
+}
+
+bool BandWorkerPool::isInsidePool() {
+  return inside_pool;
+}
+
+int BandWorkerPool::getMaxBands() {
+  int n=QThread::idealThreadCount();
+  return (n < 1 ? 1 : n);
+}
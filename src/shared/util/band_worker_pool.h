@@ -0,0 +1,66 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    band_worker_pool.h
+  \brief   C++ Interface: band_worker_pool
+  \author  Author Name, 2009
+*/
+//========================================================================
+#ifndef BAND_WORKER_POOL_H
+#define BAND_WORKER_POOL_H
+
+/*!
+  \class BandJob
+  \brief A job that can be split into independent bands (e.g. horizontal image stripes)
+
+  processBand() is called exactly once for every band in [0,num_bands).
+  Different bands run concurrently, so an implementation may only write
+  state belonging to its own band.
+*/
+class BandJob {
+public:
+  virtual void processBand(int band, int num_bands)=0;
+  virtual ~BandJob() {};
+};
+
+/*!
+  \class BandWorkerPool
+  \brief Runs the bands of a BandJob on the application-wide QThreadPool
+
+  Band 0 is processed by the calling thread, all others are handed to
+  QThreadPool::globalInstance(), which is shared by all capture threads.
+  run() returns once every band has finished.
+
+  A pool thread takes over the CPU affinity of the thread whose bands it
+  runs, so the bands of a camera stay on that camera's cores.
+
+  A band may itself call run(), e.g. a plugin that splits its image
+  while the PluginScheduler runs it next to other plugins. Such nested
+  jobs do not go to the pool again: all their bands are processed one
+  after the other by the thread running the outer band, so that no pool
+  thread ever waits for work queued behind it.
+*/
+class BandWorkerPool {
+public:
+  static void run(BandJob * job, int num_bands);
+
+  //true while the calling thread processes a band of a job that was split
+  static bool isInsidePool();
+
+  //the largest number of bands that is worth splitting a job into
+  static int getMaxBands();
+};
+
+#endif
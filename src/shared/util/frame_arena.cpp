@@ -0,0 +1,152 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    frame_arena.cpp
+  \brief   C++ Implementation: FrameArena
+  \author  Author Name, 2009
+*/
+//========================================================================
+#include "frame_arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+//smallest block handed out:
+#define FRAME_ARENA_MIN_BLOCK 4096
+
+FrameArena::FrameArena()
+{
+  limit=0;
+  allocated=0;
+  high_water=0;
+  shrink_frames=300;
+}
+
+FrameArena::~FrameArena()
+{
+  release();
+}
+
+size_t FrameArena::getSizeClass(size_t bytes) {
+  size_t c=FRAME_ARENA_MIN_BLOCK;
+  while (c < bytes) c<<=1;
+  return c;
+}
+
+void FrameArena::reallocate(Block & block, size_t capacity) {
+  free(block.data);
+  allocated-=block.capacity;
+  block.data=(capacity > 0) ? (char *)malloc(capacity) : 0;
+  if (block.data==0) capacity=0;
+  block.capacity=capacity;
+  allocated+=capacity;
+  if (allocated > high_water) high_water=allocated;
+  block.reallocations++;
+}
+
+void * FrameArena::allocate(const string & label, size_t bytes, size_t * capacity) {
+  map<string,Block>::iterator iter=blocks.find(label);
+  if (iter==blocks.end()) {
+    Block b;
+    b.data=0;
+    b.capacity=0;
+    b.frame_request=0;
+    b.high_water=0;
+    b.frames_below=0;
+    b.reallocations=0;
+    iter=blocks.insert(make_pair(label,b)).first;
+  }
+  Block & block=iter->second;
+  if (bytes > block.frame_request) block.frame_request=bytes;
+  if (bytes > block.high_water) block.high_water=bytes;
+
+  if (bytes > block.capacity) {
+    size_t wanted=getSizeClass(bytes);
+    if (limit > 0 && allocated - block.capacity + wanted > limit) {
+      //clamp to what is left, but never below the current block:
+      size_t available=(limit > allocated - block.capacity) ? limit - (allocated - block.capacity) : 0;
+      if (available > block.capacity) {
+        fprintf(stderr,"FrameArena: '%s' needs %d bytes, limited to %d\n",label.c_str(),(int)bytes,(int)available);
+        reallocate(block,available);
+      }
+    } else {
+      reallocate(block,wanted);
+    }
+    block.frames_below=0;
+  }
+
+  if (capacity!=0) *capacity=block.capacity;
+  return block.data;
+}
+
+void FrameArena::beginFrame() {
+  for (map<string,Block>::iterator iter=blocks.begin();iter!=blocks.end();iter++) {
+    Block & block=iter->second;
+    if (block.capacity > FRAME_ARENA_MIN_BLOCK && block.frame_request <= block.capacity/4) {
+      block.frames_below++;
+      if (block.frames_below >= shrink_frames) {
+        //keep twice the recent demand as headroom:
+        reallocate(block,getSizeClass(2*block.frame_request));
+        block.frames_below=0;
+      }
+    } else {
+      block.frames_below=0;
+    }
+    block.frame_request=0;
+  }
+}
+
+void FrameArena::release() {
+  for (map<string,Block>::iterator iter=blocks.begin();iter!=blocks.end();iter++) {
+    free(iter->second.data);
+  }
+  blocks.clear();
+  allocated=0;
+}
+
+void FrameArena::setLimit(size_t bytes) {
+  limit=bytes;
+}
+
+size_t FrameArena::getLimit() const {
+  return limit;
+}
+
+void FrameArena::setShrinkFrames(int frames) {
+  shrink_frames=(frames < 1) ? 1 : frames;
+}
+
+int FrameArena::getShrinkFrames() const {
+  return shrink_frames;
+}
+
+size_t FrameArena::getAllocatedBytes() const {
+  return allocated;
+}
+
+size_t FrameArena::getHighWaterBytes() const {
+  return high_water;
+}
+
+void FrameArena::getBlockStats(vector<FrameArenaBlockStats> & stats) const {
+  stats.clear();
+  for (map<string,Block>::const_iterator iter=blocks.begin();iter!=blocks.end();iter++) {
+    FrameArenaBlockStats s;
+    s.label=iter->first;
+    s.capacity=iter->second.capacity;
+    s.high_water=iter->second.high_water;
+    s.reallocations=iter->second.reallocations;
+    stats.push_back(s);
+  }
+}
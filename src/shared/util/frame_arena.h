@@ -0,0 +1,104 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    frame_arena.h
+  \brief   C++ Interface: FrameArena
+  \author  Author Name, 2009
+*/
+//========================================================================
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+#include <stddef.h>
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+/*!
+  \struct FrameArenaBlockStats
+  \brief  Memory statistics of one labeled block of a FrameArena
+*/
+struct FrameArenaBlockStats {
+  string label;
+  size_t capacity;   //currently allocated bytes
+  size_t high_water; //largest request ever seen
+  int reallocations; //number of times the block was grown or shrunk
+};
+
+/*!
+  \class FrameArena
+  \brief Owns the per-frame scratch memory of one FrameData
+
+  Plugins request a block by label once per frame with allocate(). The
+  block is reused from frame to frame. Capacities are rounded up to
+  power-of-two size classes, so a slowly growing demand only causes a
+  few reallocations. A block grows right away when a request does not
+  fit. It shrinks only after its requests have stayed below a quarter
+  of its capacity for getShrinkFrames() consecutive frames.
+
+  The total is bounded by setLimit(). Requests beyond the limit get a
+  smaller block, and the caller must respect the returned capacity.
+  release() frees everything, e.g. when the vision stack is replaced.
+  A block's contents are not preserved across reallocations.
+*/
+class FrameArena {
+protected:
+  struct Block {
+    char * data;
+    size_t capacity;
+    size_t frame_request; //largest request during the current frame
+    size_t high_water;
+    int frames_below;
+    int reallocations;
+  };
+  map<string,Block> blocks;
+  size_t limit;
+  size_t allocated;
+  size_t high_water;
+  int shrink_frames;
+
+  static size_t getSizeClass(size_t bytes);
+  void reallocate(Block & block, size_t capacity);
+private:
+  //blocks are owned, copying is not supported:
+  FrameArena(const FrameArena &);
+  FrameArena & operator=(const FrameArena &);
+public:
+  FrameArena();
+  ~FrameArena();
+
+  /// returns a block of at least \p bytes (or less, if the limit is hit)
+  /// for \p label. The actual size is stored in \p capacity if given.
+  void * allocate(const string & label, size_t bytes, size_t * capacity=0);
+
+  /// advances the shrinking hysteresis; call once per frame before any allocate()
+  void beginFrame();
+
+  /// frees all blocks. Pointers handed out before become invalid.
+  void release();
+
+  /// 0 means unbounded
+  void setLimit(size_t bytes);
+  size_t getLimit() const;
+  void setShrinkFrames(int frames);
+  int getShrinkFrames() const;
+
+  /// bytes currently allocated, and the most that ever were at once
+  size_t getAllocatedBytes() const;
+  size_t getHighWaterBytes() const;
+  void getBlockStats(vector<FrameArenaBlockStats> & stats) const;
+};
+
+#endif
@@ -0,0 +1,140 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    latency_histogram.cpp
+  \brief   C++ Implementation: LatencyHistogram
+  \author  Author Name, 2009
+*/
+//========================================================================
+#include "latency_histogram.h"
+#include <stdio.h>
+
+LatencyHistogram::LatencyHistogram(const string & _name)
+{
+  name=_name;
+  counts.assign(NumBuckets,0);
+  count=0;
+  max_us=0;
+  sum_us=0.0;
+}
+
+void LatencyHistogram::setName(const string & _name)
+{
+  name=_name;
+}
+
+string LatencyHistogram::getName() const
+{
+  return name;
+}
+
+int LatencyHistogram::getBucket(long long us)
+{
+  if (us < SubBuckets) return (us < 0) ? 0 : (int)us;
+  int msb=0;
+  for (long long v=us;v > 1;v>>=1) msb++;
+  int shift=msb-SubBucketBits;
+  if (shift >= Octaves) return NumBuckets-1;
+  return (shift+1)*SubBuckets + (int)((us >> shift) - SubBuckets);
+}
+
+long long LatencyHistogram::getBucketValue(int bucket)
+{
+  //the largest value that falls into the bucket:
+  if (bucket < SubBuckets) return bucket;
+  int shift=bucket/SubBuckets-1;
+  long long sub=bucket%SubBuckets + SubBuckets;
+  return ((sub+1) << shift) - 1;
+}
+
+void LatencyHistogram::record(double seconds)
+{
+  long long us=(long long)(seconds*1e6 + 0.5);
+  if (us < 0) us=0;
+  int bucket=getBucket(us);
+  mutex.lock();
+  counts[bucket]++;
+  count++;
+  sum_us+=(double)us;
+  if (us > max_us) max_us=us;
+  mutex.unlock();
+}
+
+void LatencyHistogram::reset()
+{
+  mutex.lock();
+  counts.assign(NumBuckets,0);
+  count=0;
+  max_us=0;
+  sum_us=0.0;
+  mutex.unlock();
+}
+
+void LatencyHistogram::snapshot(LatencyHistogram & copy, bool reset_after)
+{
+  mutex.lock();
+  copy.name=name;
+  copy.counts=counts;
+  copy.count=count;
+  copy.max_us=max_us;
+  copy.sum_us=sum_us;
+  if (reset_after) {
+    counts.assign(NumBuckets,0);
+    count=0;
+    max_us=0;
+    sum_us=0.0;
+  }
+  mutex.unlock();
+}
+
+long long LatencyHistogram::getCount() const
+{
+  return count;
+}
+
+double LatencyHistogram::getPercentile(double p) const
+{
+  if (count==0) return 0.0;
+  if (p > 1.0) p=1.0;
+  long long rank=(long long)(p*(double)count + 0.5);
+  if (rank < 1) rank=1;
+  long long seen=0;
+  for (int i=0;i<NumBuckets;i++) {
+    seen+=counts[i];
+    if (seen >= rank) {
+      long long v=getBucketValue(i);
+      return (double)(v < max_us ? v : max_us)*1e-6;
+    }
+  }
+  return (double)max_us*1e-6;
+}
+
+double LatencyHistogram::getMax() const
+{
+  return (double)max_us*1e-6;
+}
+
+double LatencyHistogram::getMean() const
+{
+  return count > 0 ? sum_us/(double)count*1e-6 : 0.0;
+}
+
+string LatencyHistogram::toString() const
+{
+  char buf[128];
+  snprintf(buf,sizeof(buf),"p50 %.2f p99 %.2f max %.2f ms (n=%lld)",
+           getPercentile(0.5)*1e3,getPercentile(0.99)*1e3,getMax()*1e3,count);
+  return buf;
+}
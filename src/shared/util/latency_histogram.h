@@ -0,0 +1,82 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    latency_histogram.h
+  \brief   C++ Interface: LatencyHistogram
+  \author  Author Name, 2009
+*/
+//========================================================================
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+#include <QMutex>
+#include <string>
+#include <vector>
+using namespace std;
+
+/*!
+  \class LatencyHistogram
+  \brief A histogram of latencies with a bounded relative error
+
+  Latencies are counted in microseconds. Values below 32 us get a
+  bucket each. Above that, every power of two is split into 32 equal
+  buckets, so a reported percentile is at most about 3% above the true
+  value. Values of more than about half an hour go into the last bucket.
+  The maximum is kept exactly.
+
+  record() takes a lock, so any thread may record. To read the
+  histogram, copy it with snapshot() and query the copy.
+*/
+class LatencyHistogram {
+protected:
+  enum {
+    SubBucketBits=5,
+    SubBuckets=1 << SubBucketBits,
+    Octaves=26,
+    NumBuckets=(Octaves+1)*SubBuckets
+  };
+  string name;
+  QMutex mutex;
+  vector<long long> counts;
+  long long count;
+  long long max_us;
+  double sum_us;
+
+  static int getBucket(long long us);
+  static long long getBucketValue(int bucket);
+private:
+  LatencyHistogram(const LatencyHistogram &);
+  LatencyHistogram & operator=(const LatencyHistogram &);
+public:
+  LatencyHistogram(const string & _name="");
+
+  void setName(const string & _name);
+  string getName() const;
+
+  void record(double seconds);
+  void reset();
+  /// copies the counts into \p copy, and empties this histogram if \p reset_after is set
+  void snapshot(LatencyHistogram & copy, bool reset_after=false);
+
+  /// the following should only be called on a snapshot():
+  long long getCount() const;
+  /// the latency in seconds that a fraction \p p of the values does not exceed
+  double getPercentile(double p) const;
+  double getMax() const;
+  double getMean() const;
+  /// e.g. "p50 1.20 p99 3.41 max 5.02 ms (n=300)"
+  string toString() const;
+};
+
+#endif
@@ -0,0 +1,84 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    parameter_snapshot.h
+  \brief   C++ Interface: ParameterSnapshot
+  \author  Author Name, 2009
+*/
+//========================================================================
+#ifndef PARAMETER_SNAPSHOT_H
+#define PARAMETER_SNAPSHOT_H
+#include <QAtomicPointer>
+
+/*!
+  \class ParameterSnapshot
+  \brief Hands immutable copies of a set of parameters from the threads
+         that edit them to the one thread that uses them
+
+  Any thread may publish() a new copy, allocated with new. The reader
+  calls pickUp() once per frame and uses the returned copy until its
+  next pickUp(), so all values seen during a frame stem from the same
+  publish(). Neither side ever waits for the other.
+
+  A copy is only deleted by the side that owns it: the reader deletes
+  its old copy when it picks up a new one, and publish() deletes a copy
+  that was replaced before the reader picked it up.
+
+  There must be only one reader at a time. Publishers that build their
+  copies from shared state should serialize with each other, or an older
+  copy might replace a newer one.
+*/
+template <class PARAMS>
+class ParameterSnapshot {
+protected:
+  QAtomicPointer<PARAMS> pending; //published, not yet picked up
+  PARAMS * current;               //only touched by the reader
+private:
+  ParameterSnapshot(const ParameterSnapshot &);
+  ParameterSnapshot & operator=(const ParameterSnapshot &);
+public:
+  ParameterSnapshot() : pending(0) {
+    current=0;
+  }
+
+  ~ParameterSnapshot() {
+    delete pending.fetchAndStoreAcquire(0);
+    delete current;
+  }
+
+  /// replaces the parameters the reader will see from its next pickUp() on
+  void publish(PARAMS * params) {
+    PARAMS * replaced=pending.fetchAndStoreOrdered(params);
+    delete replaced;
+  }
+
+  /// returns the latest published parameters, or 0 if there were none yet.
+  /// the result stays valid until the next call.
+  const PARAMS * pickUp() {
+    PARAMS * next=pending.fetchAndStoreAcquire(0);
+    if (next!=0) {
+      delete current;
+      current=next;
+    }
+    return current;
+  }
+
+  /// the parameters returned by the last pickUp()
+  const PARAMS * get() const {
+    return current;
+  }
+};
+
+#endif
@@ -0,0 +1,290 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    spmc_ringbuffer.h
+  \brief   C++ Interface: SPMCRingBuffer
+  \author  Author Name, 2009
+*/
+//========================================================================
+
+#ifndef SPMC_RINGBUFFER_H_
+#define SPMC_RINGBUFFER_H_
+#include <QAtomicInt>
+#include <QThread>
+
+/*!
+  \class SPMCRingBuffer
+  \brief A lock-free single-producer/multi-consumer ring of items
+
+  One writer thread fills the item at curWrite() and then calls
+  publish(). This makes the item the latest completed one and gives it
+  a sequence number. The writer then moves on to a bin that no reader
+  is using. Any number of readers pin the latest completed item with
+  acquireLatest() and unpin it with release(). A pinned item is never
+  overwritten. Neither side takes a lock.
+
+  Every bin has a state and a pin count. The state is the sequence
+  number of the item, 0 if the bin is empty, or -1 while the writer
+  owns the bin. A reader pins a bin first and then checks its state.
+  The writer claims a bin by setting its state first and then checking
+  the pin count. Both steps use full barriers, so at least one side
+  sees the other and backs off.
+
+  The writer only has to wait if every bin except the one it just
+  published is pinned. With two more bins than concurrent readers this
+  cannot happen. Readers retry only if the writer reclaims a bin
+  between their reading of the latest index and their pin.
+
+  A writer that keeps several items in flight, such as a pipeline of
+  processing stages, can take further bins with claimWrite() and
+  complete them in any order with publishBin(). Such writers may use
+  several threads, but their calls to the writer functions have to be
+  serialized.
+
+  Sequence numbers start at 1 and wrap from INT_MAX back to 1. Compare
+  them for equality only.
+*/
+template <class ITEM>
+class SPMCRingBuffer {
+  protected:
+    struct Bin {
+      QAtomicInt state;
+      QAtomicInt pins;
+      char padding[64 - 2*sizeof(QAtomicInt)]; //keep bins on separate cache lines
+    };
+    enum {
+      BinEmpty=0,
+      BinWriting=-1
+    };
+    Bin * bins;
+    QAtomicInt latest;          //index of the latest completed bin, or -1
+    QAtomicInt latest_sequence; //its sequence number, or 0
+    QAtomicInt read_retries;    //readers that had to retry
+    int current_write;          //only used by the writer
+    int sequence;               //only used by the writer
+    int writer_stalls;          //only written by the writer
+  private:
+    //items cannot be shared between rings:
+    SPMCRingBuffer(const SPMCRingBuffer &);
+    SPMCRingBuffer & operator=(const SPMCRingBuffer &);
+
+    bool tryClaim(int idx) {
+      if ((int)bins[idx].pins != 0) return false;
+      int old=bins[idx].state.fetchAndStoreOrdered(BinWriting);
+      if ((int)bins[idx].pins == 0) return true;
+      //a reader got in first:
+      bins[idx].state.fetchAndStoreOrdered(old);
+      return false;
+    }
+
+    int complete(int idx) {
+      sequence++;
+      if (sequence <= 0) sequence=1;
+      bins[idx].state.fetchAndStoreOrdered(sequence);
+      latest.fetchAndStoreOrdered(idx);
+      latest_sequence.fetchAndStoreOrdered(sequence);
+      return sequence;
+    }
+  public:
+    ITEM * items;
+    int size;
+
+    /*!
+      \brief Constructor of the SPMCRingBuffer
+      \param _size determines how many items are stored in it.
+
+      Note that \p _size needs to be at least 2. Use at least two more
+      than the number of readers that may hold an item at the same time.
+    */
+    SPMCRingBuffer ( int _size ) {
+      if (_size < 2) _size=2;
+      size=_size;
+      items=new ITEM[size];
+      bins=new Bin[size];
+      for (int i=0;i<size;i++) {
+        bins[i].state=BinEmpty;
+        bins[i].pins=0;
+      }
+      latest=-1;
+      latest_sequence=0;
+      read_retries=0;
+      sequence=0;
+      writer_stalls=0;
+      current_write=0;
+      bins[0].state=BinWriting;
+    }
+    virtual ~SPMCRingBuffer() {
+      delete[] bins;
+      delete[] items;
+    }
+
+    /*!
+      \brief returns a pointer to the item at index \p idx
+
+      Readers may only dereference an index they have acquired.
+    */
+    ITEM * getPointer ( int idx ) {
+      if ( idx >= size ) idx=size-1;
+      if ( idx < 0 ) idx=0;
+      return & ( items[idx] );
+    }
+
+    /*!
+      \brief returns the index of the bin the writer currently fills
+
+      This bin is invisible to readers until publish() is called.
+      Only the writer thread may call this.
+    */
+    int curWrite() const {
+      return current_write;
+    }
+
+    /*!
+      \brief completes the current write bin and moves to a free one
+
+      Returns the sequence number of the published item. If every other
+      bin is pinned, this yields until a reader releases one.
+      Only the writer thread may call this.
+    */
+    int publish() {
+      int published=current_write;
+      complete(published);
+
+      for (;;) {
+        for (int i=1;i<size;i++) {
+          int idx=(published+i) % size;
+          if ((int)bins[idx].state == BinWriting) continue;
+          if (tryClaim(idx)) {
+            current_write=idx;
+            return sequence;
+          }
+        }
+        writer_stalls++;
+        QThread::yieldCurrentThread();
+      }
+    }
+
+    /*!
+      \brief claims a further free bin for writing and returns its index
+
+      Returns -1 if every bin is pinned, latest, or already claimed. The
+      bin stays invisible to readers until it is passed to publishBin().
+      Only the writer may call this.
+    */
+    int claimWrite() {
+      int last=latest;
+      for (int i=1;i<=size;i++) {
+        int idx=(last+i+size) % size;
+        if (idx==last || idx==current_write) continue;
+        if ((int)bins[idx].state == BinWriting) continue;
+        if (tryClaim(idx)) return idx;
+      }
+      return -1;
+    }
+
+    /*!
+      \brief completes a bin obtained from claimWrite()
+
+      Returns the sequence number of the published item. Unlike
+      publish(), this does not claim a new bin.
+      Only the writer may call this.
+    */
+    int publishBin(int idx) {
+      if (idx < 0 || idx >= size || idx==current_write) return 0;
+      return complete(idx);
+    }
+
+    /*!
+      \brief gives a bin obtained from claimWrite() back unpublished
+      Only the writer may call this.
+    */
+    void abandonBin(int idx) {
+      if (idx < 0 || idx >= size || idx==current_write) return;
+      bins[idx].state.fetchAndStoreOrdered(BinEmpty);
+    }
+
+    /*!
+      \brief withdraws all completed items and waits until none is pinned
+
+      Afterwards acquireLatest() fails until the next publish(), and the
+      writer may access every item, e.g. to free their contents. Bins
+      taken with claimWrite() have to be published before.
+      Only the writer thread may call this.
+    */
+    void invalidate() {
+      latest.fetchAndStoreOrdered(-1);
+      latest_sequence.fetchAndStoreOrdered(0);
+      for (int i=0;i<size;i++) {
+        if (i==current_write) continue;
+        bins[i].state.fetchAndStoreOrdered(BinEmpty);
+        while ((int)bins[i].pins != 0) {
+          writer_stalls++;
+          QThread::yieldCurrentThread();
+        }
+      }
+    }
+
+    /*!
+      \brief pins the latest completed item and returns its index
+
+      Returns -1 if nothing has been published yet. The sequence number
+      of the item is stored in \p seq if given. Every successful call
+      must be matched by a release() of the returned index.
+    */
+    int acquireLatest(int * seq=0) {
+      for (;;) {
+        int idx=latest;
+        if (idx < 0) return -1;
+        bins[idx].pins.fetchAndAddOrdered(1);
+        int state=bins[idx].state;
+        if (state > 0) {
+          if (seq!=0) *seq=state;
+          return idx;
+        }
+        //the writer reclaimed the bin after we read latest:
+        bins[idx].pins.fetchAndAddOrdered(-1);
+        read_retries.fetchAndAddRelaxed(1);
+      }
+    }
+
+    /*!
+      \brief unpins an item obtained from acquireLatest()
+    */
+    void release(int idx) {
+      if (idx < 0 || idx >= size) return;
+      bins[idx].pins.fetchAndAddOrdered(-1);
+    }
+
+    /*!
+      \brief returns the sequence number of the latest completed item, or 0
+
+      This does not pin anything; it is meant for cheap polling.
+    */
+    int getLatestSequence() const {
+      return latest_sequence;
+    }
+
+    /// number of times the writer had to wait for readers
+    int getWriterStalls() const {
+      return writer_stalls;
+    }
+
+    /// number of times a reader had to retry acquireLatest()
+    int getReadRetries() const {
+      return read_retries;
+    }
+};
+
+#endif /*SPMC_RINGBUFFER_H_*/